@@ -16,10 +16,21 @@ SOURCES = src/main.cpp \
   src/ui/CoordinateDialog.cpp \
   src/import/GCSpiderCachePage.cpp \
   src/import/GCSpider.cpp \
+  src/import/GCImport.cpp \
+  src/import/ImportBatch.cpp \
+  src/import/FetchScheduler.cpp \
+  src/import/PageCache.cpp \
   src/logic/SettingsManager.cpp \
   src/logic/Geocache.cpp \
   src/logic/Failure.cpp \
   src/logic/GeocacheModel.cpp \
+  src/logic/GeocacheDatabase.cpp \
+  src/logic/DatabaseWorker.cpp \
+  src/logic/AttributeIndex.cpp \
+  src/logic/GeocacheQuery.cpp \
+  src/logic/SummarySnapshot.cpp \
+  src/logic/NameDictionary.cpp \
+  src/logic/StringPool.cpp \
   src/logic/Coordinate.cpp \
 
 HEADERS = src/global.h \
@@ -31,10 +42,21 @@ HEADERS = src/global.h \
   src/ui/MainWindow.h \
   src/import/GCSpiderCachePage.h \
   src/import/GCSpider.h \
+  src/import/GCImport.h \
+  src/import/ImportBatch.h \
+  src/import/FetchScheduler.h \
+  src/import/PageCache.h \
   src/logic/SettingsManager.h \
   src/logic/Geocache.h \
   src/logic/Failure.h \
   src/logic/GeocacheModel.h \
+  src/logic/GeocacheDatabase.h \
+  src/logic/DatabaseWorker.h \
+  src/logic/AttributeIndex.h \
+  src/logic/GeocacheQuery.h \
+  src/logic/SummarySnapshot.h \
+  src/logic/NameDictionary.h \
+  src/logic/StringPool.h \
   src/logic/Coordinate.h \
 
 RESOURCES = resource/geojackal.qrc
@@ -0,0 +1,168 @@
+/**
+ * @file FetchScheduler.cpp
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "import/FetchScheduler.h"
+#include <QTimer>
+#include <QUrl>
+
+using namespace geojackal;
+
+/**
+ * Constructor
+ * @param manager The network access manager that sends the requests, with
+ *  its cookies
+ * @param maxInFlight Maximum number of requests in flight
+ * @param hostInterval Minimum time in ms between the starts of two requests
+ *  to the same host
+ * @param parent Parent object
+ */
+FetchScheduler::FetchScheduler(QNetworkAccessManager * manager,
+  int maxInFlight, int hostInterval, QObject * parent) : QObject(parent),
+  manager_(manager), maxInFlight_(qMax(1, maxInFlight)),
+  hostInterval_(hostInterval), timeout_(0), timerPending_(false),
+  aborted_(false) {
+  clock_.start();
+}
+
+FetchScheduler::~FetchScheduler() {
+  abort();
+}
+
+/**
+ * Add a request to the queue, and start it if possible. Nothing happens
+ * after @a abort().
+ * @param request The request, sent with HTTP GET
+ * @param tag Identifies the request in @a pageLoaded()
+ */
+void FetchScheduler::enqueue(const QNetworkRequest& request, int tag) {
+  if(aborted_) {
+    return;
+  }
+  Job job;
+  job.request = request;
+  job.tag = tag;
+  queue_.enqueue(job);
+  startRequests();
+}
+
+/**
+ * Set the time after which a request is aborted if the server did not
+ * answer. Applies to the requests started from now on.
+ * @param timeout Time in ms, or 0 to wait forever
+ */
+void FetchScheduler::setTimeout(int timeout) {
+  timeout_ = timeout;
+}
+
+/**
+ * Abort a request if it is not finished after some time. The reply then
+ * finishes with QNetworkReply::OperationCanceledError.
+ * @param reply The request
+ * @param timeout Time in ms, or 0 to wait forever
+ */
+void FetchScheduler::abortAfter(QNetworkReply * reply, int timeout) {
+  if(timeout > 0) {
+    QTimer * timer = new QTimer(reply);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), reply, SLOT(abort()));
+    timer->start(timeout);
+  }
+}
+
+/**
+ * @return a message for the error of a finished request, with requests
+ *  aborted by @a abortAfter() reported as timeouts
+ */
+QString FetchScheduler::errorString(QNetworkReply * reply) {
+  if(reply->error() == QNetworkReply::OperationCanceledError) {
+    return tr("Timeout while loading %1").arg(reply->url().toString());
+  }
+  return reply->errorString();
+}
+
+/**
+ * Cancel all requests. Requests in flight are aborted, and no more results
+ * are reported.
+ */
+void FetchScheduler::abort() {
+  aborted_ = true;
+  queue_.clear();
+  QList<QNetworkReply *> replies = inFlight_.keys();
+  inFlight_.clear();
+  foreach(QNetworkReply * reply, replies) {
+    reply->disconnect(this);
+    reply->abort();
+    reply->deleteLater();
+  }
+}
+
+/**
+ * @internal
+ * Start as many queued requests as the limits allow. Requests to a host that
+ * has to wait do not hold up the requests to other hosts. If a host has to
+ * wait, this function is called again when it may continue.
+ */
+void FetchScheduler::startRequests() {
+  timerPending_ = false;
+  int wait = -1;
+  for(int i = 0; i < queue_.size() && inFlight_.size() < maxInFlight_;) {
+    QString host = queue_[i].request.url().host();
+    int since = clock_.elapsed() - lastStart_.value(host, -hostInterval_);
+    if(since < hostInterval_) {
+      wait = (wait < 0) ? hostInterval_ - since :
+        qMin(wait, hostInterval_ - since);
+      ++i;
+      continue;
+    }
+
+    Job job = queue_.takeAt(i);
+    lastStart_[host] = clock_.elapsed();
+    QNetworkReply * reply = manager_->get(job.request);
+    connect(reply, SIGNAL(finished()), SLOT(replyFinished()));
+    abortAfter(reply, timeout_);
+    inFlight_.insert(reply, job.tag);
+  }
+  if(wait >= 0 && inFlight_.size() < maxInFlight_ && !timerPending_) {
+    timerPending_ = true;
+    QTimer::singleShot(wait, this, SLOT(startRequests()));
+  }
+}
+
+/**
+ * @internal
+ * Called when a request is complete. Its result is reported, and the next
+ * requests are started.
+ */
+void FetchScheduler::replyFinished() {
+  QNetworkReply * reply = qobject_cast<QNetworkReply *>(sender());
+  if(!reply || !inFlight_.contains(reply)) {
+    return;
+  }
+
+  int tag = inFlight_.take(reply);
+  reply->deleteLater();
+  emit pageLoaded(tag, reply);
+
+  // the receiver may have aborted us
+  if(aborted_) {
+    return;
+  }
+  startRequests();
+}
@@ -0,0 +1,103 @@
+/**
+ * @file FetchScheduler.h
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FETCHSCHEDULER_H_
+#define FETCHSCHEDULER_H_
+
+#include <QObject>
+#include <QQueue>
+#include <QHash>
+#include <QTime>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+
+namespace geojackal {
+
+/**
+ * Loads web pages with a bounded number of requests in flight. Requests are
+ * started in the order they were enqueued, but only if fewer than
+ * @a maxInFlight are running and the last request to the same host was
+ * started at least @a hostInterval ms ago, so the server is not flooded.
+ * Every completed request is reported by @a pageLoaded(), in the order they
+ * complete; nothing blocks, the results arrive through the event loop.
+ */
+class FetchScheduler : public QObject {
+  Q_OBJECT
+public:
+  FetchScheduler(QNetworkAccessManager * manager, int maxInFlight,
+    int hostInterval, QObject * parent = 0);
+  virtual ~FetchScheduler();
+
+  void enqueue(const QNetworkRequest& request, int tag);
+  void setTimeout(int timeout);
+
+  static void abortAfter(QNetworkReply * reply, int timeout);
+  static QString errorString(QNetworkReply * reply);
+
+signals:
+  /**
+   * A request is complete
+   * @param tag The tag passed to @a enqueue()
+   * @param reply The finished reply, see QNetworkReply::error() and
+   *  @a errorString(). It is deleted by the scheduler later.
+   */
+  void pageLoaded(int tag, QNetworkReply * reply);
+
+public slots:
+  void abort();
+
+protected slots:
+  void startRequests();
+  void replyFinished();
+
+private:
+  FetchScheduler(const FetchScheduler&);
+  FetchScheduler& operator=(const FetchScheduler&);
+
+  /** A request that has not been started yet */
+  struct Job {
+    QNetworkRequest request;
+    int tag;
+  };
+
+  QNetworkAccessManager * manager_;
+  /** Maximum number of requests in flight */
+  int maxInFlight_;
+  /** Minimum time in ms between the starts of two requests to one host */
+  int hostInterval_;
+  /** Time in ms after which a request is aborted, or 0 */
+  int timeout_;
+  /** Requests that have not been started yet */
+  QQueue<Job> queue_;
+  /** Tags of the requests in flight, by reply */
+  QHash<QNetworkReply *, int> inFlight_;
+  /** Time of the last request to every host, in ms of @a clock_ */
+  QHash<QString, int> lastStart_;
+  QTime clock_;
+  /** Whether @a startRequests() is scheduled on a timer */
+  bool timerPending_;
+  /** Whether @a abort() was called */
+  bool aborted_;
+};
+
+}
+
+#endif /* FETCHSCHEDULER_H_ */
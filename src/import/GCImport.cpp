@@ -0,0 +1,515 @@
+/**
+ * @file GCImport.cpp
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "import/GCImport.h"
+#include "import/GCSpiderCachePage.h"
+#include "logic/DatabaseWorker.h" // for the meta types
+#include <QUrl>
+#include <QRegExp>
+#include <QRunnable>
+#include <QSet>
+#include <QCryptographicHash>
+
+using namespace geojackal;
+
+/**
+ * Parses a detail page in a thread of the pool of a GCImport, and hands the
+ * geocache to GCImport::pageParsed() in the thread of the import.
+ */
+class ParseTask : public QRunnable {
+public:
+  ParseTask(GCImport * import, int tag, const QByteArray& data) :
+    import_(import), tag_(tag), data_(data) {
+  }
+
+  void run() {
+    QTime timer;
+    timer.start();
+    Geocache geocache;
+    bool ok = GCSpiderCachePage(QString(data_)).all(geocache);
+    QMetaObject::invokeMethod(import_, "pageParsed", Qt::QueuedConnection,
+      Q_ARG(int, tag_), Q_ARG(geojackal::Geocache, geocache), Q_ARG(bool, ok),
+      Q_ARG(int, timer.elapsed()));
+  }
+
+private:
+  GCImport * import_;
+  int tag_;
+  QByteArray data_;
+};
+
+/**
+ * Constructor
+ * @param spider The logged in session the pages are loaded with
+ * @param parent Parent object
+ */
+GCImport::GCImport(GCSpider * spider, QObject * parent) : QObject(parent),
+  spider_(spider), scheduler_(0), cache_(0), listReply_(0), maxDist_(0),
+  listDist_(0), done_(0), skipped_(0), next_(0), written_(0), recorded_(0),
+  fetchDepth_(0),
+  parseDepth_(0), bytes_(0), running_(false), replay_(false) {
+  qRegisterMetaType<Geocache>("geojackal::Geocache");
+}
+
+/**
+ * Destructor. Waits for the pages that are still being parsed, as their
+ * threads hold a pointer to the import.
+ */
+GCImport::~GCImport() {
+  stop();
+  parsers_.waitForDone();
+}
+
+/**
+ * Start to import the nearest geocaches around a coordinate up to a specified
+ * distance. The list pages are loaded one after the other, then the detail
+ * pages of the geocaches. Geocaches for which ImportBatch::needsFetch() says
+ * no are skipped, so a re-sync of an area only loads the detail pages of
+ * changed geocaches.
+ * @param center Center coordinates
+ * @param maxDist Maximum distance in km from loaded geocache to center point
+ * @throws Failure if the import cannot be started
+ */
+void GCImport::nearest(const Coordinate& center, float maxDist) {
+  center_ = center;
+  maxDist_ = maxDist;
+  listDist_ = 0;
+  list_.clear();
+  loadListPage(QByteArray());
+  running_ = true;
+  emit progress(0, 0, tr("%1 geocaches found…").arg(0));
+}
+
+/**
+ * Start to import a single geocache.
+ * @param waypoint Waypoint of the geocache (e.g. <em>GC132V6</em>)
+ * @throws Failure if the import cannot be started
+ */
+void GCImport::single(const QString& waypoint) {
+  if(!spider_->loggedIn()) {
+    throw Failure(tr("Not logged in!"));
+  }
+  if(!waypoint.startsWith("GC", Qt::CaseInsensitive)) {
+    throw Failure(tr("Waypoint must begin with \"GC\""));
+  }
+
+  ListEntry c;
+  c.wp = waypoint.toUpper();
+  c.key = "wp/" + c.wp;
+  list_.clear();
+  list_.append(c);
+  running_ = true;
+  loadDetailPages();
+}
+
+/**
+ * Start to parse all pages in the cache again, e.&nbsp;g. after the parser
+ * was fixed. Nothing is loaded from the network. Pages with the same
+ * contents are parsed only once. The known geocaches of the batch are
+ * ignored, so all geocaches are handed out.
+ * @throws Failure if there is no cache
+ */
+void GCImport::replay() {
+  if(!cache_) {
+    throw Failure(tr("There is no cache of geocache pages."));
+  }
+
+  QSet<QByteArray> hashes;
+  list_.clear();
+  foreach(QString key, cache_->keys()) {
+    QByteArray hash = cache_->page(key).hash;
+    if(!hashes.contains(hash)) {
+      hashes.insert(hash);
+      ListEntry c;
+      c.key = key;
+      list_.append(c);
+    }
+  }
+  replay_ = true;
+  running_ = true;
+  loadDetailPages();
+}
+
+/**
+ * Use a cache for the detail pages. Call this before starting the import.
+ * @param cache The open cache, or @c 0 to load all pages from the network
+ */
+void GCImport::setCache(PageCache * cache) {
+  cache_ = cache;
+}
+
+/**
+ * Stop the import. The requests in flight are aborted, and @a finished() is
+ * emitted; the batch keeps the geocaches loaded so far.
+ */
+void GCImport::abort() {
+  if(!running_) {
+    return;
+  }
+  stop();
+  finish();
+}
+
+/**
+ * Stop the import because of an error outside of it, e.&nbsp;g. when the
+ * geocaches cannot be written. Like @a abort(), but @a failed() is emitted.
+ * @param message Error message
+ */
+void GCImport::abort(const QString& message) {
+  if(!running_) {
+    return;
+  }
+  fail(message);
+}
+
+/**
+ * Report the number of geocaches that were handed out by @a geocachesReady()
+ * and are not written yet, see GeocacheModel::savingCount(). Fetching pauses
+ * while there are @a WRITE_BACKLOG of them.
+ * @param backlog Number of geocaches waiting for the database
+ */
+void GCImport::setWriteBacklog(int backlog) {
+  write_.queued = backlog;
+  write_.maxQueued = qMax(write_.maxQueued, backlog);
+  fill();
+}
+
+/**
+ * @internal
+ * Request a list page of the nearest geocaches.
+ * @param postData Form data for the "Next" action, or empty for the first page
+ * @throws Failure if the request cannot be sent
+ */
+void GCImport::loadListPage(const QByteArray& postData) {
+  listReply_ = spider_->loadPage(spider_->url(QString("/seek/nearest.aspx?"
+    "lat=%1&lng=%2").arg(center_.lat, 0, 'f').arg(center_.lon, 0, 'f')),
+    &postData);
+  connect(listReply_, SIGNAL(finished()), SLOT(listPageLoaded()));
+}
+
+/**
+ * @internal
+ * Called when a list page is loaded. Collects the geocaches on it, then
+ * loads the next list page, or the detail pages if the list is complete.
+ */
+void GCImport::listPageLoaded() {
+  QNetworkReply * reply = listReply_;
+  listReply_ = 0;
+  reply->deleteLater();
+  if(reply->error() != QNetworkReply::NoError) {
+    fail(FetchScheduler::errorString(reply));
+    return;
+  }
+  QString text = reply->readAll();
+
+  // Link to a geocache page
+  QRegExp gcRx("<tr bgcolor='[^']+'\\s*class=\"Data BorderTop\">\\s*<td>.*"
+    "([0-9]+(?:\\.[0-9]+)?)\\s*km\\s*</td>.*<a href=\"/seek/cache_details"
+    "\\.aspx\\?guid=([-0-9a-zA-Z]+)\">.*\\((GC[A-Z0-9]{4,})\\).*</a>");
+  gcRx.setMinimal(true);
+
+  // "Next" link
+  QRegExp nextRx("<a href=\"javascript:__doPostBack(.*)\"><b>Next &gt;</b>");
+  nextRx.setMinimal(true);
+
+  // parse geocache links and stuff them into a list
+  int curPos = 0;  // pos of last parsed gc regex, so we don't get them twice
+  while((curPos = gcRx.indexIn(text, curPos)) >= 0 && listDist_ <= maxDist_) {
+    curPos += gcRx.cap(0).size(); // move to end of current chunk
+    if(gcRx.cap(1).isEmpty() || gcRx.cap(2).isEmpty() ||
+      gcRx.cap(3).isEmpty()) {
+      fail(tr("The list of geocaches could not be read."));
+      return;
+    }
+
+    // check for distance
+    bool ok = false;
+    listDist_ = gcRx.cap(1).toDouble(&ok);
+    if(!ok) {
+      fail(tr("The list of geocaches could not be read."));
+      return;
+    }
+
+    // append to list for next step
+    ListEntry c;
+    c.guid = gcRx.cap(2);
+    c.wp = gcRx.cap(3);
+    c.key = "guid/" + c.guid;
+    // the rest of the row shows the date of the last log
+    int rowEnd = text.indexOf("</tr>", curPos);
+    c.listHash = QCryptographicHash::hash(text.mid(gcRx.pos(2),
+      rowEnd < 0 ? -1 : rowEnd - gcRx.pos(2)).toUtf8(),
+      QCryptographicHash::Sha1);
+    qDebug() << "append {" << c.guid << "," << c.wp << "}";
+    list_.append(c);
+  }
+
+  emit progress(0, 0, tr("%1 geocaches found…").arg(list_.size()));
+
+  // if there are more geocache links: get next page
+  if(listDist_ <= maxDist_ && nextRx.indexIn(text) > 0) {
+    // POST data for "Next" action
+    QMap<QString,QString> fields = spider_->getAspFormFields(text);
+    fields["__EVENTTARGET"] = "ctl00$ContentBody$pgrBottom$ctl08";
+    QByteArray postData;
+    foreach(QString field, fields.keys()) {
+      postData.append(QUrl::toPercentEncoding(field));
+      postData.append("=");
+      postData.append(QUrl::toPercentEncoding(fields.value(field)));
+      postData.append("&");
+    }
+    try {
+      loadListPage(postData);
+    } catch(Failure& f) {
+      fail(f.what());
+    }
+    return;
+  }
+
+  loadDetailPages();
+}
+
+/**
+ * @internal
+ * Load the detail pages of the geocaches in the list through the pipeline,
+ * from the network or, with @a replay(), from the cache.
+ */
+void GCImport::loadDetailPages() {
+  done_ = 0;
+  skipped_ = 0;
+  next_ = 0;
+  written_ = batch_.size();
+  recorded_ = batch_.fetchRecords().size();
+  batch_.reserve(batch_.size() + list_.size());
+  if(!replay_) {
+    scheduler_ = new FetchScheduler(spider_->networkAccessManager(),
+      g_settings->fetchConcurrency(), g_settings->fetchInterval(), this);
+    scheduler_->setTimeout(g_settings->fetchTimeout());
+    connect(scheduler_, SIGNAL(pageLoaded(int, QNetworkReply *)),
+      SLOT(detailPageLoaded(int, QNetworkReply *)));
+  }
+
+  // enough pages in each queue to keep the next stage busy
+  fetchDepth_ = 2 * qMax(1, g_settings->fetchConcurrency());
+  parseDepth_ = 2 * parsers_.maxThreadCount();
+  clock_.start();
+
+  emit progress(0, list_.size(), tr("Loading %1/%2").arg(0).
+    arg(list_.size()));
+  fill();
+}
+
+/**
+ * @internal
+ * Start fetching the next geocaches of the list, as long as no stage of the
+ * pipeline is full. Geocaches that need not be fetched are skipped. With
+ * @a replay(), the pages are read from the cache instead. Finishes the
+ * import when all geocaches are done.
+ */
+void GCImport::fill() {
+  if(!running_ || fetchDepth_ == 0) {
+    return; // the pipeline is not started yet
+  }
+  while(next_ < list_.size() && fetch_.queued < fetchDepth_ &&
+    parse_.queued < parseDepth_ && write_.queued < WRITE_BACKLOG) {
+    const ListEntry& c = list_.at(next_);
+    if(replay_) {
+      QByteArray data = cache_->data(c.key);
+      if(data.isEmpty()) {
+        ++skipped_;
+        ++done_;
+      } else {
+        parse(next_, data);
+      }
+    } else if(batch_.needsFetch(c.wp, c.listHash)) {
+      QString query = c.guid.isEmpty() ? QString("wp=" + c.wp) :
+        QString("guid=" + c.guid);
+      QNetworkRequest request = spider_->request(spider_->url(
+        "/seek/cache_details.aspx?" + query));
+      if(cache_) {
+        cache_->addValidators(c.key, request);
+      }
+      fetch_.enter();
+      scheduler_->enqueue(request, next_);
+    } else {
+      ++skipped_;
+      ++done_;
+    }
+    ++next_;
+  }
+
+  if(done_ == list_.size()) {
+    finish();
+  }
+}
+
+/**
+ * @internal
+ * Called when a detail page is loaded. The page is stored in the cache, or
+ * taken from it if it was not modified, and handed to the parser threads.
+ * @param tag Index of the geocache in the list
+ * @param reply The finished reply
+ */
+void GCImport::detailPageLoaded(int tag, QNetworkReply * reply) {
+  fetch_.leave();
+  if(reply->error() != QNetworkReply::NoError) {
+    fail(FetchScheduler::errorString(reply));
+    return;
+  }
+  if(cache_) {
+    parse(tag, cache_->store(list_.at(tag).key, reply));
+  } else {
+    parse(tag, reply->readAll());
+  }
+  fill();
+}
+
+/**
+ * @internal
+ * Hand a detail page to the parser threads.
+ * @param tag Index of the geocache in the list
+ * @param data Contents of the page
+ */
+void GCImport::parse(int tag, const QByteArray& data) {
+  bytes_ += data.size();
+  parse_.enter();
+  parsers_.start(new ParseTask(this, tag, data));
+}
+
+/**
+ * @internal
+ * Called when a parser thread has parsed a detail page. The geocache is
+ * added to the batch, and handed out when a block is complete.
+ * @param tag Index of the geocache in the list
+ * @param geocache The parsed geocache
+ * @param ok The result of GCSpiderCachePage::all()
+ * @param time Time in ms it took to parse the page
+ */
+void GCImport::pageParsed(int tag, const Geocache& geocache, bool ok,
+  int time) {
+  if(!running_) {
+    return; // aborted in the meantime
+  }
+  parse_.leave();
+  parse_.time += time;
+
+  const ListEntry& c = list_.at(tag);
+  ++done_;
+  emit progress(done_, list_.size(), tr("Loading %1/%2: %3").arg(done_).
+    arg(list_.size()).arg(geocache.waypoint));
+  batch_.add(geocache, ok, c.listHash);
+
+  if(batch_.size() - written_ >= WRITE_BATCH_SIZE) {
+    flush();
+  }
+  fill();
+}
+
+/**
+ * @internal
+ * Hand out the geocaches parsed since the last call by @a geocachesReady(),
+ * with their fetch records. Cached pages that are parsed again were not
+ * fetched now, so they have no records.
+ */
+void GCImport::flush() {
+  const QVector<Geocache>& geocaches = batch_.geocaches();
+  const QVector<FetchRecord>& fetches = batch_.fetchRecords();
+  if(written_ >= geocaches.size() && recorded_ >= fetches.size()) {
+    return;
+  }
+  QVector<Geocache> block;
+  block.reserve(geocaches.size() - written_);
+  for(; written_ < geocaches.size(); ++written_) {
+    block.append(geocaches.at(written_));
+  }
+  QVector<FetchRecord> records;
+  for(; recorded_ < fetches.size(); ++recorded_) {
+    if(!replay_) {
+      records.append(fetches.at(recorded_));
+    }
+  }
+  write_.done += block.size();
+  emit geocachesReady(block, records);
+}
+
+/**
+ * @internal
+ * End the import, hand out the rest of the geocaches and emit
+ * @a finished().
+ */
+void GCImport::finish() {
+  running_ = false;
+  flush();
+  qDebug() << "finished import from geocaching.com," << skipped_ <<
+    "geocaches skipped," << batch_.unchanged() << "unchanged";
+  logStats();
+  emit finished();
+}
+
+/**
+ * @internal
+ * Stop the import because of an error, and emit @a failed().
+ * @param message Error message
+ */
+void GCImport::fail(const QString& message) {
+  stop();
+  running_ = false;
+  flush();
+  logStats();
+  emit failed(message);
+}
+
+/**
+ * @internal
+ * Abort all requests in flight. Pages that are being parsed are ignored when
+ * they arrive.
+ */
+void GCImport::stop() {
+  if(listReply_) {
+    listReply_->disconnect(this);
+    listReply_->abort();
+    listReply_->deleteLater();
+    listReply_ = 0;
+  }
+  if(scheduler_) {
+    scheduler_->abort();
+  }
+}
+
+/**
+ * @internal
+ * Log the throughput of the stages of the pipeline, to find the one that
+ * limits the import.
+ */
+void GCImport::logStats() const {
+  if(clock_.isNull()) {
+    return; // the pipeline was not started
+  }
+  double secs = qMax(1, clock_.elapsed()) / 1000.0;
+  qDebug() << "import pipeline ran" << secs << "s";
+  qDebug() << "  fetch:" << fetch_.done << "pages," << fetch_.done / secs <<
+    "pages/s, at most" << fetch_.maxQueued << "queued";
+  qDebug() << "  parse:" << parse_.done << "pages," << bytes_ / 1024 <<
+    "KiB," << parse_.done / secs << "pages/s, busy" << parse_.time <<
+    "ms in" << parsers_.maxThreadCount() << "threads, at most" <<
+    parse_.maxQueued << "queued";
+  qDebug() << "  write:" << write_.done << "geocaches," << write_.done / secs <<
+    "geocaches/s, at most" << write_.maxQueued << "waiting for the database";
+}
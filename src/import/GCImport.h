@@ -0,0 +1,216 @@
+/**
+ * @file GCImport.h
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCIMPORT_H_
+#define GCIMPORT_H_
+
+#include "global.h"
+#include "logic/Coordinate.h"
+#include "import/GCSpider.h"
+#include "import/ImportBatch.h"
+#include "import/FetchScheduler.h"
+#include "import/PageCache.h"
+#include <QObject>
+#include <QList>
+#include <QTime>
+#include <QThreadPool>
+#include <QNetworkReply>
+
+namespace geojackal {
+
+/**
+ * One import of geocaches from geocaching.com into an ImportBatch. The import
+ * runs in the background, driven by the event loop: @a nearest() and
+ * @a single() return at once, the import reports its progress with
+ * @a progress(), and ends with @a finished() or @a failed(). Each request of
+ * the import has its own QNetworkReply, so several imports do not interfere.
+ * The spider must be logged in.
+ *
+ * The detail pages go through a pipeline of three stages that run at the
+ * same time: the pages are fetched by a FetchScheduler, parsed by a pool of
+ * threads, and handed out in blocks of @a WRITE_BATCH_SIZE geocaches by
+ * @a geocachesReady(), to be written by the database thread. Every stage
+ * has a bounded queue, and no more pages are fetched while one of them is
+ * full, so a large import runs at the speed of the slowest stage. Report the
+ * geocaches not yet written with @a setWriteBacklog().
+ *
+ * With a PageCache, the raw detail pages are stored, and requested again
+ * with a conditional GET. @a replay() parses all cached pages again without
+ * any network access.
+ */
+class GCImport : public QObject {
+  Q_OBJECT
+public:
+  GCImport(GCSpider * spider, QObject * parent = 0);
+  virtual ~GCImport();
+
+  /** Number of parsed geocaches handed out at once */
+  static const int WRITE_BATCH_SIZE = 50;
+  /** Number of geocaches waiting for the database at which fetching pauses */
+  static const int WRITE_BACKLOG = 500;
+
+  void nearest(const Coordinate& center, float maxDist);
+  void single(const QString& waypoint);
+  void replay();
+  void setCache(PageCache * cache);
+
+  /**
+   * @return the batch that receives the geocaches. Call
+   *  ImportBatch::setKnown() on it before starting the import.
+   */
+  inline ImportBatch& batch() {
+    return batch_;
+  }
+  /** @return whether the import is still running */
+  inline bool running() const {
+    return running_;
+  }
+
+signals:
+  /**
+   * The import made progress
+   * @param done Number of geocaches done
+   * @param total Number of geocaches to load, or 0 while the list of
+   *  geocaches is still being loaded
+   * @param text Description of the current step
+   */
+  void progress(int done, int total, const QString& text);
+  /**
+   * Parsed geocaches are ready to be written. They also stay in the batch.
+   * The rest is handed out before @a finished() or @a failed().
+   * @param geocaches The geocaches parsed since the last call
+   * @param records The fetch records since the last call, including those of
+   *  unchanged geocaches; empty for @a replay()
+   */
+  void geocachesReady(const QVector<geojackal::Geocache>& geocaches,
+    const QVector<geojackal::FetchRecord>& records);
+  /**
+   * The import is complete, or was aborted. The batch holds the geocaches
+   * loaded so far.
+   */
+  void finished();
+  /**
+   * The import stopped because of an error. The batch holds the geocaches
+   * loaded so far.
+   * @param message Error message
+   */
+  void failed(const QString& message);
+
+public slots:
+  void abort();
+  void abort(const QString& message);
+  void setWriteBacklog(int backlog);
+
+protected slots:
+  void listPageLoaded();
+  void detailPageLoaded(int tag, QNetworkReply * reply);
+  void pageParsed(int tag, const geojackal::Geocache& geocache, bool ok,
+    int time);
+
+protected:
+  void loadListPage(const QByteArray& postData);
+  void loadDetailPages();
+  void fill();
+  void parse(int tag, const QByteArray& data);
+  void flush();
+  void finish();
+  void fail(const QString& message);
+  void stop();
+  void logStats() const;
+
+private:
+  GCImport(const GCImport&);
+  GCImport& operator=(const GCImport&);
+
+  /** A geocache on the list pages */
+  struct ListEntry {
+    QString wp;
+    /** GUID of the detail page, or empty to load it by waypoint */
+    QString guid;
+    /** Hash of the row on the list page, without the distance */
+    QByteArray listHash;
+    /** Key of the detail page in the PageCache */
+    QString key;
+  };
+
+  /** Counters of one stage of the pipeline */
+  struct Stage {
+    Stage() : done(0), queued(0), maxQueued(0), time(0) {}
+    /** An item enters the stage */
+    inline void enter() {
+      maxQueued = qMax(maxQueued, ++queued);
+    }
+    /** An item leaves the stage */
+    inline void leave() {
+      --queued;
+      ++done;
+    }
+    /** Items that passed the stage */
+    int done;
+    /** Items waiting for or in the stage */
+    int queued;
+    /** Most items that were in the stage at once */
+    int maxQueued;
+    /** Time in ms the stage was busy, summed over its threads */
+    int time;
+  };
+
+  GCSpider * spider_;
+  ImportBatch batch_;
+  /** Loads the detail pages, or @c 0 before they are loaded */
+  FetchScheduler * scheduler_;
+  /** Cache of the detail pages, or @c 0 */
+  PageCache * cache_;
+  /** Reply of the list page in flight, or @c 0 */
+  QNetworkReply * listReply_;
+  /** Center of the area of @a nearest() */
+  Coordinate center_;
+  /** Maximum distance in km of @a nearest() */
+  float maxDist_;
+  /** Distance of the last geocache on the list pages */
+  double listDist_;
+  /** Geocaches whose detail pages are loaded */
+  QList<ListEntry> list_;
+  /** Number of geocaches done, and of those skipped */
+  int done_, skipped_;
+  /** Index of the next geocache in the list to be fetched */
+  int next_;
+  /** Number of geocaches in the batch handed out by @a geocachesReady() */
+  int written_;
+  /** Number of fetch records in the batch handed out likewise */
+  int recorded_;
+  /** Limits of the fetch and parse queues */
+  int fetchDepth_, parseDepth_;
+  /** Bytes of the parsed detail pages */
+  qint64 bytes_;
+  /** The stages of the pipeline */
+  Stage fetch_, parse_, write_;
+  /** Threads that parse the detail pages */
+  QThreadPool parsers_;
+  /** Time since the detail pages are loaded */
+  QTime clock_;
+  bool running_;
+  /** Whether the cached pages are parsed again, see @a replay() */
+  bool replay_;
+};
+
+}
+
+#endif /* GCIMPORT_H_ */
@@ -19,15 +19,11 @@
  */
 
 #include "import/GCSpider.h"
-#include "import/GCSpiderCachePage.h"
-#include <QtGui>
+#include "import/FetchScheduler.h"
 #include <QNetworkRequest>
 #include <QNetworkReply>
-#include <QEventLoop>
 #include <QRegExp>
 
-#include <QStringList>
-
 using namespace geojackal;
 
 const QByteArray GCSpider::USER_AGENT = "Mozilla/5.0 (X11; U; Linux x86; "
@@ -39,7 +35,7 @@ GCSpider * GCSpider::instance_ = 0;
  * Constructor.
  */
 GCSpider::GCSpider() :
-  pnam_(0), loadPageNetReply_(0), loggedIn_(false) {
+  pnam_(0), loginReply_(0), loggedIn_(false) {
   pnam_ = new QNetworkAccessManager(this);
 }
 
@@ -51,16 +47,49 @@ GCSpider::~GCSpider() {
 }
 
 /**
- * Load a web page over HTTP. If the member variable @a loginCookies_ contains
- * cookies, these are also included in the HTTP request.
+ * @return The GCSpider instance. It is created on the first call.
+ */
+GCSpider * GCSpider::instance() {
+  static Guard guard; // delete the instance at end of run time
+
+  if(!instance_) {
+    instance_ = new GCSpider;
+  }
+  return instance_;
+}
+
+/**
+ * Get the URL of a page of geocaching.com. The server is taken from
+ * SettingsManager::gcBaseUrl(), so a local stand-in can be used instead.
+ * @param path Path and query of the page, beginning with a slash
+ */
+QUrl GCSpider::url(const QString& path) const {
+  return QUrl(g_settings->gcBaseUrl() + path);
+}
+
+/**
+ * Create a request for a page of geocaching.com, with our HTTP headers. The
+ * Host header is set by QNetworkAccessManager from the URL.
+ * @param url URL of the page, see @a url()
+ */
+QNetworkRequest GCSpider::request(const QUrl& url) const {
+  QNetworkRequest req = QNetworkRequest(url);
+  req.setRawHeader("User-Agent", USER_AGENT);
+  return req;
+}
+
+/**
+ * Start loading a web page over HTTP. The cookies of the login are included
+ * in the request. This function returns at once; connect to the
+ * QNetworkReply::finished() signal of the reply to get the page. If the
+ * server does not answer within SettingsManager::fetchTimeout(), the reply is
+ * aborted.
  * @param url URL to load
  * @param formData If this parameter is set, an HTTP POST request is sent, along
  *  with this form data. Otherwise, an HTTP GET request is sent.
- * @return The QNetworkReply received by the unterlying framework. You can use
- * this request to get the HTTP headers and the contents of the page. Do not
- * delete the request by yourself, instead, you can use
- * QNetworkReply::deleteLater().
- * @throws Failure if anything goes wrong
+ * @return The QNetworkReply of this request, which belongs to the caller.
+ *  Delete it with QNetworkReply::deleteLater().
+ * @throws Failure if the request cannot be sent
  */
 QNetworkReply * GCSpider::loadPage(const QUrl& url, const QByteArray *
   formData) {
@@ -72,42 +101,18 @@ QNetworkReply * GCSpider::loadPage(const QUrl& url, const QByteArray *
     throw Failure(tr("Only URLs beginning with http:// are supported"));
   }
 
-  // prepare network request
-  connect(pnam_, SIGNAL(finished(QNetworkReply *)), this,
-    SLOT(loadPageFinished(QNetworkReply*)));
-  QNetworkRequest req = QNetworkRequest(url);
-  req.setRawHeader("User-Agent", USER_AGENT);
-  req.setRawHeader("Host", "www.geocaching.com");
+  QNetworkRequest req = request(url);
+  QNetworkReply * reply;
   if(formData != 0) {
     qDebug() << "fetching" << url.toString(); //<< "with POST data" << *formData;
-    pnam_->post(req, *formData);
+    reply = pnam_->post(req, *formData);
   } else {
     // HTTP GET
     qDebug() << "fetching" << url.toString();
-    pnam_->get(req);
+    reply = pnam_->get(req);
   }
-  // execute an event loop to process the request (nearly-synchronous)
-  QEventLoop eventLoop;
-  connect(pnam_, SIGNAL(finished(QNetworkReply *)), &eventLoop, SLOT(quit()));
-  eventLoop.exec();
-
-  // loadPageFinished() stuffs the QNetworkReply to loadPageNetReply_
-
-  if(loadPageNetReply_->error() != QNetworkReply::NoError) {
-    throw Failure(loadPageNetReply_->errorString());
-  }
-  return loadPageNetReply_;
-}
-
-/**
- * @internal
- * Called from @a loadPage() when the QNetworkAccessManager finishes to load a
- * geocache page. This function just saves the network reply for later use to
- * the member @a loadPageNetReply_.
- * @param reply Network reply
- */
-void GCSpider::loadPageFinished(QNetworkReply * reply) {
-  loadPageNetReply_ = reply;
+  FetchScheduler::abortAfter(reply, g_settings->fetchTimeout());
+  return reply;
 }
 
 /**
@@ -139,35 +144,24 @@ QMap<QString,QString> GCSpider::getAspFormFields(const QString& htmlText) {
 /**
  * Log in to geocaching.com.
  * Logs the user in and saves the HTTP authentication cookie for later use.
- * This function blocks until the login cookie has ben retrieved. The cookies
- * are saved to the loginCookie_ member variable, and the loggedIn_ member
- * variable is set according to whether the login was successful.
- *
- * User name and password can be empty if this function was previously called;
- * in this case, the previous user name and password are used.
+ * This function returns at once, @a loginSucceeded() or @a loginFailed() is
+ * emitted when the login is complete. The cookies stay in the cookie jar of
+ * the QNetworkAccessManager, and the loggedIn_ member variable is set
+ * according to whether the login was successful. A login that is still in
+ * flight is cancelled.
  *
  * @param username geocaching.com user name to use for log in
  * @param password geocaching.com password to use for log in
- * @return An GCSpider instance that can be used for further operations.
- * @throws Failure if anything goes wrong
+ * @throws Failure if user name or password are empty
  */
-GCSpider * GCSpider::login(const QString username = "",
-  const QString password = "") {
-
-  static Guard guard; // delete the instance at end of run time
-
-  // instanciate ourself
-  if(!instance_) {
-    instance_ = new GCSpider;
-  }
-
-  // use previous login data, if possible and nothing else given
-  if((username == "" || password == "") && instance_->loggedIn()) {
-    return instance_;
+void GCSpider::login(const QString& username, const QString& password) {
+  // log out to prevent interference with old session cookies
+  if(loginReply_) {
+    loginReply_->disconnect(this);
+    loginReply_->abort();
+    loginReply_->deleteLater();
+    loginReply_ = 0;
   }
-
-  // otherwise, do login with provided account data
-  // but first log out to prevent interference with old session cookies
   logout();
 
   if(username.trimmed().isEmpty()) {
@@ -210,8 +204,25 @@ GCSpider * GCSpider::login(const QString username = "",
   postData.append(QUrl::toPercentEncoding(password));
 
   // Request login page
-  QNetworkReply * reply = instance_->loadPage(QUrl("http://www.geocaching.com/"
-    "login/Default.aspx"), &postData);
+  loginUser_ = username;
+  loginReply_ = loadPage(url("/login/Default.aspx"), &postData);
+  connect(loginReply_, SIGNAL(finished()), SLOT(loginPageLoaded()));
+}
+
+/**
+ * @internal
+ * Called when the login page of @a login() is loaded. Validates the login
+ * cookies and reports the result.
+ */
+void GCSpider::loginPageLoaded() {
+  QNetworkReply * reply = loginReply_;
+  loginReply_ = 0;
+  reply->deleteLater();
+  if(reply->error() != QNetworkReply::NoError) {
+    emit loginFailed(FetchScheduler::errorString(reply));
+    return;
+  }
+
   // extract and validate cookies
   QList<QNetworkCookie> loginCookies;
   QVariant var = reply->header(QNetworkRequest::SetCookieHeader);
@@ -226,20 +237,21 @@ GCSpider * GCSpider::login(const QString username = "",
         userIdCookie = true;
       }
     }
-    instance_->loggedIn_ = aspNetCookie && userIdCookie;
+    loggedIn_ = aspNetCookie && userIdCookie;
   } else {
     // who took the cookies from the cookie jar?
-    instance_->loggedIn_ = false;
-    throw Failure(tr("Login failed: No valid login cookies found!"));
+    loggedIn_ = false;
+    emit loginFailed(tr("Login failed: No valid login cookies found!"));
+    return;
   }
 
-  if(!instance_->loggedIn_) {
+  if(!loggedIn_) {
     // delete all cookies, so the server does not remember us in any way
-    instance_->pnam_->setCookieJar(new QNetworkCookieJar);
-    throw Failure(tr("Login failed with username %1").arg(username));
+    pnam_->setCookieJar(new QNetworkCookieJar);
+    emit loginFailed(tr("Login failed with username %1").arg(loginUser_));
+    return;
   }
-  reply->deleteLater();
-  return instance_;
+  emit loginSucceeded();
 }
 
 /**
@@ -252,161 +264,3 @@ void GCSpider::logout() {
     instance_->loggedIn_ = false;
   }
 }
-
-/** Temporary type to save geocache GUIDs and waypoints */
-struct WaypointsGuids {
-  QString wp;
-  QString guid;
-};
-
-/**
- * Get nearest geocaches around a coordinate up to a specified distance.
- * @param center Center coordinates
- * @param maxDist Maximum distance in km from loaded geocache to center point
- * @param buf Buffer that receives the geocaches to be retrieved. The calling
- *  context is responsible for freeing the members of this vector.
- * @return @c true if all geocaches could be retrieved correctly, @c false
- *  otherwise
- * @throws Failure if anything goes wrong
- */
-bool GCSpider::nearest(const Coordinate center, const float maxDist, QList<
-  Geocache *>& buf) {
-
-//  // cap order: bearing, distance, geocache guid
-//  QRegExp gcRx("<tr .*class=\"Data BorderTop\">\\s*<td><img .* />(N|S|E|W|NW"
-//    "|NE|SE|SW)<br />([0-9]+(?:\\.[0-9])?+)km\\s*</td>\\s*<td>\\s*</td>\\s*<td>"
-//    "<a .*>\\s*<img .* /></a>.*</td>\\s*<td>.*</td><td>.*</td>\\s*<td><a .*"
-//    "href=\"/seek/cache_details.aspx?guid=([-0-9a-f]{36})\".*>.*</a>.*</td>");
-//  QRegExp gcRx("<tr bgcolor='[^\']+'\\s*class=\"Data BorderTop\">\\s*<td>.*<br />\\s*"
-//    "([0-9]+(?:\\.[0-9]+)?)\\s*km\\s*</td>.*"
-//    "<a href=\"/seek/cache_details.aspx?guid=(.{36})\">");
-
-  // Link to a geocache page
-  QRegExp gcRx("<tr bgcolor='[^']+'\\s*class=\"Data BorderTop\">\\s*<td>.*"
-    "([0-9]+(?:\\.[0-9]+)?)\\s*km\\s*</td>.*<a href=\"/seek/cache_details"
-    "\\.aspx\\?guid=([-0-9a-zA-Z]+)\">.*\\((GC[A-Z0-9]{4,})\\).*</a>");
-  gcRx.setMinimal(true);
-
-  // "Next" link
-  QRegExp nextRx("<a href=\"javascript:__doPostBack(.*)\"><b>Next &gt;</b>");
-  nextRx.setMinimal(true);
-
-  QProgressDialog progDialog(tr("Import geocaches"), tr("Abort"), 0, 1);
-  progDialog.setWindowModality(Qt::WindowModal);
-  progDialog.setMinimumDuration(0);
-  progDialog.setValue(0);
-  progDialog.setLabelText(tr("%1 geocaches found…").arg(0));
-
-  QString viewState;
-  QList<WaypointsGuids> geocacheList;
-  double geocacheDist = 0; // distance to current geocache
-  QByteArray postData;
-  QString text;
-
-  do { // while "Next" link exists
-
-    QNetworkReply * listReply = loadPage(QUrl(QString("http://www.geocaching"
-      ".com/seek/nearest.aspx?lat=%1&lng=%2").arg(center.lat, 0, 'f').
-      arg(center.lon, 0, 'f')), &postData);
-    int curPos = 0;  // pos of last parsed gc regex, so we don't get them twice
-    text = listReply->readAll();
-
-    // parse geocache links and stuff them into a list
-    while((curPos = gcRx.indexIn(text, curPos)) >= 0 &&
-      geocacheDist <= maxDist && !progDialog.wasCanceled()) {
-      curPos += gcRx.cap(0).size(); // move to end of current chunk
-      if(gcRx.cap(1).isEmpty() || gcRx.cap(2).isEmpty() ||
-        gcRx.cap(3).isEmpty()) {
-        return false; // something went wrong
-      }
-
-      // check for distance
-      bool ok = false;
-      geocacheDist = gcRx.cap(1).toDouble(&ok);
-      if(!ok) {
-        return false;
-      }
-
-      // append to list for next step
-      WaypointsGuids c;
-      c.guid = gcRx.cap(2);
-      c.wp = gcRx.cap(3);
-      qDebug() << "append {" << c.guid << "," << c.wp << "}";
-      geocacheList.append(c);
-    }
-
-    progDialog.setLabelText(tr("%1 geocaches found…").arg(geocacheList.size()));
-
-    // if no more geocache links: get next page
-    if(geocacheDist > maxDist) {
-      break;
-    }
-
-    listReply->deleteLater();
-
-    // POST data for "Next" action
-    QMap<QString,QString> fields = getAspFormFields(text);
-    fields["__EVENTTARGET"] = "ctl00$ContentBody$pgrBottom$ctl08";
-    postData = "";
-    foreach(QString field, fields.keys()) {
-      postData.append(QUrl::toPercentEncoding(field));
-      postData.append("=");
-      postData.append(QUrl::toPercentEncoding(fields.value(field)));
-      postData.append("&");
-    }
-
-  } while(nextRx.indexIn(text) > 0);
-
-  // second part: load geocache descriptions
-  int progress = 0;
-  progDialog.setMaximum(geocacheList.size());
-  foreach(WaypointsGuids const& c, geocacheList) {
-    if(progDialog.wasCanceled()) {
-      break;
-    }
-    progress++;
-    progDialog.setLabelText(QString(tr("Loading %1/%2: %3")).arg(progress).
-      arg(geocacheList.size()).arg(c.wp));
-    progDialog.setValue(progress);
-
-    // load geocache page and extract data
-    QNetworkReply * geocacheReply = loadPage(QUrl("http://www.geocaching.com/"
-        "seek/cache_details.aspx?guid=" + c.guid));
-    GCSpiderCachePage gcscp(QString(geocacheReply->readAll()));
-    Geocache * pgc = new Geocache;
-    gcscp.all(*pgc);
-    buf.append(pgc);
-  }
-
-  progDialog.setValue(progDialog.maximum());
-
-  qDebug() << "finished import from geocaching.com";
-
-  return true;
-}
-
-/**
- * Load a single geocache.
- * @param waypoint Waypoint of the geocache (e.g. <em>GC132V6</em>)
- * @param buf Buffer that receives the retrieved geocache data. The calling
- *  context is responsible for freeing the members of this vector.
- * @return @c true if the geocache could be retrieved correctly, @c false
- *  otherwise
- */
-bool GCSpider::single(QString waypoint, Geocache& buf) {
-  // @todo
-  // try to login
-  if(!loggedIn_) {
-    throw Failure(tr("Not logged in!"));
-  }
-  if(!waypoint.startsWith("GC", Qt::CaseInsensitive)) {
-    throw Failure(tr("Waypoint must begin with \"GC\""));
-  }
-
-  QNetworkReply * reply = loadPage(QUrl("http://www.geocaching.com/seek/cache_"
-    "details.aspx?wp=" + waypoint));
-
-  QString content = reply->readAll();
-  GCSpiderCachePage gcscp(content);
-  return gcscp.all(buf);
-}
@@ -22,11 +22,10 @@
 #define GCSPIDER_H_
 
 #include "global.h"
-#include "logic/Geocache.h"
-#include "logic/Coordinate.h"
 #include <QObject>
 #include <QString>
 #include <QList>
+#include <QMap>
 #include <QNetworkAccessManager>
 #include <QNetworkCookie>
 
@@ -35,23 +34,27 @@ using namespace std;
 namespace geojackal {
 
 /**
- * Class that encapsulate functionalty to retrieve geocaches from the
- * geocaching.com database.
+ * Class that encapsulate the session with geocaching.com: the login and the
+ * HTTP communication. Geocaches are retrieved with a GCImport.
  *
  * This class is intented to use as a singleton, the instance can be acquired
- * by calling @a login().
+ * by calling @a instance(). Nothing in this class blocks: every request gets
+ * its own QNetworkReply, and the result of @a login() is reported by the
+ * signals @a loginSucceeded() and @a loginFailed().
  */
 class GCSpider : public QObject {
   Q_OBJECT
 
 public:
 
-  static GCSpider * login(const QString username, const QString password);
+  static GCSpider * instance();
   static void logout();
 
-  bool nearest(const Coordinate center, const float maxDist,
-    QList<Geocache *>& buf);
-  bool single(const QString waypoint, Geocache& buf);
+  void login(const QString& username, const QString& password);
+
+  QUrl url(const QString& path) const;
+  QNetworkRequest request(const QUrl& url) const;
+  QNetworkReply * loadPage(const QUrl& url, const QByteArray * formData = 0);
 
   QMap<QString,QString> getAspFormFields(const QString& htmlText);
 
@@ -64,11 +67,24 @@ public:
   inline bool loggedIn() {
     return loggedIn_;
   }
-public slots:
-  void loadPageFinished(QNetworkReply * reply);
+  /**
+   * @return the QNetworkAccessManager that holds the login cookies
+   */
+  inline QNetworkAccessManager * networkAccessManager() {
+    return pnam_;
+  }
 
-protected:
-  QNetworkReply * loadPage(const QUrl& url, const QByteArray * formData = 0);
+signals:
+  /** The login started by @a login() succeeded */
+  void loginSucceeded();
+  /**
+   * The login started by @a login() failed
+   * @param message Error message
+   */
+  void loginFailed(const QString& message);
+
+protected slots:
+  void loginPageLoaded();
 
 private:
   GCSpider();
@@ -77,8 +93,10 @@ private:
 
   /** QNetworkAccessManager instance for HTTP communication */
   QNetworkAccessManager * pnam_;
-  /** QNetworkReply of the currently loaded page, used by @a loadPage() */
-  QNetworkReply * loadPageNetReply_;
+  /** Reply of the login request in flight, or @c 0 */
+  QNetworkReply * loginReply_;
+  /** User name of the login in flight */
+  QString loginUser_;
   /** Is the user already logged in? */
   bool loggedIn_;
 
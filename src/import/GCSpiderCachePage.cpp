@@ -78,24 +78,21 @@ bool GCSpiderCachePage::all(Geocache& buf) const {
 //  qDebug() << buf.waypoint;
   ret &= type(buf.type);
 //  qDebug() << buf.type;
-  if(!buf.coord) buf.coord = new Coordinate;
-  ret &= coord(*buf.coord);
-  ret &= desc(buf.desc);
-  ret &= shortDesc(buf.shortDesc);
+  ret &= coord(buf.coord);
+  QString text;
+  ret &= desc(text);
+  buf.desc = CompressedText(text);
+  ret &= shortDesc(text);
+  buf.shortDesc = CompressedText(text);
   ret &= ((buf.size = size()) != SIZE_UNKNOWN);
   ret &= ((buf.difficulty = difficulty()) != 0);
   ret &= ((buf.terrain = terrain()) != 0);
-  if(!buf.placed) buf.placed = new QDate;
-  ret &= placed(*buf.placed);
-  if(!buf.found) buf.found = new QDate;
-  ret &= found(*buf.found);
+  ret &= placed(buf.placed);
+  ret &= found(buf.found);
   ret &= owner(buf.owner);
-  if(!buf.waypoints) buf.waypoints = new QVector<Waypoint>;
-  ret &= waypoints(*buf.waypoints);
-  if(!buf.logs) buf.logs = new QVector<LogMessage>;
-  ret &= logs(*buf.logs);
-  if(!buf.attrs) buf.attrs = new QVector<GeocacheAttribute>;
-  ret &= attrs(*buf.attrs);
+  ret &= waypoints(buf.waypoints);
+  ret &= logs(buf.logs);
+  ret &= attrs(buf.attrs);
   ret &= hint(buf.hint);
   buf.archived = archived();
   return ret;
@@ -515,13 +512,13 @@ bool GCSpiderCachePage::waypoints(QVector<Waypoint>& buf) const {
     // Coordinate
     QString coord = rx.cap(3);
     GCSpiderCachePage cs(coord);
-    if(!cs.coord(*wp.coord)) {
+    if(!cs.coord(wp.coord)) {
       return false;
     }
 
     // Note
     if(!rx.cap(4).isEmpty()) {
-      wp.desc = rx.cap(4).trimmed();
+      wp.desc = CompressedText(rx.cap(4).trimmed());
     }
 
     buf.append(wp);
@@ -582,6 +579,8 @@ bool GCSpiderCachePage::logs(QVector<LogMessage>& buf) const {
     "(.*)</a>\\s*</strong>\\s+(?:\\d*\\s+found)<br />\\s*<br />(.*)<br />\\s*"
     "<br /><small><a .*>View Log</a>\\s*</small>\\s*</td>\\s*</tr>");
   rx.setMinimal(true);
+  // the link to the log page carries its identifier
+  QRegExp idRx("log\\.aspx\\?LUID=([0-9a-f-]+)", Qt::CaseInsensitive);
 
   int curPos = 0;
   while((curPos = rx.indexIn(text_, curPos)) >= 0) {
@@ -652,16 +651,20 @@ bool GCSpiderCachePage::logs(QVector<LogMessage>& buf) const {
     }
 
     // put date together
-    if(log.date) delete log.date;
-    log.date = new QDate(year, month, day);
+    log.date = QDate(year, month, day);
 
     // author
     log.author = rx.cap(5);
 
     // log text
-    log.msg = rx.cap(6);
+    log.msg = CompressedText(rx.cap(6));
     // @todo Parse smileys, images, encrypted logs, links to other geocaches etc
 
+    // identifier, if the page links to the log
+    if(idRx.lastIndexIn(rx.cap(0)) >= 0) {
+      log.id = idRx.cap(1).toLower();
+    }
+
     buf.append(log);
   }
   return true;
@@ -669,13 +672,14 @@ bool GCSpiderCachePage::logs(QVector<LogMessage>& buf) const {
 
 /**
  * Extract geocache attributes
- * @param buf a vector of geocache attributes, or an empty vector if no
- * attributes exist or the data could be extracted. In any case, the buffer is
- * cleared before extracted attributes are inserted.
+ * @param buf a set of geocache attributes, or an empty set if no attributes
+ * exist or the data could be extracted. In any case, the buffer is cleared
+ * before extracted attributes are inserted.
  * @return @c false if the data could not be extracted, @c true otherwise, even
  * if there are no attributes.
  */
-bool GCSpiderCachePage::attrs(QVector<GeocacheAttribute>& buf) const {
+bool GCSpiderCachePage::attrs(GeocacheAttributes& buf) const {
+  buf.clear();
   QRegExp rx("<img src=\"/images/attributes/(available-yes|bicycles-yes|"
     "boat-yes|campfires-yes|camping-yes|camping-yes|cliff-yes|climbing-yes|"
     "cow-yes|danger-yes|dogs-yes|fee-yes|firstaid-yes|flashlight-yes|"
@@ -696,91 +700,91 @@ bool GCSpiderCachePage::attrs(QVector<GeocacheAttribute>& buf) const {
 
     QString sattr = rx.cap(1);
     if(sattr == "available-yes") {
-      buf.append(ATTR_AVAILABLE_YES);
+      buf.insert(ATTR_AVAILABLE_YES);
     } else if(sattr == "bicycles-yes") {
-      buf.append(ATTR_BICYCLES_YES);
+      buf.insert(ATTR_BICYCLES_YES);
     } else if(sattr == "boat-yes") {
-      buf.append(ATTR_BOAT);
+      buf.insert(ATTR_BOAT);
     } else if(sattr == "campfires-yes") {
-      buf.append(ATTR_CAMPFIRES_YES);
+      buf.insert(ATTR_CAMPFIRES_YES);
     } else if(sattr == "camping-yes") {
-      buf.append(ATTR_CAMPING_YES);
+      buf.insert(ATTR_CAMPING_YES);
     } else if(sattr == "cliff-yes") {
-      buf.append(ATTR_CLIFF);
+      buf.insert(ATTR_CLIFF);
     } else if(sattr == "climbing-yes") {
-      buf.append(ATTR_CLIMBING_YES);
+      buf.insert(ATTR_CLIMBING_YES);
     } else if(sattr == "cow-yes") {
-      buf.append(ATTR_COW);
+      buf.insert(ATTR_COW);
     } else if(sattr == "danger-yes") {
-      buf.append(ATTR_DANGER);
+      buf.insert(ATTR_DANGER);
     } else if(sattr == "dogs-yes") {
-      buf.append(ATTR_DOGS_YES);
+      buf.insert(ATTR_DOGS_YES);
     } else if(sattr == "fee-yes") {
-      buf.append(ATTR_FEE);
+      buf.insert(ATTR_FEE);
     } else if(sattr == "firstaid-yes") {
-      buf.append(ATTR_MAINT);
+      buf.insert(ATTR_MAINT);
     } else if(sattr == "flashlight-yes") {
-      buf.append(ATTR_FLASHLIGHT);
+      buf.insert(ATTR_FLASHLIGHT);
     } else if(sattr == "hiking-yes") {
-      buf.append(ATTR_HIKING_YES);
+      buf.insert(ATTR_HIKING_YES);
     } else if(sattr == "horses-yes") {
-      buf.append(ATTR_HORSES_YES);
+      buf.insert(ATTR_HORSES_YES);
     } else if(sattr == "hunting-yes") {
-      buf.append(ATTR_HUNTING);
+      buf.insert(ATTR_HUNTING);
     } else if(sattr == "jeeps-yes") {
-      buf.append(ATTR_JEEPS_YES);
+      buf.insert(ATTR_JEEPS_YES);
     } else if(sattr == "kids-yes") {
-      buf.append(ATTR_KIDS_YES);
+      buf.insert(ATTR_KIDS_YES);
     } else if(sattr == "mine-yes") {
-      buf.append(ATTR_MINE);
+      buf.insert(ATTR_MINE);
     } else if(sattr == "motorcycles-yes") {
-      buf.append(ATTR_MOTORCYCLES_YES);
+      buf.insert(ATTR_MOTORCYCLES_YES);
     } else if(sattr == "night-yes") {
-      buf.append(ATTR_NIGHT_YES);
+      buf.insert(ATTR_NIGHT_YES);
     } else if(sattr == "onehour-yes") {
-      buf.append(ATTR_ONEHOUR_YES);
+      buf.insert(ATTR_ONEHOUR_YES);
     } else if(sattr == "parking-yes") {
-      buf.append(ATTR_PARKING_YES);
+      buf.insert(ATTR_PARKING_YES);
     } else if(sattr == "phone-yes") {
-      buf.append(ATTR_PHONE_YES);
+      buf.insert(ATTR_PHONE_YES);
     } else if(sattr == "picnic-yes") {
-      buf.append(ATTR_PICNIC_YES);
+      buf.insert(ATTR_PICNIC_YES);
     } else if(sattr == "poisonoak-yes") {
-      buf.append(ATTR_POISONOAK_YES);
+      buf.insert(ATTR_POISONOAK_YES);
     } else if(sattr == "public-yes") {
-      buf.append(ATTR_PUBLIC);
+      buf.insert(ATTR_PUBLIC);
     } else if(sattr == "quads-yes") {
-      buf.append(ATTR_QUADS_YES);
+      buf.insert(ATTR_QUADS_YES);
     } else if(sattr == "rappelling-yes") {
-      buf.append(ATTR_RAPPELLING);
+      buf.insert(ATTR_RAPPELLING);
     } else if(sattr == "restrooms-yes") {
-      buf.append(ATTR_RESTROOMS_YES);
+      buf.insert(ATTR_RESTROOMS_YES);
     } else if(sattr == "scenic-yes") {
-      buf.append(ATTR_SCENIC_YES);
+      buf.insert(ATTR_SCENIC_YES);
     } else if(sattr == "scuba-yes") {
-      buf.append(ATTR_SCUBA);
+      buf.insert(ATTR_SCUBA);
     } else if(sattr == "snakes-yes") {
-      buf.append(ATTR_SNAKES);
+      buf.insert(ATTR_SNAKES);
     } else if(sattr == "snowmobiles-yes") {
-      buf.append(ATTR_SNOWMOBILES_YES);
+      buf.insert(ATTR_SNOWMOBILES_YES);
     } else if(sattr == "stealth-yes") {
-      buf.append(ATTR_STEALTH_YES);
+      buf.insert(ATTR_STEALTH_YES);
     } else if(sattr == "stroller-yes") {
-      buf.append(ATTR_STROLLER_YES);
+      buf.insert(ATTR_STROLLER_YES);
     } else if(sattr == "swimming-yes") {
-      buf.append(ATTR_SWIMMING);
+      buf.insert(ATTR_SWIMMING);
     } else if(sattr == "thorn-yes") {
-      buf.append(ATTR_THORNS);
+      buf.insert(ATTR_THORNS);
     } else if(sattr == "ticks-yes") {
-      buf.append(ATTR_TICKS);
+      buf.insert(ATTR_TICKS);
     } else if(sattr == "wading-yes") {
-      buf.append(ATTR_WADING);
+      buf.insert(ATTR_WADING);
     } else if(sattr == "water-yes") {
-      buf.append(ATTR_WATER_YES);
+      buf.insert(ATTR_WATER_YES);
     } else if(sattr == "wheelchair-yes") {
-      buf.append(ATTR_WHEELCHAIR_YES);
+      buf.insert(ATTR_WHEELCHAIR_YES);
     } else if(sattr == "winter-yes") {
-      buf.append(ATTR_WINTER_YES);
+      buf.insert(ATTR_WINTER_YES);
     } else {
       return false;
     }
@@ -57,7 +57,7 @@ public:
   bool owner(QString& buf) const;
   bool waypoints(QVector<Waypoint>& buf) const;
   bool logs(QVector<LogMessage>& buf) const;
-  bool attrs(QVector<GeocacheAttribute>& buf) const;
+  bool attrs(GeocacheAttributes& buf) const;
   bool hint(QString& buf) const;
   bool archived() const;
 };
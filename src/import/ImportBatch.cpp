@@ -0,0 +1,161 @@
+/**
+ * @file ImportBatch.cpp
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "import/ImportBatch.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+
+using namespace geojackal;
+
+/**
+ * Constructor, creates an empty batch
+ */
+ImportBatch::ImportBatch() : freshness_(0), unchanged_(0) {
+}
+
+ImportBatch::~ImportBatch() {
+  release();
+}
+
+/**
+ * Make room for a number of geocaches, so the vector is not reallocated while
+ * the batch is filled
+ * @param size Total number of geocaches expected in the batch
+ */
+void ImportBatch::reserve(int size) {
+  geocaches_.reserve(size);
+}
+
+/**
+ * Set the fetch records of the geocaches that earlier imports fetched
+ * @param known The records by waypoint, see GeocacheModel::fetchRecords()
+ * @param freshness Hours after a fetch in which a geocache is not fetched
+ *  again
+ */
+void ImportBatch::setKnown(const QHash<QString, FetchRecord>& known,
+  int freshness) {
+  known_ = known;
+  freshness_ = freshness;
+}
+
+/**
+ * Find out whether the detail page of a geocache must be fetched. This is not
+ * needed if it was fetched within the freshness window, or if its row on the
+ * list page, which shows the date of the last log, did not change since.
+ * @param waypoint Waypoint of the geocache
+ * @param listHash Hash of the row of the geocache on the list page
+ */
+bool ImportBatch::needsFetch(const QString& waypoint,
+  const QByteArray& listHash) const {
+  QHash<QString, FetchRecord>::const_iterator it = known_.find(waypoint);
+  if(it == known_.constEnd()) {
+    return true;
+  }
+  if(it->fetched.secsTo(QDateTime::currentDateTime()) < freshness_ * 3600) {
+    return false;
+  }
+  return listHash.isEmpty() || it->listHash != listHash;
+}
+
+/** Hash of everything parsed from a geocache page, to detect changes */
+static QByteArray contentHash(const Geocache& geocache) {
+  QByteArray data;
+  QDataStream out(&data, QIODevice::WriteOnly);
+  out << geocache.waypoint << geocache.name << double(geocache.coord.lat) <<
+    double(geocache.coord.lon) << qint32(geocache.type) <<
+    geocache.desc.data() << geocache.shortDesc.data() <<
+    qint32(geocache.size) << quint32(geocache.difficulty) <<
+    quint32(geocache.terrain) << geocache.placed << geocache.found <<
+    geocache.owner << geocache.attrs.toBlob() << geocache.hint <<
+    geocache.archived;
+  foreach(const Waypoint& wp, geocache.waypoints) {
+    out << wp.waypoint << wp.name << double(wp.coord.lat) <<
+      double(wp.coord.lon) << qint32(wp.type) << wp.desc.data();
+  }
+  foreach(const LogMessage& log, geocache.logs) {
+    out << log.author << log.msg.data() << qint32(log.type) <<
+      log.encrypted << log.date;
+  }
+  return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+/**
+ * Add a parsed geocache as the next geocache of the batch, and record the
+ * fetch. If the page had the same content as on the last fetch, the geocache
+ * is not added, so it is not written to the database again.
+ * @param geocache The parsed geocache
+ * @param parsed The result of GCSpiderCachePage::all()
+ * @param listHash Hash of the row of the geocache on the list page, if any
+ * @return @a parsed
+ */
+bool ImportBatch::add(const Geocache& geocache, bool parsed,
+  const QByteArray& listHash) {
+  geocaches_.append(geocache);
+  return accept(parsed, listHash);
+}
+
+/**
+ * @internal
+ * Record the fetch of the last geocache of the batch, and intern its names.
+ * If it has the same content as on the last fetch, it is removed again.
+ * Geocaches that could not be parsed completely get no record, so they are
+ * fetched again by the next import.
+ * @param ret The result of parsing the geocache
+ * @param listHash Hash of the row of the geocache on the list page, if any
+ * @return @a ret
+ */
+bool ImportBatch::accept(bool ret, const QByteArray& listHash) {
+  Geocache& geocache = geocaches_.last();
+  if(ret && !geocache.waypoint.isEmpty()) {
+    FetchRecord record;
+    record.waypoint = geocache.waypoint;
+    record.fetched = QDateTime::currentDateTime();
+    record.listHash = listHash;
+    record.hash = contentHash(geocache);
+    fetches_.append(record);
+    if(known_.value(record.waypoint).hash == record.hash) {
+      geocaches_.remove(geocaches_.size() - 1);
+      ++unchanged_;
+      return ret;
+    }
+  }
+
+  geocache.owner = names_.intern(geocache.owner);
+  for(int i = 0; i < geocache.logs.size(); ++i) {
+    LogMessage& log = geocache.logs[i];
+    log.author = names_.intern(log.author);
+  }
+  for(int i = 0; i < geocache.waypoints.size(); ++i) {
+    Waypoint& wp = geocache.waypoints[i];
+    wp.name = names_.intern(wp.name);
+  }
+  return ret;
+}
+
+/**
+ * Free all geocaches of the batch at once
+ */
+void ImportBatch::release() {
+  geocaches_ = QVector<Geocache>();
+  fetches_ = QVector<FetchRecord>();
+  known_.clear();
+  unchanged_ = 0;
+  names_.clear();
+}
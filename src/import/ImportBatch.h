@@ -0,0 +1,97 @@
+/**
+ * @file ImportBatch.h
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMPORTBATCH_H_
+#define IMPORTBATCH_H_
+
+#include "logic/Geocache.h"
+#include "logic/GeocacheDatabase.h"
+#include "logic/StringPool.h"
+#include <QVector>
+
+namespace geojackal {
+
+/**
+ * All geocaches of one import run, like one call of GCImport::nearest().
+ * The geocaches are parsed by other threads and added one by one to a vector
+ * that is sized for the whole run up front. Names that repeat across the
+ * batch (owners, log authors, waypoint names) are interned, so they share one
+ * buffer. Copies of the geocaches, like those handed to
+ * GeocacheModel::addGeocaches(), share their strings and vectors with the
+ * batch. Everything is freed with the batch.
+ *
+ * To re-sync an area, give the batch the fetch records of the geocaches that
+ * are already known with @a setKnown(). Geocaches fetched within the
+ * freshness window, or whose row on the list page did not change, do not
+ * need their detail page fetched again, see @a needsFetch(). Geocaches whose
+ * detail page has the same content as before are not added. Pass the
+ * @a fetchRecords() to GeocacheModel::addGeocaches() with the geocaches, it
+ * writes them once the geocaches are saved.
+ */
+class ImportBatch {
+public:
+  ImportBatch();
+  virtual ~ImportBatch();
+
+  void reserve(int size);
+  void setKnown(const QHash<QString, FetchRecord>& known, int freshness);
+  bool needsFetch(const QString& waypoint, const QByteArray& listHash) const;
+  bool add(const Geocache& geocache, bool parsed,
+    const QByteArray& listHash = QByteArray());
+  void release();
+
+  /** @return the geocaches of the batch */
+  inline const QVector<Geocache>& geocaches() const {
+    return geocaches_;
+  }
+  /** @return the number of geocaches in the batch */
+  inline int size() const {
+    return geocaches_.size();
+  }
+  /** @return the fetch records of all completely parsed geocaches */
+  inline const QVector<FetchRecord>& fetchRecords() const {
+    return fetches_;
+  }
+  /** @return the number of fetched geocaches that did not change */
+  inline int unchanged() const {
+    return unchanged_;
+  }
+
+private:
+  ImportBatch(const ImportBatch&);
+  ImportBatch& operator=(const ImportBatch&);
+  bool accept(bool ret, const QByteArray& listHash);
+
+  QVector<Geocache> geocaches_;
+  /** Records of the fetched geocaches */
+  QVector<FetchRecord> fetches_;
+  /** Records of the geocaches fetched by earlier imports, by waypoint */
+  QHash<QString, FetchRecord> known_;
+  /** Hours after a fetch in which a geocache is not fetched again */
+  int freshness_;
+  /** Number of fetched geocaches that did not change */
+  int unchanged_;
+  /** Names that repeat across the batch */
+  StringPool names_;
+};
+
+}
+
+#endif /* IMPORTBATCH_H_ */
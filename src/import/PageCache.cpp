@@ -0,0 +1,276 @@
+/**
+ * @file PageCache.cpp
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "import/PageCache.h"
+#include "global.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+using namespace geojackal;
+
+/** Magic number at the beginning of the index file */
+static const quint32 INDEX_MAGIC = 0x474a5043; // "GJPC"
+/** Version of the index file format */
+static const quint32 INDEX_VERSION = 1;
+
+PageCache::PageCache() : open_(false), dirty_(false) {
+}
+
+PageCache::~PageCache() {
+  try {
+    close();
+  } catch(Failure& f) {
+    qDebug() << f.what();
+  }
+}
+
+/**
+ * Open the cache in a directory, which is created if needed, and read its
+ * index.
+ * @param dir The directory of the cache
+ * @return @c false if the directory cannot be created. A missing or broken
+ *  index is not an error, the cache is empty then.
+ */
+bool PageCache::open(const QDir& dir) {
+  close();
+  if(!dir.exists() && !dir.mkpath(".")) {
+    return false;
+  }
+  dir_ = dir;
+  open_ = true;
+
+  QFile file(indexFileName());
+  if(!file.open(QIODevice::ReadOnly)) {
+    return true;
+  }
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_4_6);
+  quint32 magic, version, count;
+  in >> magic >> version >> count;
+  if(magic != INDEX_MAGIC || version != INDEX_VERSION) {
+    qDebug() << "ignoring page cache index of unknown format" <<
+      file.fileName();
+    return true;
+  }
+  for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+    QString key;
+    CachedPage page;
+    in >> key >> page.hash >> page.etag >> page.lastModified >> page.fetched;
+    if(in.status() == QDataStream::Ok && QFile::exists(fileName(page.hash))) {
+      pages_.insert(key, page);
+      refs_[page.hash]++;
+    }
+  }
+  qDebug() << "page cache has" << pages_.size() << "pages in" << dir_.path();
+  return true;
+}
+
+/**
+ * Write the index, if it changed. The index is written under a temporary
+ * name and then renamed, so a crash leaves the old index.
+ * @throws Failure if the index cannot be written
+ */
+void PageCache::save() {
+  if(!open_ || !dirty_) {
+    return;
+  }
+  QString tmpName = indexFileName() + ".tmp";
+  QFile file(tmpName);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    throw Failure("Could not write page cache index " + tmpName + ": " +
+      file.errorString());
+  }
+  QDataStream out(&file);
+  out.setVersion(QDataStream::Qt_4_6);
+  out << INDEX_MAGIC << INDEX_VERSION << quint32(pages_.size());
+  QHash<QString, CachedPage>::const_iterator it = pages_.constBegin();
+  for(; it != pages_.constEnd(); ++it) {
+    out << it.key() << it->hash << it->etag << it->lastModified <<
+      it->fetched;
+  }
+  file.close();
+  if(out.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+    QString error = file.errorString();
+    QFile::remove(tmpName);
+    throw Failure("Could not write page cache index " + tmpName + ": " +
+      error);
+  }
+
+  QFile::remove(indexFileName());
+  if(!QFile::rename(tmpName, indexFileName())) {
+    QFile::remove(tmpName);
+    throw Failure("Could not rename page cache index " + tmpName + " to " +
+      indexFileName());
+  }
+  dirty_ = false;
+}
+
+/**
+ * Write the index and close the cache.
+ * @throws Failure if the index cannot be written
+ */
+void PageCache::close() {
+  if(open_) {
+    save();
+  }
+  open_ = false;
+  pages_.clear();
+  refs_.clear();
+}
+
+/** @return @c true if a page with this key is in the cache */
+bool PageCache::contains(const QString& key) const {
+  return pages_.contains(key);
+}
+
+/** @return the metadata of a page, or an empty CachedPage if it is missing */
+CachedPage PageCache::page(const QString& key) const {
+  return pages_.value(key);
+}
+
+/**
+ * Read the contents of a page from disk
+ * @return The contents, or an empty array if the page is missing
+ */
+QByteArray PageCache::data(const QString& key) const {
+  if(!pages_.contains(key)) {
+    return QByteArray();
+  }
+  QFile file(fileName(pages_.value(key).hash));
+  if(!file.open(QIODevice::ReadOnly)) {
+    qDebug() << "could not read cached page" << file.fileName() << ":" <<
+      file.errorString();
+    return QByteArray();
+  }
+  return file.readAll();
+}
+
+/** @return the keys of all pages in the cache */
+QStringList PageCache::keys() const {
+  return pages_.keys();
+}
+
+/**
+ * Make a request conditional on the cached page, if the server sent
+ * validators for it. The server then answers with 304 Not Modified and an
+ * empty body if the page did not change.
+ * @param key Key of the page
+ * @param request The request for the page
+ */
+void PageCache::addValidators(const QString& key,
+  QNetworkRequest& request) const {
+  QHash<QString, CachedPage>::const_iterator it = pages_.find(key);
+  if(it == pages_.constEnd()) {
+    return;
+  }
+  if(!it->etag.isEmpty()) {
+    request.setRawHeader("If-None-Match", it->etag);
+  }
+  if(!it->lastModified.isEmpty()) {
+    request.setRawHeader("If-Modified-Since", it->lastModified);
+  }
+}
+
+/**
+ * Handle the response to a request for a page. A full page is stored in the
+ * cache with its validators. For 304 Not Modified, the cached page is marked
+ * as revalidated and returned instead.
+ * @param key Key of the page
+ * @param reply The finished reply, whose contents have not been read yet
+ * @return The contents of the page
+ */
+QByteArray PageCache::store(const QString& key, QNetworkReply * reply) {
+  int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).
+    toInt();
+  if(status == 304 && pages_.contains(key)) {
+    pages_[key].fetched = QDateTime::currentDateTime();
+    dirty_ = true;
+    return data(key);
+  }
+
+  QByteArray contents = reply->readAll();
+  if(open_ && status == 200) {
+    insert(key, contents, reply->rawHeader("ETag"),
+      reply->rawHeader("Last-Modified"));
+  }
+  return contents;
+}
+
+/**
+ * @internal
+ * Store the contents of a page and update its index entry. The file of the
+ * old contents is removed if no other page refers to it.
+ */
+void PageCache::insert(const QString& key, const QByteArray& data,
+  const QByteArray& etag, const QByteArray& lastModified) {
+  CachedPage page;
+  page.hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+  page.etag = etag;
+  page.lastModified = lastModified;
+  page.fetched = QDateTime::currentDateTime();
+
+  if(!refs_.contains(page.hash)) {
+    QString name = fileName(page.hash);
+    dir_.mkpath(QFileInfo(name).path());
+    QFile file(name);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+      file.write(data) != data.size()) {
+      qDebug() << "could not cache page" << name << ":" << file.errorString();
+      file.close();
+      QFile::remove(name);
+      return;
+    }
+  }
+
+  refs_[page.hash]++;
+  if(pages_.contains(key)) {
+    release(pages_.value(key).hash);
+  }
+  pages_.insert(key, page);
+  dirty_ = true;
+}
+
+/**
+ * @internal
+ * Drop a reference to a file, and remove the file with the last one.
+ */
+void PageCache::release(const QByteArray& hash) {
+  if(--refs_[hash] <= 0) {
+    refs_.remove(hash);
+    QFile::remove(fileName(hash));
+  }
+}
+
+/**
+ * @internal
+ * @return the name of the file with the contents of this hash. The files are
+ *  spread over subdirectories by the first byte of the hash.
+ */
+QString PageCache::fileName(const QByteArray& hash) const {
+  QString hex = hash.toHex();
+  return dir_.absoluteFilePath(hex.left(2) + "/" + hex);
+}
+
+/** @internal @return the name of the index file */
+QString PageCache::indexFileName() const {
+  return dir_.absoluteFilePath("index");
+}
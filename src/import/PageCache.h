@@ -0,0 +1,103 @@
+/**
+ * @file PageCache.h
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PAGECACHE_H_
+#define PAGECACHE_H_
+
+#include <QDir>
+#include <QHash>
+#include <QDateTime>
+#include <QStringList>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+
+namespace geojackal {
+
+/** A page in the PageCache */
+struct CachedPage {
+  /** SHA-1 hash of the contents, names the file of the contents */
+  QByteArray hash;
+  /** ETag header of the response, or empty */
+  QByteArray etag;
+  /** Last-Modified header of the response, or empty */
+  QByteArray lastModified;
+  /** Time of the last fetch or revalidation */
+  QDateTime fetched;
+};
+
+/**
+ * Disk cache of the raw pages loaded from geocaching.com, so they can be
+ * revalidated with a conditional GET instead of loaded again, and parsed
+ * again after the parser was fixed, see GCImport::replay().
+ *
+ * The contents are stored in files named by their SHA-1 hash, so equal pages
+ * are stored only once. An index maps the keys of the pages, like the GUID
+ * of a geocache, to the hash and the validators of the server. The index is
+ * kept in memory and written by @a save() and @a close(). The cache is not
+ * thread-safe.
+ */
+class PageCache {
+public:
+  PageCache();
+  virtual ~PageCache();
+
+  bool open(const QDir& dir);
+  void save();
+  void close();
+  /** @return @c true if the cache is open */
+  inline bool isOpen() const {
+    return open_;
+  }
+  /** @return the number of pages in the cache */
+  inline int size() const {
+    return pages_.size();
+  }
+
+  bool contains(const QString& key) const;
+  CachedPage page(const QString& key) const;
+  QByteArray data(const QString& key) const;
+  QStringList keys() const;
+
+  void addValidators(const QString& key, QNetworkRequest& request) const;
+  QByteArray store(const QString& key, QNetworkReply * reply);
+
+private:
+  PageCache(const PageCache&);
+  PageCache& operator=(const PageCache&);
+
+  void insert(const QString& key, const QByteArray& data,
+    const QByteArray& etag, const QByteArray& lastModified);
+  void release(const QByteArray& hash);
+  QString fileName(const QByteArray& hash) const;
+  QString indexFileName() const;
+
+  QDir dir_;
+  /** The pages by key */
+  QHash<QString, CachedPage> pages_;
+  /** Number of keys that refer to each file, by hash */
+  QHash<QByteArray, int> refs_;
+  bool open_;
+  /** Whether the index was changed since the last @a save() */
+  bool dirty_;
+};
+
+}
+
+#endif /* PAGECACHE_H_ */
@@ -0,0 +1,130 @@
+/**
+ * @file AttributeIndex.cpp
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logic/AttributeIndex.h"
+
+using namespace geojackal;
+
+/** Number of rows in one word of a bitmap */
+static const int WORD_BITS = 64;
+
+/**
+ * Constructor, creates an empty index
+ */
+AttributeIndex::AttributeIndex() {
+}
+
+/**
+ * Remove all geocaches from the index
+ */
+void AttributeIndex::clear() {
+  rows_.clear();
+  waypoints_.clear();
+  for(int a = 0; a < NUM_ATTRIBUTES; ++a) {
+    bitmaps_[a].clear();
+  }
+}
+
+/**
+ * Add a geocache to the index, or update its attributes
+ * @param waypoint Waypoint of the geocache
+ * @param attrs Attributes of the geocache
+ */
+void AttributeIndex::set(const QString& waypoint,
+  const GeocacheAttributes& attrs) {
+  int row = rows_.value(waypoint, -1);
+  if(row < 0) {
+    row = waypoints_.size();
+    rows_.insert(waypoint, row);
+    waypoints_.append(waypoint);
+    if(row % WORD_BITS == 0) {
+      for(int a = 0; a < NUM_ATTRIBUTES; ++a) {
+        bitmaps_[a].append(0);
+      }
+    }
+  }
+
+  int word = row / WORD_BITS;
+  quint64 bit = Q_UINT64_C(1) << (row % WORD_BITS);
+  for(int a = 0; a < NUM_ATTRIBUTES; ++a) {
+    if(attrs.contains(static_cast<GeocacheAttribute>(a))) {
+      bitmaps_[a][word] |= bit;
+    } else {
+      bitmaps_[a][word] &= ~bit;
+    }
+  }
+}
+
+/**
+ * Get all geocaches that match an attribute filter, like "kids-friendly AND
+ * dogs allowed AND NOT night-only".
+ * @param required Attributes that a geocache must all have
+ * @param excluded Attributes that a geocache must not have
+ * @param anyOf If not empty, a geocache must have at least one of these
+ * @return The waypoints of the matching geocaches
+ */
+QStringList AttributeIndex::filter(const GeocacheAttributes& required,
+  const GeocacheAttributes& excluded, const GeocacheAttributes& anyOf) const {
+  int rows = waypoints_.size();
+  int words = (rows + WORD_BITS - 1) / WORD_BITS;
+
+  // start with all rows, the last word only has the bits of existing rows
+  QVector<quint64> result(words, ~Q_UINT64_C(0));
+  if(rows % WORD_BITS) {
+    result[words - 1] = (Q_UINT64_C(1) << (rows % WORD_BITS)) - 1;
+  }
+
+  QVector<quint64> any(anyOf.isEmpty() ? 0 : words, 0);
+  for(int a = 0; a < NUM_ATTRIBUTES; ++a) {
+    GeocacheAttribute attr = static_cast<GeocacheAttribute>(a);
+    const quint64 * bitmap = bitmaps_[a].constData();
+    if(required.contains(attr)) {
+      for(int w = 0; w < words; ++w) {
+        result[w] &= bitmap[w];
+      }
+    }
+    if(excluded.contains(attr)) {
+      for(int w = 0; w < words; ++w) {
+        result[w] &= ~bitmap[w];
+      }
+    }
+    if(anyOf.contains(attr)) {
+      for(int w = 0; w < words; ++w) {
+        any[w] |= bitmap[w];
+      }
+    }
+  }
+  if(!anyOf.isEmpty()) {
+    for(int w = 0; w < words; ++w) {
+      result[w] &= any[w];
+    }
+  }
+
+  QStringList ret;
+  for(int w = 0; w < words; ++w) {
+    quint64 bits = result.at(w);
+    for(int b = 0; bits; ++b, bits >>= 1) {
+      if(bits & 1) {
+        ret << waypoints_.at(w * WORD_BITS + b);
+      }
+    }
+  }
+  return ret;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file AttributeIndex.h
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ATTRIBUTEINDEX_H_
+#define ATTRIBUTEINDEX_H_
+
+#include "logic/Geocache.h"
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+namespace geojackal {
+
+/**
+ * Bitmap index over the attributes of all geocaches. Every geocache gets a row
+ * number, and for each attribute there is a bitmap with one bit per row, so
+ * attribute filters are word-wise AND, OR and NOT operations over the whole
+ * dataset instead of a test per geocache.
+ */
+class AttributeIndex {
+public:
+  AttributeIndex();
+
+  void clear();
+  /** @return the number of geocaches in the index */
+  inline int size() const {
+    return waypoints_.size();
+  }
+  void set(const QString& waypoint, const GeocacheAttributes& attrs);
+  QStringList filter(const GeocacheAttributes& required,
+    const GeocacheAttributes& excluded = GeocacheAttributes(),
+    const GeocacheAttributes& anyOf = GeocacheAttributes()) const;
+
+private:
+  /** Row number of each geocache, by waypoint */
+  QHash<QString, int> rows_;
+  /** Waypoint of each row */
+  QVector<QString> waypoints_;
+  /** One bitmap per attribute, bit @c r is set if row @c r has it */
+  QVector<quint64> bitmaps_[NUM_ATTRIBUTES];
+};
+
+}
+
+#endif /* ATTRIBUTEINDEX_H_ */
@@ -55,6 +55,20 @@ bool Coordinate::isValid() {
   return true;
 }
 
+/**
+ * Calculate the great-circle distance to another coordinate, using the
+ * haversine formula on a spherical earth.
+ * @param other The other coordinate
+ * @return The distance in km
+ */
+double Coordinate::distanceTo(const Coordinate& other) const {
+  double dLat = (other.lat - lat) * M_PI / 180.0;
+  double dLon = (other.lon - lon) * M_PI / 180.0;
+  double a = sin(dLat / 2) * sin(dLat / 2) + cos(lat * M_PI / 180.0) *
+    cos(other.lat * M_PI / 180.0) * sin(dLon / 2) * sin(dLon / 2);
+  return EARTH_RADIUS * 2 * atan2(sqrt(a), sqrt(1 - a));
+}
+
 QString Coordinate::format(OutputFormat format) const {
   QString ns = (lat >= 0) ? "N" : "S";
   QString ew = (lon >= 0) ? "E" : "W";
@@ -160,8 +160,14 @@ struct Coordinate {
   Coordinate(Angle latitude, Angle longitude);
   QString format(OutputFormat format) const;
   bool isValid();
+  double distanceTo(const Coordinate& other) const;
 };
 
+/** Mean radius of the earth, in km */
+const static double EARTH_RADIUS = 6371.0;
+/** Length of one degree of latitude (or longitude on the equator), in km */
+const static double KM_PER_DEGREE = EARTH_RADIUS * M_PI / 180.0;
+
 /** The invalid coordinate used to determine unset values */
 const static Coordinate COORD_INVALID(ANGLE_INVALID, ANGLE_INVALID);
 
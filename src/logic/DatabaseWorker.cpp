@@ -0,0 +1,273 @@
+/**
+ * @file DatabaseWorker.cpp
+ * @date 16 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logic/DatabaseWorker.h"
+#include <QStringList>
+#include <QTime>
+#include <QPair>
+#include <QtAlgorithms>
+#include <cmath>
+
+using namespace geojackal;
+
+/**
+ * Constructor
+ * @param connectionName Unique name of the worker's database connection
+ * @param tuning Tuning of the worker's database connection
+ */
+DatabaseWorker::DatabaseWorker(const QString& connectionName,
+  const DatabaseTuning& tuning) : QObject(0), database_(0),
+  connectionName_(connectionName), tuning_(tuning), firstValidRequest_(0) {
+}
+
+DatabaseWorker::~DatabaseWorker() {
+  close();
+}
+
+/**
+ * Open the database and create the tables if needed. Emits @a opened() when
+ * done.
+ * @param fileName File name of the SQLite Database
+ */
+void DatabaseWorker::open(const QString& fileName) {
+  close();
+  // the connection belongs to the thread that creates it, so create it here
+  database_ = new GeocacheDatabase(connectionName_);
+  database_->setTuning(tuning_);
+  database_->setUpgradeListener(this);
+  try {
+    if(!database_->open(fileName)) {
+      emit opened(false, tr("Could not open database %1").arg(fileName));
+      return;
+    }
+  } catch(Failure& f) {
+    emit opened(false, f.what());
+    return;
+  }
+  emit opened(true, QString());
+}
+
+/**
+ * From UpgradeListener: called by the database in @a open() while the schema
+ * is upgraded, passes the progress on to @a upgrading()
+ */
+void DatabaseWorker::upgradeProgress(int version, int done, int total) {
+  emit upgrading(version, done, total);
+}
+
+/**
+ * Close the database. As slots are called in order, all queued writes are
+ * done when this slot runs. The write-ahead log is copied back to the
+ * database first, so it does not stay around until the next start.
+ */
+void DatabaseWorker::close() {
+  if(database_) {
+    try {
+      database_->checkpoint();
+    } catch(Failure& f) {
+      qDebug() << "Could not checkpoint database:" << f.what();
+    }
+    delete database_;
+    database_ = 0;
+  }
+}
+
+/** A geocache summary and its distance to the center of a query */
+typedef QPair<qreal, GeocacheSummary> DistanceSummary;
+
+/** Order by distance only */
+static bool distanceLessThan(const DistanceSummary& a,
+  const DistanceSummary& b) {
+  return a.first < b.first;
+}
+
+/**
+ * Query the summaries of all geocaches in a rectangular area. The results are
+ * delivered in batches by @a geocachesLoaded(), followed by
+ * @a queryFinished().
+ *
+ * To have the geocaches nearest to @a center first, the area is read in
+ * @a RINGS rectangles around @a center that double in size, and each ring is
+ * sorted by distance. Every ring query uses the spatial index, so the time to
+ * the first batch depends on the density around the center, not on the size
+ * of the database. The query stops early if it is cancelled.
+ * @param request Identifier of the request, passed on to the signals
+ * @param sw South-western corner of the area
+ * @param ne North-eastern corner of the area
+ * @param center Coordinate whose nearest geocaches are delivered first. If it
+ *  is invalid or outside the area, the center of the area is used.
+ */
+void DatabaseWorker::queryRect(int request, const Coordinate& sw,
+  const Coordinate& ne, const Coordinate& center) {
+  if(!database_ || cancelled(request)) {
+    emit queryFinished(request);
+    return;
+  }
+
+  QTime timer;
+  timer.start();
+  Coordinate c = center;
+  if(c.lat < sw.lat || c.lat > ne.lat || c.lon < sw.lon || c.lon > ne.lon) {
+    c = Coordinate((sw.lat + ne.lat) / 2, (sw.lon + ne.lon) / 2);
+  }
+  // half size of the outermost ring, so it covers the whole area
+  qreal dLat = qMax(ne.lat - c.lat, c.lat - sw.lat);
+  qreal dLon = qMax(ne.lon - c.lon, c.lon - sw.lon);
+  // longitude degrees are shorter away from the equator
+  qreal lonScale = cos(c.lat * M_PI / 180.0);
+
+  int rows = 0;
+  try {
+    Coordinate innerSw, innerNe; // the previous ring, already delivered
+    QVector<GeocacheSummary> batch;
+    for(int ring = 0; ring < RINGS && !cancelled(request); ++ring) {
+      qreal f = 1.0 / (1 << (RINGS - ring - 1));
+      Coordinate ringSw(qMax(c.lat - f * dLat, double(sw.lat)),
+        qMax(c.lon - f * dLon, double(sw.lon)));
+      Coordinate ringNe(qMin(c.lat + f * dLat, double(ne.lat)),
+        qMin(c.lon + f * dLon, double(ne.lon)));
+
+      QSqlQuery query(database_->database());
+      database_->execSummaryQuery(query, ringSw, ringNe);
+      QVector<DistanceSummary> sorted;
+      while(query.next()) {
+        // compare with the stored latitude and longitude (columns 1 and 2 of
+        // the summary query), the summary has less precision
+        double lat = query.value(1).toDouble();
+        double lon = query.value(2).toDouble();
+        if(ring > 0 && lat >= innerSw.lat && lat <= innerNe.lat &&
+          lon >= innerSw.lon && lon <= innerNe.lon) {
+          continue;
+        }
+        // planar distance is good enough for ordering
+        qreal y = lat - c.lat;
+        qreal x = (lon - c.lon) * lonScale;
+        sorted.append(qMakePair(x * x + y * y,
+          GeocacheDatabase::summaryFromQuery(query)));
+      }
+      qSort(sorted.begin(), sorted.end(), distanceLessThan);
+
+      // deliver the rest of each ring, so the nearest ones need not wait for
+      // the next ring
+      for(int i = 0; i < sorted.size() && !cancelled(request); ++i) {
+        batch.append(sorted.at(i).second);
+        if(batch.size() == BATCH_SIZE || i == sorted.size() - 1) {
+          if(rows == 0) {
+            qDebug() << "first geocaches of request" << request << "after" <<
+              timer.elapsed() << "ms";
+          }
+          rows += batch.size();
+          emit geocachesLoaded(request, batch);
+          batch.clear();
+        }
+      }
+      innerSw = ringSw;
+      innerNe = ringNe;
+    }
+  } catch(Failure& f) {
+    emit failed(f.what());
+  }
+  qDebug() << "request" << request << (cancelled(request) ? "cancelled" :
+    "done") << "with" << rows << "geocaches in" << timer.elapsed() << "ms";
+  emit queryFinished(request);
+}
+
+/**
+ * Write geocaches to the database in one transaction. If that fails, they are
+ * written again one by one, so one bad geocache does not take the others
+ * with it. Emits @a saved() for the written geocaches and @a saveFailed()
+ * once for the others.
+ * @param geocaches The geocaches to write
+ */
+void DatabaseWorker::save(const QVector<Geocache>& geocaches) {
+  QStringList waypoints;
+  foreach(const Geocache& geocache, geocaches) {
+    waypoints << geocache.waypoint;
+  }
+
+  if(!database_) {
+    emit saveFailed(waypoints, tr("Database is not open"));
+    return;
+  }
+  try {
+    database_->save(geocaches);
+  } catch(Failure& f) {
+    if(geocaches.size() == 1) {
+      emit saveFailed(waypoints, f.what());
+      return;
+    }
+    qDebug() << "saving" << geocaches.size() << "geocaches failed, saving "
+      "them one by one:" << f.what();
+    QStringList written, failed;
+    QString message;
+    for(int i = 0; i < geocaches.size(); ++i) {
+      try {
+        database_->save(QVector<Geocache>(1, geocaches[i]));
+        written << waypoints[i];
+      } catch(Failure& g) {
+        failed << waypoints[i];
+        message = g.what();
+      }
+    }
+    if(!written.isEmpty()) {
+      emit saved(written);
+    }
+    if(!failed.isEmpty()) {
+      emit saveFailed(failed, message);
+    }
+    return;
+  }
+  emit saved(waypoints);
+}
+
+/**
+ * Write the summaries of all geocaches to a SummarySnapshot file. As slots
+ * are called in order, the snapshot includes all queued writes. Emits
+ * @a snapshotWritten() when done.
+ * @param fileName File name of the snapshot
+ */
+void DatabaseWorker::writeSnapshot(const QString& fileName) {
+  if(!database_) {
+    return;
+  }
+  try {
+    database_->writeSnapshot(fileName);
+  } catch(Failure& f) {
+    // the snapshot is only a cache, so this is not worth bothering the user
+    qDebug() << "Could not write snapshot:" << f.what();
+    return;
+  }
+  emit snapshotWritten(fileName);
+}
+
+/**
+ * Write the fetch records of an import. As slots are called in order, they
+ * are written after the geocaches of the import.
+ */
+void DatabaseWorker::saveFetchRecords(const QVector<FetchRecord>& records) {
+  if(!database_) {
+    return;
+  }
+  try {
+    database_->saveFetchRecords(records);
+  } catch(Failure& f) {
+    emit failed(f.what());
+  }
+}
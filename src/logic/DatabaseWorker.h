@@ -0,0 +1,134 @@
+/**
+ * @file DatabaseWorker.h
+ * @date 16 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASEWORKER_H_
+#define DATABASEWORKER_H_
+
+#include "logic/GeocacheDatabase.h"
+#include <QObject>
+#include <QMetaType>
+#include <QAtomicInt>
+
+namespace geojackal {
+
+/**
+ * Does the slow database work of GeocacheModel in a separate thread. Move an
+ * instance to a QThread and call its slots through queued connections; the
+ * results are delivered by signals. The worker has its own database
+ * connection, which is opened and used only in the worker thread. Opening the
+ * database upgrades its schema if needed, which is reported by
+ * @a upgrading().
+ */
+class DatabaseWorker : public QObject, public UpgradeListener {
+  Q_OBJECT
+public:
+  /** Number of geocache summaries delivered per signal */
+  static const int BATCH_SIZE = 500;
+
+  /**
+   * Number of rings in which an area is read, each having twice the size of
+   * the previous one
+   */
+  static const int RINGS = 4;
+
+  DatabaseWorker(const QString& connectionName,
+    const DatabaseTuning& tuning);
+  virtual ~DatabaseWorker();
+
+  /**
+   * Cancel all area queries with a smaller request number. This function is
+   * thread-safe and takes effect immediately, even while a query is running.
+   */
+  inline void cancelBefore(int request) {
+    firstValidRequest_.fetchAndStoreOrdered(request);
+  }
+
+  virtual void upgradeProgress(int version, int done, int total);
+
+public slots:
+  void open(const QString& fileName);
+  void close();
+  void queryRect(int request, const geojackal::Coordinate& sw,
+    const geojackal::Coordinate& ne, const geojackal::Coordinate& center);
+  void save(const QVector<geojackal::Geocache>& geocaches);
+  void writeSnapshot(const QString& fileName);
+  void saveFetchRecords(const QVector<geojackal::FetchRecord>& records);
+
+signals:
+  /**
+   * Emitted when the database is opened
+   * @param ok @c true if the database could be opened
+   * @param message Error message if @a ok is @c false
+   */
+  void opened(bool ok, const QString& message);
+  /**
+   * Emitted for every batch of results of a query, the last batch may be
+   * shorter than BATCH_SIZE.
+   */
+  void geocachesLoaded(int request,
+    const QVector<geojackal::GeocacheSummary>& batch);
+  /**
+   * Emitted when all results of a query are delivered, or it failed or was
+   * cancelled
+   */
+  void queryFinished(int request);
+  /**
+   * Emitted when geocaches were written to the database
+   * @param waypoints The waypoints of the saved geocaches
+   */
+  void saved(const QStringList& waypoints);
+  /**
+   * Emitted while the schema of the database is upgraded
+   * @param version The schema version of the running upgrade step
+   * @param done Number of rows of the step that are done
+   * @param total Number of rows of the step, @c 0 if not known
+   */
+  void upgrading(int version, int done, int total);
+  /** Emitted when a write to the database failed */
+  void saveFailed(const QStringList& waypoints, const QString& message);
+  /** Emitted when a SummarySnapshot file was written */
+  void snapshotWritten(const QString& fileName);
+  /** Emitted when anything else goes wrong */
+  void failed(const QString& message);
+
+protected:
+  /** @return @c true if @a request has been cancelled */
+  inline bool cancelled(int request) const {
+    return request < static_cast<int>(firstValidRequest_);
+  }
+
+private:
+  GeocacheDatabase * database_;
+  QString connectionName_;
+  DatabaseTuning tuning_;
+  /** Area queries with a smaller request number are cancelled */
+  QAtomicInt firstValidRequest_;
+};
+
+}
+
+Q_DECLARE_METATYPE(geojackal::Coordinate)
+Q_DECLARE_METATYPE(geojackal::Geocache)
+Q_DECLARE_METATYPE(QVector<geojackal::Geocache>)
+Q_DECLARE_METATYPE(geojackal::GeocacheSummary)
+Q_DECLARE_METATYPE(QVector<geojackal::GeocacheSummary>)
+Q_DECLARE_METATYPE(QVector<geojackal::FetchRecord>)
+
+#endif /* DATABASEWORKER_H_ */
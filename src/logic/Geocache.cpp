@@ -24,18 +24,83 @@
 QDebug& geojackal::operator<<(QDebug& dbg, const Geocache& geocache) {
   dbg.nospace() << "{ wp: " << geocache.waypoint;
   dbg.nospace() << ", name: " << geocache.name;
-  dbg.nospace() << ", coord: " << *geocache.coord;
+  dbg.nospace() << ", coord: " << geocache.coord;
   dbg.nospace() << ", type: " << geocache.type;
   dbg.nospace() << ", size: " << geocache.size;
   dbg.nospace() << ", diff: " << geocache.difficulty;
   dbg.nospace() << ", terr: " << geocache.terrain;
-  dbg.nospace() << ", placed: " << geocache.placed->toString(Qt::ISODate);
+  dbg.nospace() << ", placed: " << geocache.placed.toString(Qt::ISODate);
   dbg.nospace() << ", owner: " << geocache.owner;
   dbg.nospace() << ", archived: " << geocache.archived;
   dbg.nospace() << " }";
   return dbg.maybeSpace();
 }
 
+/**
+ * Compress a text
+ * @param text The text
+ */
+CompressedText::CompressedText(const QString& text) {
+  if(text.isEmpty()) {
+    return;
+  }
+  QByteArray utf8 = text.toUtf8();
+  if(utf8.size() >= MIN_COMPRESS_SIZE) {
+    QByteArray compressed = qCompress(utf8);
+    if(compressed.size() < utf8.size()) {
+      data_.reserve(compressed.size() + 1);
+      data_.append(static_cast<char>(ENCODING_ZLIB));
+      data_.append(compressed);
+      return;
+    }
+  }
+  data_.reserve(utf8.size() + 1);
+  data_.append(static_cast<char>(ENCODING_PLAIN));
+  data_.append(utf8);
+}
+
+/**
+ * Decompress the text
+ * @return the text, or an empty string if the data is damaged
+ */
+QString CompressedText::toString() const {
+  if(data_.isEmpty()) {
+    return QString();
+  }
+  const char * p = data_.constData() + 1;
+  int size = data_.size() - 1;
+  if(data_.at(0) == ENCODING_ZLIB) {
+    return QString::fromUtf8(qUncompress(reinterpret_cast<const uchar *>(p),
+      size));
+  }
+  return QString::fromUtf8(p, size);
+}
+
+/**
+ * Create a text from the data returned by @a data()
+ */
+CompressedText CompressedText::fromData(const QByteArray& data) {
+  CompressedText text;
+  if(!data.isEmpty() && (data.at(0) == ENCODING_PLAIN ||
+    data.at(0) == ENCODING_ZLIB)) {
+    text.data_ = data;
+  }
+  return text;
+}
+
+/** Create the summary of a geocache */
+GeocacheSummary GeocacheSummary::fromGeocache(const Geocache& geocache) {
+  GeocacheSummary summary;
+  summary.setWaypoint(geocache.waypoint);
+  summary.lat = geocache.coord.lat;
+  summary.lon = geocache.coord.lon;
+  summary.type = geocache.type;
+  summary.size = geocache.size;
+  summary.difficulty = geocache.difficulty;
+  summary.terrain = geocache.terrain;
+  summary.flags = geocache.archived ? FLAG_ARCHIVED : 0;
+  return summary;
+}
 
 /**
  * ROT13 function to encode/decode a geocache hint. Due to the nature of ROT13,
@@ -25,6 +25,7 @@
 #include <QString>
 #include <QDateTime>
 #include <QVector>
+#include <QByteArray>
 #include "logic/Coordinate.h"
 
 namespace geojackal {
@@ -226,6 +227,115 @@ enum GeocacheAttribute {
 /** Number of attributes */
 const ushort NUM_ATTRIBUTES = static_cast<ushort>(ATTR_WINTER_YES) + 1;
 
+/**
+ * Set of geocache attributes, stored as a fixed 128-bit bitset. Bit @c n is
+ * set if the GeocacheAttribute with value @c n is set.
+ */
+class GeocacheAttributes {
+public:
+  /** Number of bits in the set */
+  static const int BITS = 128;
+  /** Size of the binary representation in bytes, see @a toBlob() */
+  static const int BLOB_SIZE = BITS / 8;
+
+  /** Construct an empty set */
+  GeocacheAttributes() {
+    bits_[0] = bits_[1] = 0;
+  }
+
+  /** @return @c true if @a attr is in the set */
+  inline bool contains(GeocacheAttribute attr) const {
+    return bits_[attr >> 6] & (Q_UINT64_C(1) << (attr & 63));
+  }
+  /** Add @a attr to the set */
+  inline void insert(GeocacheAttribute attr) {
+    bits_[attr >> 6] |= Q_UINT64_C(1) << (attr & 63);
+  }
+  /** Remove @a attr from the set */
+  inline void remove(GeocacheAttribute attr) {
+    bits_[attr >> 6] &= ~(Q_UINT64_C(1) << (attr & 63));
+  }
+  /** Remove all attributes */
+  inline void clear() {
+    bits_[0] = bits_[1] = 0;
+  }
+  /** @return @c true if no attribute is set */
+  inline bool isEmpty() const {
+    return !(bits_[0] | bits_[1]);
+  }
+  /**
+   * @return 64 bits of the set, @a i is @c 0 for the lower and @c 1 for the
+   * upper half
+   */
+  inline quint64 word(int i) const {
+    return bits_[i];
+  }
+
+  /** @return @c true if all attributes of @a other are in this set */
+  inline bool containsAll(const GeocacheAttributes& other) const {
+    return (bits_[0] & other.bits_[0]) == other.bits_[0] &&
+      (bits_[1] & other.bits_[1]) == other.bits_[1];
+  }
+  /** @return @c true if any attribute of @a other is in this set */
+  inline bool containsAny(const GeocacheAttributes& other) const {
+    return (bits_[0] & other.bits_[0]) || (bits_[1] & other.bits_[1]);
+  }
+  inline bool operator==(const GeocacheAttributes& other) const {
+    return bits_[0] == other.bits_[0] && bits_[1] == other.bits_[1];
+  }
+  inline bool operator!=(const GeocacheAttributes& other) const {
+    return !operator==(other);
+  }
+
+  /** @return the attributes in ascending order */
+  QVector<GeocacheAttribute> toVector() const {
+    QVector<GeocacheAttribute> ret;
+    for(ushort i = 0; i < NUM_ATTRIBUTES; ++i) {
+      if(contains(static_cast<GeocacheAttribute>(i))) {
+        ret.append(static_cast<GeocacheAttribute>(i));
+      }
+    }
+    return ret;
+  }
+
+  /**
+   * @return the set as BLOB_SIZE bytes, the lower half first, each half in
+   * little endian byte order
+   */
+  QByteArray toBlob() const {
+    QByteArray blob(BLOB_SIZE, '\0');
+    for(int i = 0; i < BLOB_SIZE; ++i) {
+      blob[i] = static_cast<char>(bits_[i / 8] >> (8 * (i % 8)));
+    }
+    return blob;
+  }
+
+  /**
+   * Read a set created by @a toBlob(). For databases of older versions, also
+   * a string that contains a @c 0 or a @c 1 for each attribute is accepted.
+   * @return the set, or an empty set if @a blob has neither format
+   */
+  static GeocacheAttributes fromBlob(const QByteArray& blob) {
+    GeocacheAttributes ret;
+    if(blob.size() == BLOB_SIZE) {
+      for(int i = 0; i < BLOB_SIZE; ++i) {
+        ret.bits_[i / 8] |= static_cast<quint64>(static_cast<uchar>(
+          blob.at(i))) << (8 * (i % 8));
+      }
+    } else if(blob.size() == NUM_ATTRIBUTES) {
+      for(ushort i = 0; i < NUM_ATTRIBUTES; ++i) {
+        if(blob.at(i) == '1') {
+          ret.insert(static_cast<GeocacheAttribute>(i));
+        }
+      }
+    }
+    return ret;
+  }
+
+private:
+  quint64 bits_[2];
+};
+
 /**
  * Log types
  */
@@ -298,6 +408,45 @@ enum GeocacheSize {
   SIZE_UNKNOWN
 };
 
+/**
+ * Long text like a description or log message, kept compressed in memory and
+ * in the database. Texts are only decompressed with @a toString() where they
+ * are shown. Copies share their data. Short texts and texts that do not
+ * compress well are stored as plain UTF-8.
+ */
+class CompressedText {
+public:
+  /** Texts shorter than this (in UTF-8 bytes) are not compressed */
+  static const int MIN_COMPRESS_SIZE = 128;
+
+  /** Construct an empty text */
+  CompressedText() {}
+  explicit CompressedText(const QString& text);
+
+  QString toString() const;
+  /** @return @c true if the text is empty */
+  inline bool isEmpty() const {
+    return data_.isEmpty();
+  }
+  /** @return the encoded text, as stored in the database */
+  inline const QByteArray& data() const {
+    return data_;
+  }
+  static CompressedText fromData(const QByteArray& data);
+
+private:
+  /** Tag byte in front of the encoded text */
+  enum Encoding {
+    /** Plain UTF-8 follows */
+    ENCODING_PLAIN = 'P',
+    /** UTF-8 compressed with qCompress() follows */
+    ENCODING_ZLIB = 'Z'
+  };
+
+  /** Tag byte and encoded text, or empty */
+  QByteArray data_;
+};
+
 /**
  * Additional image for a geocache or log
  */
@@ -312,25 +461,25 @@ struct GeocacheImage {
  * A log message of a person who visited the geocache
  */
 struct LogMessage {
+  /**
+   * Identifier of the log on geocaching.com, the LUID of its page, or empty
+   * if unknown
+   */
+  QString id;
   /** Author of the log message, person who visited the geocache */
   QString author;
   /** Log message */
-  QString msg;
+  CompressedText msg;
   /** Type of log */
   LogType type;
   /** Whether the log message is (partially) encrypted (ROT13) */
   bool encrypted;
-  /** Date of the log entry (should equal date found) */
-  QDate * date;
+  /** Date of the log entry (should equal date found), null if unknown */
+  QDate date;
   /** Additional images */
-  QVector<GeocacheImage> * images;
-
-  LogMessage() : date(0), images(0) {}
+  QVector<GeocacheImage> images;
 
-  ~LogMessage() {
-    if(images != 0) delete images;
-    if(date != 0) delete date;
-  }
+  LogMessage() : type(LOG_UNKNOWN), encrypted(false) {}
 };
 
 /** String to indicate invalid waypoints */
@@ -348,18 +497,14 @@ struct Waypoint {
   QString waypoint;
   /** Name of the waypoint, like <em>Wayward Drive!</em> */
   QString name;
-  /** Coordinate of the waypoint, or @c 0 if not set */
-  Coordinate * coord;
+  /** Coordinate of the waypoint, or COORD_INVALID if not set */
+  Coordinate coord;
   /** Type of the waypoint */
   WaypointType type;
   /** Geocache description */
-  QString desc;
-
-  Waypoint() : coord(0) {}
+  CompressedText desc;
 
-  ~Waypoint() {
-    if(coord != 0) delete coord;
-  }
+  Waypoint() : coord(COORD_INVALID), type(TYPE_UNKNOWN) {}
 };
 
 /**
@@ -369,7 +514,7 @@ struct Waypoint {
  */
 struct Geocache : Waypoint {
   /** Short description (plain text) */
-  QString shortDesc;
+  CompressedText shortDesc;
   /** Size of the geocache container */
   GeocacheSize size;
   /**
@@ -382,36 +527,90 @@ struct Geocache : Waypoint {
    * value stores the rating multiplied by @c 2 to save storage space.
    */
   unsigned int terrain;
-  /** Date the geocache was placed */
-  QDate * placed;
-  /** Date the geocache was found, 0 if not found */
-  QDate * found;
+  /** Date the geocache was placed, null if unknown */
+  QDate placed;
+  /** Date the geocache was found, null if not found */
+  QDate found;
   /** Person who placed the geocache */
   QString owner;
   /** Additional waypoints */
-  QVector<Waypoint> * waypoints;
+  QVector<Waypoint> waypoints;
   /** Log messages */
-  QVector<LogMessage> * logs;
+  QVector<LogMessage> logs;
   /** Additional attributes */
-  QVector<GeocacheAttribute> * attrs;
+  GeocacheAttributes attrs;
   /** Hints and spoiler info, ROT13-ecrypted */
   QString hint;
   /** @c true if the geocache is archived, @c false otherwise */
   bool archived;
 
-  Geocache() : placed(0), found(0), waypoints(0), logs(0), attrs(0) {}
+  Geocache() : size(SIZE_UNKNOWN), difficulty(0), terrain(0),
+    archived(false) {}
+};
+
+/**
+ * Compact summary of a geocache, holding only the data needed to draw it on
+ * the map or to show it in a list. This is a plain struct without pointers,
+ * so it can be stored contiguously in a QVector and copied with memcpy. Use
+ * GeocacheModel::geocache() to get the full details.
+ */
+struct GeocacheSummary {
+  /** Bits in @a flags */
+  enum Flags {
+    /** The geocache is archived */
+    FLAG_ARCHIVED = 0x01
+  };
+
+  /** Latitude in degree */
+  float lat;
+  /** Longitude in degree */
+  float lon;
+  /** The waypoint, like <em>GC1Q743</em>, as zero-terminated Latin-1 */
+  char waypoint[12];
+  /** Type of the geocache, a WaypointType */
+  quint8 type;
+  /** Size of the geocache container, a GeocacheSize */
+  quint8 size;
+  /** Difficulty rating, multiplied by 2 */
+  quint8 difficulty;
+  /** Terrain rating, multiplied by 2 */
+  quint8 terrain;
+  /** Combination of Flags */
+  quint8 flags;
 
-  ~Geocache() {
-    if(placed != 0) delete placed;
-    if(found != 0) delete found;
-    if(waypoints != 0) delete waypoints;
-    if(logs != 0) delete logs;
-    if(attrs != 0) delete attrs;
+  /** @return the waypoint as string */
+  inline QString waypointString() const {
+    return QString::fromLatin1(waypoint);
+  }
+  /** Set the waypoint, longer waypoints are truncated */
+  inline void setWaypoint(const QString& wp) {
+    qstrncpy(waypoint, wp.toLatin1().constData(), sizeof(waypoint));
+  }
+  /** @return the coordinate of the geocache */
+  inline Coordinate coord() const {
+    return Coordinate(lat, lon);
+  }
+  /** @return @c true if the geocache is archived */
+  inline bool archived() const {
+    return flags & FLAG_ARCHIVED;
   }
+
+  static GeocacheSummary fromGeocache(const Geocache& geocache);
 };
 
 QDebug& operator<<(QDebug& dbg, const Geocache& geocache);
 QString rot13(QString& text);
 
 }
+
+// The geocache structures only hold implicitly shared Qt values and plain
+// data, so copying them is cheap and containers may relocate them with memmove
+Q_DECLARE_TYPEINFO(geojackal::GeocacheAttributes, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(geojackal::CompressedText, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(geojackal::GeocacheImage, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(geojackal::LogMessage, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(geojackal::Waypoint, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(geojackal::Geocache, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(geojackal::GeocacheSummary, Q_PRIMITIVE_TYPE);
+
 #endif // GEOCACHE_H
@@ -0,0 +1,1998 @@
+/**
+ * @file GeocacheDatabase.cpp
+ * @date 16 Oct 2026
+ * @author Roland Hieber <rohieb@rohieb.name>
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2010 Roland Hieber
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logic/GeocacheDatabase.h"
+#include "logic/SummarySnapshot.h"
+#include <QDateTime>
+#include <QTime>
+#include <QStringList>
+#include <QMap>
+#include <QCryptographicHash>
+#include <cmath>
+
+using namespace geojackal;
+
+/** Columns to select for @a GeocacheDatabase::summaryFromQuery() */
+static const char * SUMMARY_COLUMNS = "w.waypoint,w.lat,w.lon,w.type,c.size,"
+  "c.difficulty,c.terrain,c.archived";
+/** Number of columns in @c SUMMARY_COLUMNS */
+static const int SUMMARY_COLUMN_COUNT = 8;
+/** Columns to select for @a GeocacheDatabase::geocacheFromQuery() */
+static const char * GEOCACHE_COLUMNS = "w.waypoint,w.name,w.lat,w.lon,w.type,"
+  "w.desc,c.shortdesc,c.size,c.terrain,c.difficulty,c.placed,c.found,"
+  "c.ownerid,c.attrs,c.hint,c.archived";
+
+/**
+ * @internal
+ * Convert a date to the value stored in the database, which is the UNIX time
+ * stamp of its beginning. Invalid dates are stored as @c 0, so they fit into
+ * the @c NOT @c NULL date columns.
+ */
+static QVariant dateToValue(const QDate& date) {
+  if(!date.isValid()) {
+    return 0u;
+  }
+  return QDateTime(date).toUTC().toTime_t();
+}
+
+/**
+ * @internal
+ * Convert a value created by dateToValue() back to a date. @c NULL and @c 0
+ * are unset dates.
+ */
+static QDate dateFromValue(const QVariant& value) {
+  if(value.isNull() || value.toUInt() == 0) {
+    return QDate();
+  }
+  return QDateTime::fromTime_t(value.toUInt()).date();
+}
+
+/**
+ * @internal
+ * Convert a text to the value stored in the database. Empty texts are stored
+ * as empty strings, so they fit into @c NOT @c NULL columns.
+ */
+static QVariant textToValue(const CompressedText& text) {
+  if(text.isEmpty()) {
+    return QString("");
+  }
+  return text.data();
+}
+
+/**
+ * @internal
+ * Convert a value created by textToValue() back to a text. Databases of older
+ * versions stored plain strings, which are compressed here.
+ */
+static CompressedText textFromValue(const QVariant& value) {
+  if(value.type() == QVariant::ByteArray) {
+    return CompressedText::fromData(value.toByteArray());
+  }
+  return CompressedText(value.toString());
+}
+
+/**
+ * @internal
+ * Build the key of a log that has no identifier from geocaching.com, from
+ * all of its values. Two logs only get the same key if they are equal.
+ * @param date The date as stored by dateToValue()
+ * @param authorId Id of the author in the @c authors table
+ * @param type The LogType
+ * @param msg The log message
+ */
+static QString logHashKey(const QVariant& date, qlonglong authorId, int type,
+  const QString& msg) {
+  QByteArray data = QString("%1|%2|%3|").arg(date.toUInt()).arg(authorId).
+    arg(type).toUtf8() + msg.toUtf8();
+  return "#" + QCryptographicHash::hash(data, QCryptographicHash::Sha1).
+    toHex();
+}
+
+/**
+ * @internal
+ * Remove HTML tags from a text, for the search index
+ */
+static QString plainText(const QString& html) {
+  static const QRegExp tagRx("<[^>]*>");
+  QString text = html;
+  return text.replace(tagRx, " ");
+}
+
+/**
+ * @internal
+ * Keeps the full-text index up to date, with statements that are prepared
+ * once. The log text is taken from the @c logs table, so write the logs of a
+ * geocache first. If the writer is not enabled, it does nothing.
+ */
+struct SearchWriter {
+  bool enabled;
+  QSqlQuery deleteFts, insertFts, selectLogs;
+
+  SearchWriter(QSqlDatabase& db, bool enabled = true) : enabled(enabled),
+    deleteFts(db), insertFts(db), selectLogs(db) {
+    if(!enabled) {
+      return;
+    }
+    deleteFts.prepare("DELETE FROM geocaches_fts WHERE rowid = "
+      "(SELECT rowid FROM waypoints WHERE waypoint = :waypoint)");
+    insertFts.prepare("INSERT INTO geocaches_fts (rowid, name, owner, "
+      "shortdesc, desc, hint, logs) SELECT rowid, :name, :owner, :shortdesc, "
+      ":desc, :hint, :logs FROM waypoints WHERE waypoint = :waypoint");
+    // log messages are compressed, so they are joined here and not by SQL
+    selectLogs.setForwardOnly(true);
+    selectLogs.prepare("SELECT msg FROM logs WHERE geocache = :geocache");
+  }
+
+  /** @return the text of all logs of a geocache */
+  QString logText(const QString& waypoint) {
+    selectLogs.bindValue(":geocache", waypoint);
+    if(!selectLogs.exec()) {
+      throw Failure("Error while trying to read SQL table 'logs': " +
+        selectLogs.lastError().text() + "\nFailed query was: " +
+        selectLogs.executedQuery());
+    }
+    QStringList text;
+    while(selectLogs.next()) {
+      text << textFromValue(selectLogs.value(0)).toString();
+    }
+    return text.join(" ");
+  }
+
+  /** Index a geocache that is not yet in the index */
+  void insert(const Geocache& geocache) {
+    if(!enabled) {
+      return;
+    }
+    QString hint = geocache.hint;
+    insertFts.bindValue(":name", geocache.name);
+    insertFts.bindValue(":owner", geocache.owner);
+    insertFts.bindValue(":shortdesc", plainText(geocache.shortDesc.
+      toString()));
+    insertFts.bindValue(":desc", plainText(geocache.desc.toString()));
+    insertFts.bindValue(":hint", rot13(hint));
+    insertFts.bindValue(":logs", logText(geocache.waypoint));
+    insertFts.bindValue(":waypoint", geocache.waypoint);
+    if(!insertFts.exec()) {
+      throw Failure("Error while trying to save to SQL table 'geocaches_fts': "
+        + insertFts.lastError().text() + "\nFailed query was: " +
+        insertFts.executedQuery());
+    }
+  }
+
+  /** Replace the index entry of a geocache */
+  void replace(const Geocache& geocache) {
+    if(!enabled) {
+      return;
+    }
+    deleteFts.bindValue(":waypoint", geocache.waypoint);
+    if(!deleteFts.exec()) {
+      throw Failure("Error while trying to save to SQL table 'geocaches_fts': "
+        + deleteFts.lastError().text() + "\nFailed query was: " +
+        deleteFts.executedQuery());
+    }
+    insert(geocache);
+  }
+};
+
+/**
+ * Constructor. The connection is not opened yet, see @a open().
+ * @param connectionName Unique name of the connection. The database must only
+ *  be used by the thread that calls @a open().
+ */
+GeocacheDatabase::GeocacheDatabase(const QString& connectionName) :
+  connectionName(connectionName), listener(0), hasRtree(false),
+  ftsVersion(0), owners("owners"), authors("authors") {
+}
+
+GeocacheDatabase::~GeocacheDatabase() {
+  close();
+}
+
+/**
+ * Connect to the database, and create the tables or upgrade them to the
+ * current schema if needed. No geocaches are loaded yet, use the query
+ * functions to get them.
+ * @param fileName File name of the SQLite Database
+ * @throws Failure if anything goes wrong
+ * @return @c true if the database could be opened, @c false otherwise
+ */
+bool GeocacheDatabase::open(const QString& fileName) {
+  qDebug() << "connecting to database" << fileName << "as" << connectionName;
+  close();
+
+  // create data folder if if does not eist
+  QDir dir = QDir(fileName + "/.."); // trim file name
+  dir.makeAbsolute();
+  qDebug() << "dir" << dir.absolutePath();
+  if(!dir.exists()) {
+    if(!dir.mkpath(dir.absolutePath())) {
+      qDebug() << "Failure: Could not mkdir" << dir.absolutePath();
+      return false;
+    }
+  }
+
+  // open sqlite database
+  db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+  db.setDatabaseName(fileName);
+  // other connections may write at the same time, wait for them
+  db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=" +
+    QString::number(BUSY_TIMEOUT));
+  if(!db.open()) {
+    qDebug() << "Failure: " << db.lastError();
+    return false;
+  }
+
+  q = QSqlQuery(db);
+  tune();
+
+  // bring older databases up to date, and create the tables of new ones
+  int version = schemaVersion();
+  if(version > SCHEMA_VERSION) {
+    throw Failure(QString("The database has schema version %1, but this "
+      "program only knows versions up to %2!").arg(version).
+      arg(SCHEMA_VERSION));
+  }
+  owners.clear();
+  authors.clear();
+  if(version < SCHEMA_VERSION) {
+    upgrade(version);
+  }
+  detectModules();
+
+  // geocaches are loaded on demand by the query functions
+  return true;
+}
+
+/**
+ * @internal
+ * Switch the database to write-ahead logging, so readers and the writer on
+ * other connections do not block each other, and apply the tuning. As the
+ * log is synced on checkpoints, commits do not need to sync the database.
+ * Automatic checkpoints only run on connections that set
+ * DatabaseTuning::checkpointPages.
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::tune() {
+  if(!q.exec("PRAGMA journal_mode=WAL") || !q.next()) {
+    throw Failure("Failed to set journal mode! " + q.lastError().text() +
+      "\nFailed query was: " + q.executedQuery());
+  }
+  QString mode = q.value(0).toString().toLower();
+  q.finish();
+
+  QStringList pragmas;
+  if(mode == "wal") {
+    pragmas << "PRAGMA synchronous=NORMAL";
+  } else {
+    // e.g. on a network file system, keep the safe default of synchronous
+    qDebug() << "Write-ahead logging not available, journal mode is" << mode;
+  }
+  pragmas << QString("PRAGMA cache_size=-%1").arg(tuning.cacheSize) <<
+    QString("PRAGMA mmap_size=%1").arg(qint64(tuning.mmapSize) << 20) <<
+    QString("PRAGMA wal_autocheckpoint=%1").arg(tuning.checkpointPages) <<
+    QString("PRAGMA journal_size_limit=%1").arg(WAL_SIZE_LIMIT);
+  foreach(const QString& pragma, pragmas) {
+    if(!q.exec(pragma)) {
+      throw Failure("Failed to tune database! " + q.lastError().text() +
+        "\nFailed query was: " + q.executedQuery());
+    }
+    q.finish();
+  }
+}
+
+/**
+ * Copy all pages from the write-ahead log back to the database and truncate
+ * the log, e.&nbsp;g. before closing. Waits up to @c BUSY_TIMEOUT for
+ * readers on other connections, and leaves the rest of the log for later if
+ * they are still busy.
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::checkpoint() {
+  if(!q.exec("PRAGMA wal_checkpoint(TRUNCATE)")) {
+    throw Failure("Failed to checkpoint database! " + q.lastError().text() +
+      "\nFailed query was: " + q.executedQuery());
+  }
+  if(q.next() && q.value(0).toInt()) {
+    qDebug() << "Checkpoint incomplete, database is busy";
+  }
+  q.finish();
+}
+
+/**
+ * Close the connection, if it is open
+ */
+void GeocacheDatabase::close() {
+  if(!db.isValid()) {
+    return;
+  }
+  q = QSqlQuery();
+  db.close();
+  db = QSqlDatabase();
+  QSqlDatabase::removeDatabase(connectionName);
+}
+
+/**
+ * @internal
+ * @return the schema version of the database, @c 0 for new databases and for
+ *  those written before schema versions were introduced
+ * @throws Failure if anything goes wrong
+ */
+int GeocacheDatabase::schemaVersion() {
+  if(!q.exec("PRAGMA user_version") || !q.next()) {
+    throw Failure("Failed to read schema version! " + q.lastError().text() +
+      "\nFailed query was: " + q.executedQuery());
+  }
+  int version = q.value(0).toInt();
+  q.finish();
+  return version;
+}
+
+/**
+ * @internal
+ * Upgrade the schema step by step to @c SCHEMA_VERSION. Every step brings the
+ * database from the previous version to its own, and the version is stored
+ * after each step, so an interrupted upgrade continues with the step that
+ * did not finish. Steps must therefore be safe to run again, and they also
+ * create the tables of new databases. Long steps change their rows in
+ * batches of @c UPGRADE_BATCH_SIZE, each in its own transaction, and report
+ * their progress to the UpgradeListener.
+ *
+ * To change the schema, increase @c SCHEMA_VERSION and add a step for the new
+ * version. Prefer adding columns and indices over copying tables.
+ * @param from The current schema version
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::upgrade(int from) {
+  QTime timer;
+  timer.start();
+  for(int version = from + 1; version <= SCHEMA_VERSION; ++version) {
+    upgradeProgress(version, 0, 0);
+    switch(version) {
+      case 1:
+        createTables();
+        break;
+      case 2:
+        internNames();
+        break;
+      case 3:
+        createDetailTables();
+        break;
+      case 4:
+        createSpatialIndex();
+        break;
+      case 5:
+        createSearchIndex();
+        break;
+      case 6:
+        createQueryIndices();
+        break;
+      case 7:
+        createMetadata();
+        break;
+      case 8:
+        compressTexts(version);
+        break;
+      case 9:
+        createFetchTable();
+        break;
+      case 10:
+        createLogKeys(version);
+        break;
+    }
+    if(!q.exec(QString("PRAGMA user_version = %1").arg(version))) {
+      throw Failure("Failed to write schema version! " + q.lastError().text() +
+        "\nFailed query was: " + q.executedQuery());
+    }
+  }
+  qDebug() << "upgraded schema from version" << from << "to" <<
+    SCHEMA_VERSION << "in" << timer.elapsed() << "ms";
+}
+
+/**
+ * @internal
+ * Report the progress of an upgrade step to the listener, if there is one
+ */
+void GeocacheDatabase::upgradeProgress(int version, int done, int total) {
+  if(listener) {
+    listener->upgradeProgress(version, done, total);
+  }
+}
+
+/**
+ * @internal
+ * Find out which SQLite modules the spatial and the search index use. They
+ * are chosen when the indices are created, depending on the SQLite library.
+ */
+void GeocacheDatabase::detectModules() {
+  hasRtree = db.tables(QSql::Tables).contains("waypoints_rtree");
+  ftsVersion = 0;
+  q.exec("SELECT sql FROM sqlite_master WHERE name = 'geocaches_fts'");
+  if(q.next()) {
+    QString sql = q.value(0).toString().toLower();
+    ftsVersion = sql.contains("fts5") ? 5 : sql.contains("fts4") ? 4 : 3;
+  }
+  q.finish();
+}
+
+/**
+ * @internal
+ * Create the tables of the waypoints and geocaches and the dictionary tables,
+ * if they do not exist yet
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::createTables() {
+  QStringList tableList = db.tables(QSql::Tables);
+
+  if(!tableList.contains("waypoints")) {
+    if(!q.exec("CREATE TABLE waypoints("
+      "waypoint TEXT PRIMARY KEY,"
+      "name TEXT NOT NULL,"
+      "lat REAL NOT NULL,"
+      "lon REAL NOT NULL,"
+      "type INTEGER NOT NULL,"
+      "desc TEXT"
+      ");")) {
+      throw Failure("Failed to create table 'waypoints'! "
+        + q.lastError().text() + "\nFailed query was: " + q.executedQuery());
+    }
+  }
+  if(!tableList.contains("geocaches")) {
+    if(!q.exec("CREATE TABLE geocaches("
+      "waypoint TEXT PRIMARY KEY "
+      "  REFERENCES waypoints(oid) ON DELETE CASCADE ON UPDATE CASCADE,"
+      "shortdesc TEXT,"
+      "size INT NOT NULL,"
+      "terrain INTEGER NOT NULL,"
+      "difficulty INTEGER NOT NULL,"
+      "placed INTEGER NOT NULL,"
+      "found INTEGER NOT NULL,"
+      "ownerid INTEGER NOT NULL REFERENCES owners(id),"
+      "attrs BLOB NOT NULL,"
+      "hint TEXT,"
+      "archived INTEGER DEFAULT 0,"
+      "vote INT DEFAULT 0"
+      ");")) {
+      throw Failure("Failed to create table 'geocaches'! " + q.lastError().
+        text() + "\nFailed query was: " + q.executedQuery());
+    }
+  }
+
+  owners.create(db);
+  authors.create(db);
+}
+
+/**
+ * @internal
+ * Move the owners of the geocaches and the authors of the logs, which older
+ * versions stored as text in every row, to the @c owners and @c authors
+ * tables. SQLite cannot change columns, so the @c geocaches and @c logs
+ * tables are copied to new ones. The ids of the logs are kept.
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::internNames() {
+  QStringList tableList = db.tables(QSql::Tables);
+  bool geocachesOld = db.record("geocaches").contains("owner");
+  bool logsOld = tableList.contains("logs") &&
+    db.record("logs").contains("author");
+  if(!geocachesOld && !logsOld) {
+    return;
+  }
+
+  QTime timer;
+  timer.start();
+  QStringList statements;
+  if(geocachesOld) {
+    statements << "INSERT OR IGNORE INTO owners (name) "
+      "SELECT DISTINCT owner FROM geocaches";
+    statements << "CREATE TABLE geocaches_new("
+      "waypoint TEXT PRIMARY KEY "
+      "  REFERENCES waypoints(oid) ON DELETE CASCADE ON UPDATE CASCADE,"
+      "shortdesc TEXT,"
+      "size INT NOT NULL,"
+      "terrain INTEGER NOT NULL,"
+      "difficulty INTEGER NOT NULL,"
+      "placed INTEGER NOT NULL,"
+      "found INTEGER NOT NULL,"
+      "ownerid INTEGER NOT NULL REFERENCES owners(id),"
+      "attrs BLOB NOT NULL,"
+      "hint TEXT,"
+      "archived INTEGER DEFAULT 0,"
+      "vote INT DEFAULT 0"
+      ")";
+    statements << "INSERT INTO geocaches_new (waypoint, shortdesc, size, "
+      "terrain, difficulty, placed, found, ownerid, attrs, hint, archived, "
+      "vote) SELECT c.waypoint, c.shortdesc, c.size, c.terrain, c.difficulty, "
+      "c.placed, c.found, o.id, c.attrs, c.hint, c.archived, c.vote "
+      "FROM geocaches c JOIN owners o ON o.name = c.owner";
+    statements << "DROP TABLE geocaches";
+    statements << "ALTER TABLE geocaches_new RENAME TO geocaches";
+  }
+  if(logsOld) {
+    statements << "INSERT OR IGNORE INTO authors (name) "
+      "SELECT DISTINCT author FROM logs";
+    statements << "CREATE TABLE logs_new("
+      "id INTEGER PRIMARY KEY,"
+      "geocache TEXT NOT NULL REFERENCES geocaches(waypoint),"
+      "date INTEGER NOT NULL DEFAULT 0,"
+      "authorid INTEGER NOT NULL REFERENCES authors(id),"
+      "type INTEGER NOT NULL,"
+      "msg TEXT NOT NULL,"
+      "encrypted INTEGER NOT NULL DEFAULT 0"
+      ")";
+    statements << "INSERT INTO logs_new (id, geocache, date, authorid, type, "
+      "msg, encrypted) SELECT l.id, l.geocache, l.date, a.id, l.type, l.msg, "
+      "l.encrypted FROM logs l JOIN authors a ON a.name = l.author";
+    statements << "DROP TABLE logs";
+    statements << "ALTER TABLE logs_new RENAME TO logs";
+  }
+
+  if(!db.transaction()) {
+    throw Failure("Could not begin transaction: " + db.lastError().text());
+  }
+  try {
+    foreach(QString statement, statements) {
+      if(!q.exec(statement)) {
+        throw Failure("Failed to move names to dictionary tables! " +
+          q.lastError().text() + "\nFailed query was: " + q.executedQuery());
+      }
+    }
+    if(!db.commit()) {
+      throw Failure("Could not commit transaction: " + db.lastError().text());
+    }
+  } catch(Failure&) {
+    db.rollback();
+    throw;
+  }
+  qDebug() << "moved owners and authors to dictionary tables in" <<
+    timer.elapsed() << "ms";
+}
+
+/**
+ * @internal
+ * Create the tables for the additional waypoints, logs and images of the
+ * geocaches, if they do not exist yet. Every table referencing a geocache or
+ * a log has an index on that column, so reading the details of one geocache
+ * does not depend on the number of rows of all other geocaches.
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::createDetailTables() {
+  QStringList statements;
+  statements << "CREATE TABLE IF NOT EXISTS geocachewaypoints("
+    "geocache TEXT NOT NULL REFERENCES geocaches(waypoint),"
+    "prefix TEXT NOT NULL,"
+    "name TEXT,"
+    "lat REAL,"
+    "lon REAL,"
+    "type INTEGER NOT NULL,"
+    "desc TEXT"
+    ")";
+  statements << "CREATE INDEX IF NOT EXISTS geocachewaypoints_geocache "
+    "ON geocachewaypoints(geocache)";
+  statements << "CREATE TABLE IF NOT EXISTS logs("
+    "id INTEGER PRIMARY KEY,"
+    "geocache TEXT NOT NULL REFERENCES geocaches(waypoint),"
+    "date INTEGER NOT NULL DEFAULT 0,"
+    "authorid INTEGER NOT NULL REFERENCES authors(id),"
+    "type INTEGER NOT NULL,"
+    "msg TEXT NOT NULL,"
+    "encrypted INTEGER NOT NULL DEFAULT 0"
+    ")";
+  // identifies a log, and returns the logs of a geocache ordered by date
+  statements << "CREATE UNIQUE INDEX IF NOT EXISTS logs_geocache "
+    "ON logs(geocache, date, authorid, type)";
+  statements << "CREATE TABLE IF NOT EXISTS images("
+    "filename TEXT PRIMARY KEY,"
+    "desc TEXT"
+    ")";
+  statements << "CREATE TABLE IF NOT EXISTS geocacheimages("
+    "geocache TEXT NOT NULL REFERENCES geocaches(waypoint),"
+    "image TEXT NOT NULL REFERENCES images(filename),"
+    "PRIMARY KEY(geocache, image)"
+    ")";
+  statements << "CREATE INDEX IF NOT EXISTS geocacheimages_image "
+    "ON geocacheimages(image)";
+  statements << "CREATE TABLE IF NOT EXISTS logimages("
+    "log INTEGER NOT NULL REFERENCES logs(id),"
+    "image TEXT NOT NULL REFERENCES images(filename),"
+    "PRIMARY KEY(log, image)"
+    ")";
+  statements << "CREATE INDEX IF NOT EXISTS logimages_image "
+    "ON logimages(image)";
+  foreach(QString statement, statements) {
+    if(!q.exec(statement)) {
+      throw Failure("Failed to create detail tables! " + q.lastError().text() +
+        "\nFailed query was: " + q.executedQuery());
+    }
+  }
+}
+
+/**
+ * @internal
+ * Create the spatial index on the waypoint coordinates, if it does not exist
+ * yet. If the SQLite library was built with the R*Tree module, the virtual
+ * table @c waypoints_rtree holds a bounding box for each row in @c waypoints,
+ * and is kept in sync by triggers. Otherwise, we fall back to a plain B-Tree
+ * index on latitude and longitude.
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::createSpatialIndex() {
+  QStringList tableList = db.tables(QSql::Tables);
+  hasRtree = tableList.contains("waypoints_rtree");
+
+  if(!hasRtree) {
+    if(q.exec("CREATE VIRTUAL TABLE waypoints_rtree USING rtree("
+      "id, minlat, maxlat, minlon, maxlon)")) {
+      hasRtree = true;
+      // fill in the waypoints that are already in the database
+      if(!q.exec("INSERT INTO waypoints_rtree SELECT rowid, lat, lat, lon, lon "
+        "FROM waypoints")) {
+        throw Failure("Failed to fill table 'waypoints_rtree'! " +
+          q.lastError().text() + "\nFailed query was: " + q.executedQuery());
+      }
+    } else {
+      qDebug() << "R*Tree module not available, using plain index:" <<
+        q.lastError().text();
+    }
+  }
+
+  QStringList statements;
+  if(hasRtree) {
+    statements << "CREATE TRIGGER IF NOT EXISTS waypoints_rtree_insert "
+      "AFTER INSERT ON waypoints BEGIN "
+      "INSERT OR REPLACE INTO waypoints_rtree VALUES (new.rowid, new.lat, "
+      "new.lat, new.lon, new.lon); END";
+    statements << "CREATE TRIGGER IF NOT EXISTS waypoints_rtree_update "
+      "AFTER UPDATE OF lat, lon ON waypoints BEGIN "
+      "UPDATE waypoints_rtree SET minlat = new.lat, maxlat = new.lat, "
+      "minlon = new.lon, maxlon = new.lon WHERE id = new.rowid; END";
+    statements << "CREATE TRIGGER IF NOT EXISTS waypoints_rtree_delete "
+      "AFTER DELETE ON waypoints BEGIN "
+      "DELETE FROM waypoints_rtree WHERE id = old.rowid; END";
+  } else {
+    statements << "CREATE INDEX IF NOT EXISTS waypoints_latlon "
+      "ON waypoints(lat, lon)";
+  }
+  foreach(QString statement, statements) {
+    if(!q.exec(statement)) {
+      throw Failure("Failed to create spatial index! " + q.lastError().text() +
+        "\nFailed query was: " + q.executedQuery());
+    }
+  }
+}
+
+/**
+ * @internal
+ * Create the indices on the columns that GeocacheQuery can filter and sort
+ * by, if they do not exist yet.
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::createQueryIndices() {
+  QStringList statements;
+  statements << "CREATE INDEX IF NOT EXISTS waypoints_type ON waypoints(type)";
+  statements << "CREATE INDEX IF NOT EXISTS waypoints_name "
+    "ON waypoints(name COLLATE NOCASE)";
+  statements << "CREATE INDEX IF NOT EXISTS geocaches_size ON geocaches(size)";
+  statements << "CREATE INDEX IF NOT EXISTS geocaches_difficulty "
+    "ON geocaches(difficulty)";
+  statements << "CREATE INDEX IF NOT EXISTS geocaches_terrain "
+    "ON geocaches(terrain)";
+  statements << "CREATE INDEX IF NOT EXISTS geocaches_placed "
+    "ON geocaches(placed)";
+  statements << "CREATE INDEX IF NOT EXISTS geocaches_found "
+    "ON geocaches(found)";
+  statements << "CREATE INDEX IF NOT EXISTS geocaches_owner "
+    "ON geocaches(ownerid)";
+  foreach(QString statement, statements) {
+    if(!q.exec(statement)) {
+      throw Failure("Failed to create query indices! " + q.lastError().text() +
+        "\nFailed query was: " + q.executedQuery());
+    }
+  }
+}
+
+/**
+ * @internal
+ * Create the @c metadata table of key-value pairs, if it does not exist yet.
+ * It holds the @c generation counter, which is incremented by every
+ * @a save().
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::createMetadata() {
+  QStringList statements;
+  statements << "CREATE TABLE IF NOT EXISTS metadata("
+    "key TEXT PRIMARY KEY,"
+    "value"
+    ")";
+  statements << "INSERT OR IGNORE INTO metadata (key, value) "
+    "VALUES ('generation', 1)";
+  foreach(QString statement, statements) {
+    if(!q.exec(statement)) {
+      throw Failure("Failed to create table 'metadata'! " +
+        q.lastError().text() + "\nFailed query was: " + q.executedQuery());
+    }
+  }
+}
+
+/**
+ * @internal
+ * Compress the descriptions and log messages that older versions stored as
+ * plain strings, and shrink the file afterwards. The texts are compressed in
+ * batches, each in its own transaction, so an interrupted upgrade keeps the
+ * batches that are done.
+ * @param version The schema version of this upgrade step, for the progress
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::compressTexts(int version) {
+  // databases of older versions recorded that they are compressed already
+  q.exec("SELECT value FROM metadata WHERE key = 'compressed'");
+  if(q.next() && q.value(0).toBool()) {
+    q.finish();
+    return;
+  }
+  q.finish();
+
+  QTime timer;
+  timer.start();
+  QStringList tables, columns;
+  tables << "waypoints" << "geocaches" << "geocachewaypoints" << "logs";
+  columns << "desc" << "shortdesc" << "desc" << "msg";
+
+  int total = 0;
+  for(int i = 0; i < tables.size(); ++i) {
+    if(!q.exec(QString("SELECT count(*) FROM %1 WHERE typeof(%2) = 'text'").
+      arg(tables[i]).arg(columns[i])) || !q.next()) {
+      throw Failure("Failed to read table '" + tables[i] + "'! " +
+        q.lastError().text() + "\nFailed query was: " + q.executedQuery());
+    }
+    total += q.value(0).toInt();
+    q.finish();
+  }
+
+  int rows = 0;
+  for(int i = 0; i < tables.size(); ++i) {
+    int batch;
+    do {
+      if(!db.transaction()) {
+        throw Failure("Could not begin transaction: " +
+          db.lastError().text());
+      }
+      batch = 0;
+      try {
+        QSqlQuery select(db), update(db);
+        select.setForwardOnly(true);
+        if(!select.exec(QString("SELECT rowid, %1 FROM %2 "
+          "WHERE typeof(%1) = 'text' LIMIT %3").arg(columns[i]).
+          arg(tables[i]).arg(UPGRADE_BATCH_SIZE))) {
+          throw Failure("Failed to read table '" + tables[i] + "'! " +
+            select.lastError().text() + "\nFailed query was: " +
+            select.executedQuery());
+        }
+        update.prepare(QString("UPDATE %1 SET %2 = :value "
+          "WHERE rowid = :rowid").arg(tables[i]).arg(columns[i]));
+        while(select.next()) {
+          update.bindValue(":value", textToValue(CompressedText(
+            select.value(1).toString())));
+          update.bindValue(":rowid", select.value(0));
+          if(!update.exec()) {
+            throw Failure("Failed to compress table '" + tables[i] + "'! " +
+              update.lastError().text() + "\nFailed query was: " +
+              update.executedQuery());
+          }
+          ++batch;
+        }
+        select.finish();
+        if(!db.commit()) {
+          throw Failure("Could not commit transaction: " +
+            db.lastError().text());
+        }
+      } catch(Failure&) {
+        db.rollback();
+        throw;
+      }
+      rows += batch;
+      upgradeProgress(version, rows, total);
+    } while(batch == UPGRADE_BATCH_SIZE);
+  }
+
+  // no VACUUM here: it may renumber the rowids of the waypoints, which the
+  // spatial and the search index refer to. The pages of the old texts are
+  // reused by later writes.
+  qDebug() << "compressed" << rows << "texts in" << timer.elapsed() << "ms";
+}
+
+/**
+ * @internal
+ * Create the @c fetches table, which holds a FetchRecord for every geocache
+ * that was imported from geocaching.com, if it does not exist yet
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::createFetchTable() {
+  if(!q.exec("CREATE TABLE IF NOT EXISTS fetches("
+    "waypoint TEXT PRIMARY KEY,"
+    "fetched INTEGER NOT NULL,"
+    "listhash BLOB,"
+    "hash BLOB"
+    ")")) {
+    throw Failure("Failed to create table 'fetches'! " + q.lastError().text() +
+      "\nFailed query was: " + q.executedQuery());
+  }
+}
+
+/**
+ * @internal
+ * Identify logs by a key instead of by their date, author and type, which are
+ * not unique: an author can write several notes on the same day. The key is
+ * the identifier of the log on geocaching.com, or for logs without one, a
+ * hash of all its values, see logHashKey(). The keys of existing logs are
+ * hashes; a log that is imported again with its identifier takes over the
+ * row. The keys are filled in batches like in @a compressTexts().
+ * @param version The schema version of this upgrade step, for the progress
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::createLogKeys(int version) {
+  if(!db.record("logs").contains("logkey")) {
+    if(!q.exec("ALTER TABLE logs ADD COLUMN logkey TEXT")) {
+      throw Failure("Failed to add log keys! " + q.lastError().text() +
+        "\nFailed query was: " + q.executedQuery());
+    }
+  }
+  if(!q.exec("SELECT count(*) FROM logs WHERE logkey IS NULL") || !q.next()) {
+    throw Failure("Failed to read table 'logs'! " + q.lastError().text() +
+      "\nFailed query was: " + q.executedQuery());
+  }
+  int total = q.value(0).toInt();
+  q.finish();
+
+  int rows = 0;
+  int batch;
+  do {
+    if(!db.transaction()) {
+      throw Failure("Could not begin transaction: " + db.lastError().text());
+    }
+    batch = 0;
+    try {
+      QSqlQuery select(db), update(db);
+      select.setForwardOnly(true);
+      if(!select.exec(QString("SELECT id, date, authorid, type, msg FROM logs "
+        "WHERE logkey IS NULL LIMIT %1").arg(UPGRADE_BATCH_SIZE))) {
+        throw Failure("Failed to read table 'logs'! " +
+          select.lastError().text() + "\nFailed query was: " +
+          select.executedQuery());
+      }
+      update.prepare("UPDATE logs SET logkey = :logkey WHERE id = :id");
+      while(select.next()) {
+        update.bindValue(":logkey", logHashKey(select.value(1),
+          select.value(2).toLongLong(), select.value(3).toInt(),
+          textFromValue(select.value(4)).toString()));
+        update.bindValue(":id", select.value(0));
+        if(!update.exec()) {
+          throw Failure("Failed to write log keys! " +
+            update.lastError().text() + "\nFailed query was: " +
+            update.executedQuery());
+        }
+        ++batch;
+      }
+      select.finish();
+      if(!db.commit()) {
+        throw Failure("Could not commit transaction: " +
+          db.lastError().text());
+      }
+    } catch(Failure&) {
+      db.rollback();
+      throw;
+    }
+    rows += batch;
+    upgradeProgress(version, rows, total);
+  } while(batch == UPGRADE_BATCH_SIZE);
+
+  QStringList statements;
+  statements << "DROP INDEX IF EXISTS logs_geocache";
+  // identifies a log
+  statements << "CREATE UNIQUE INDEX IF NOT EXISTS logs_key "
+    "ON logs(geocache, logkey)";
+  // returns the logs of a geocache ordered by date
+  statements << "CREATE INDEX IF NOT EXISTS logs_date ON logs(geocache, date)";
+  foreach(QString statement, statements) {
+    if(!q.exec(statement)) {
+      throw Failure("Failed to create log indices! " + q.lastError().text() +
+        "\nFailed query was: " + q.executedQuery());
+    }
+  }
+}
+
+/**
+ * Get the generation counter of the data. It changes with every @a save(), so
+ * caches of the data like SummarySnapshot can be checked for staleness.
+ * @throws Failure if anything goes wrong
+ */
+quint64 GeocacheDatabase::generation() {
+  QSqlQuery query(db);
+  if(!query.exec("SELECT value FROM metadata WHERE key = 'generation'")) {
+    throw Failure("Failed to read generation! " + query.lastError().text() +
+      "\nFailed query was: " + query.executedQuery());
+  }
+  return query.next() ? query.value(0).toULongLong() : 0;
+}
+
+/**
+ * Write the summaries of all geocaches to a SummarySnapshot file, together
+ * with the current generation.
+ * @param fileName File name of the snapshot
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::writeSnapshot(const QString& fileName) {
+  QTime timer;
+  timer.start();
+
+  // read in one transaction, so the generation matches the rows
+  if(!db.transaction()) {
+    throw Failure("Could not begin transaction: " + db.lastError().text());
+  }
+  quint64 gen;
+  QVector<GeocacheSummary> summaries;
+  QStringList names, ownerNames;
+  try {
+    gen = generation();
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if(!query.exec(QString("SELECT %1,w.name,c.ownerid FROM waypoints w "
+      "JOIN geocaches c ON c.waypoint = w.waypoint ORDER BY w.waypoint").
+      arg(SUMMARY_COLUMNS))) {
+      throw Failure("Failed to read summaries! " + query.lastError().text() +
+        "\nFailed query was: " + query.executedQuery());
+    }
+    while(query.next()) {
+      summaries.append(summaryFromQuery(query));
+      names << query.value(SUMMARY_COLUMN_COUNT).toString();
+      ownerNames << owners.name(db,
+        query.value(SUMMARY_COLUMN_COUNT + 1).toLongLong());
+    }
+  } catch(Failure&) {
+    db.rollback();
+    throw;
+  }
+  db.commit();
+
+  SummarySnapshot::write(fileName, gen, summaries, names, ownerNames);
+  qDebug() << "wrote snapshot of" << summaries.size() << "geocaches in" <<
+    timer.elapsed() << "ms";
+}
+
+/**
+ * @internal
+ * Create the full-text search index over the names, owners, descriptions,
+ * hints and logs of the geocaches, if it does not exist yet. The newest
+ * available SQLite full-text module is used. The rowid of the index is the
+ * rowid of the geocache in @c waypoints. If the SQLite library has no
+ * full-text module, @a search() falls back to a slow LIKE query.
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::createSearchIndex() {
+  q.exec("SELECT sql FROM sqlite_master WHERE name = 'geocaches_fts'");
+  if(q.next()) {
+    QString sql = q.value(0).toString().toLower();
+    ftsVersion = sql.contains("fts5") ? 5 : sql.contains("fts4") ? 4 : 3;
+    q.finish();
+    return;
+  }
+
+  ftsVersion = 0;
+  for(int version = 5; version >= 3 && !ftsVersion; --version) {
+    if(q.exec(QString("CREATE VIRTUAL TABLE geocaches_fts USING fts%1("
+      "name, owner, shortdesc, desc, hint, logs)").arg(version))) {
+      ftsVersion = version;
+    }
+  }
+  if(!ftsVersion) {
+    qDebug() << "no full-text module available, search uses LIKE:" <<
+      q.lastError().text();
+    return;
+  }
+  qDebug() << "created full-text index with fts" << ftsVersion;
+
+  // index the geocaches that are already in the database
+  if(!db.transaction()) {
+    throw Failure("Could not begin transaction: " + db.lastError().text());
+  }
+  try {
+    SearchWriter writer(db);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if(!query.exec("SELECT w.waypoint, w.name, o.name, c.shortdesc, w.desc, "
+      "c.hint FROM waypoints w JOIN geocaches c ON c.waypoint = w.waypoint "
+      "JOIN owners o ON o.id = c.ownerid")) {
+      throw Failure("Failed to fill table 'geocaches_fts'! " +
+        query.lastError().text() + "\nFailed query was: " +
+        query.executedQuery());
+    }
+    while(query.next()) {
+      Geocache geocache;
+      geocache.waypoint = query.value(0).toString();
+      geocache.name = query.value(1).toString();
+      geocache.owner = query.value(2).toString();
+      geocache.shortDesc = textFromValue(query.value(3));
+      geocache.desc = textFromValue(query.value(4));
+      geocache.hint = query.value(5).toString();
+      writer.insert(geocache);
+    }
+    if(!db.commit()) {
+      throw Failure("Could not commit transaction: " + db.lastError().text());
+    }
+  } catch(Failure&) {
+    db.rollback();
+    throw;
+  }
+}
+
+/**
+ * Search the geocaches for words in their names, owners, descriptions, hints
+ * and logs. All words must match, and words are also matched as prefixes.
+ * @param text The words to search for
+ * @param limit Maximum number of results
+ * @param offset Number of better results to skip
+ * @return The matching geocaches, best matches first if the full-text module
+ *  supports ranking, otherwise ordered by name
+ * @throws Failure if anything goes wrong
+ */
+QVector<SearchResult> GeocacheDatabase::search(const QString& text, int limit,
+  int offset) {
+  QStringList words = text.split(QRegExp("\\W+"), QString::SkipEmptyParts);
+  QVector<SearchResult> ret;
+  if(words.isEmpty()) {
+    return ret;
+  }
+
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  if(ftsVersion) {
+    // only word characters are left; fts5 needs them quoted, or words like
+    // AND would be taken as operators
+    QStringList terms;
+    foreach(QString word, words) {
+      if(ftsVersion == 5) {
+        terms << "\"" + word + "\"*";
+      } else {
+        terms << word + "*";
+      }
+    }
+    // bm25() is only built into fts5, weigh the name highest
+    QString order = (ftsVersion == 5) ?
+      "bm25(geocaches_fts, 10.0, 5.0, 2.0, 1.0, 1.0, 0.5)" : "w.name";
+    query.prepare(QString("SELECT %1,w.name FROM geocaches_fts f "
+      "JOIN waypoints w ON w.rowid = f.rowid "
+      "JOIN geocaches c ON c.waypoint = w.waypoint "
+      "WHERE geocaches_fts MATCH :match ORDER BY %2 "
+      "LIMIT :limit OFFSET :offset").arg(SUMMARY_COLUMNS).arg(order));
+    query.bindValue(":match", terms.join(" "));
+  } else {
+    query.prepare(QString("SELECT %1,w.name FROM waypoints w "
+      "JOIN geocaches c ON c.waypoint = w.waypoint "
+      "WHERE w.name LIKE :name OR w.waypoint LIKE :waypoint ORDER BY w.name "
+      "LIMIT :limit OFFSET :offset").arg(SUMMARY_COLUMNS));
+    query.bindValue(":name", "%" + words.join("%") + "%");
+    query.bindValue(":waypoint", words.first() + "%");
+  }
+  query.bindValue(":limit", limit);
+  query.bindValue(":offset", offset);
+  if(!query.exec()) {
+    throw Failure("Failed to search for '" + text + "'! " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+
+  while(query.next()) {
+    SearchResult result;
+    result.summary = summaryFromQuery(query);
+    result.name = query.value(SUMMARY_COLUMN_COUNT).toString();
+    ret.append(result);
+  }
+  return ret;
+}
+
+/**
+ * @internal
+ * Build a geocache from the current row of a query that selects
+ * @c GEOCACHE_COLUMNS.
+ * @param query The query, positioned on a valid row
+ * @return A new geocache object. The caller is responsible for freeing it.
+ */
+Geocache * GeocacheDatabase::geocacheFromQuery(const QSqlQuery& query) {
+  Geocache * geocache = new Geocache;
+  bool ok;
+  geocache->waypoint = query.value(0).toString();
+  geocache->name = query.value(1).toString();
+  geocache->coord = Coordinate(query.value(2).toDouble(&ok),
+    query.value(3).toDouble(&ok));
+  geocache->type = static_cast<WaypointType>(query.value(4).toInt(&ok));
+  geocache->desc = textFromValue(query.value(5));
+  geocache->shortDesc = textFromValue(query.value(6));
+  geocache->size = static_cast<GeocacheSize>(query.value(7).toInt(&ok));
+  geocache->terrain = query.value(8).toInt(&ok);
+  geocache->difficulty = query.value(9).toInt(&ok);
+  geocache->placed = dateFromValue(query.value(10));
+  geocache->found = dateFromValue(query.value(11));
+  geocache->owner = owners.name(db, query.value(12).toLongLong());
+  geocache->attrs = GeocacheAttributes::fromBlob(query.value(13).
+    toByteArray());
+  geocache->hint = query.value(14).toString();
+  geocache->archived = query.value(15).toBool();
+  return geocache;
+}
+
+/**
+ * @internal
+ * Build a geocache summary from the current row of a query that selects
+ * @c SUMMARY_COLUMNS.
+ * @param query The query, positioned on a valid row
+ */
+GeocacheSummary GeocacheDatabase::summaryFromQuery(const QSqlQuery& query) {
+  GeocacheSummary summary;
+  summary.setWaypoint(query.value(0).toString());
+  summary.lat = query.value(1).toDouble();
+  summary.lon = query.value(2).toDouble();
+  summary.type = query.value(3).toInt();
+  summary.size = query.value(4).toInt();
+  summary.difficulty = query.value(5).toInt();
+  summary.terrain = query.value(6).toInt();
+  summary.flags = query.value(7).toBool() ? GeocacheSummary::FLAG_ARCHIVED : 0;
+  return summary;
+}
+
+/**
+ * @internal
+ * Prepare and execute a query for all geocaches inside a rectangular area,
+ * using the spatial index.
+ * @param query The query to execute
+ * @param columns The columns to select, the waypoints table is aliased as @c w
+ *  and the geocaches table as @c c
+ * @param sw South-western corner of the area
+ * @param ne North-eastern corner of the area
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::execAreaQuery(QSqlQuery& query, const QString& columns,
+  const Coordinate& sw, const Coordinate& ne) {
+  if(hasRtree) {
+    // the R*Tree stores 32 bit floats rounded outwards, so we have to check
+    // against the exact values afterwards
+    query.prepare(QString("SELECT %1 FROM waypoints_rtree r "
+      "JOIN waypoints w ON w.rowid = r.id "
+      "JOIN geocaches c ON c.waypoint = w.waypoint "
+      "WHERE r.maxlat >= :rsouth AND r.minlat <= :rnorth "
+      "AND r.maxlon >= :rwest AND r.minlon <= :reast "
+      "AND w.lat BETWEEN :south AND :north "
+      "AND w.lon BETWEEN :west AND :east").arg(columns));
+    query.bindValue(":rsouth", static_cast<double>(sw.lat));
+    query.bindValue(":rnorth", static_cast<double>(ne.lat));
+    query.bindValue(":rwest", static_cast<double>(sw.lon));
+    query.bindValue(":reast", static_cast<double>(ne.lon));
+  } else {
+    query.prepare(QString("SELECT %1 FROM waypoints w "
+      "JOIN geocaches c ON c.waypoint = w.waypoint "
+      "WHERE w.lat BETWEEN :south AND :north "
+      "AND w.lon BETWEEN :west AND :east").arg(columns));
+  }
+  query.bindValue(":south", static_cast<double>(sw.lat));
+  query.bindValue(":north", static_cast<double>(ne.lat));
+  query.bindValue(":west", static_cast<double>(sw.lon));
+  query.bindValue(":east", static_cast<double>(ne.lon));
+  if(!query.exec()) {
+    throw Failure("Failed to query geocaches in area! " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+}
+
+/**
+ * Start a query for the summaries of all geocaches inside a rectangular area,
+ * to read them row by row with @a summaryFromQuery(). See
+ * @a geocachesInRect() for the constraints on the area.
+ * @param query Query on this database, it is executed by this function
+ * @param sw South-western corner of the area
+ * @param ne North-eastern corner of the area
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::execSummaryQuery(QSqlQuery& query, const Coordinate& sw,
+  const Coordinate& ne) {
+  query.setForwardOnly(true);
+  execAreaQuery(query, SUMMARY_COLUMNS, sw, ne);
+}
+
+/**
+ * Get all geocaches inside a rectangular area. The area must not cross the
+ * 180th meridian, i.e. the longitude of @a sw must be less than or equal to
+ * the longitude of @a ne. The query uses the spatial index, so only the
+ * geocaches in the area are read from the database, and only the columns
+ * needed for the summaries.
+ * @param sw South-western corner of the area
+ * @param ne North-eastern corner of the area
+ * @return Summaries of the geocaches in the area
+ * @throws Failure if anything goes wrong
+ */
+QVector<GeocacheSummary> GeocacheDatabase::geocachesInRect(const Coordinate& sw,
+  const Coordinate& ne) {
+  QSqlQuery query(db);
+  execSummaryQuery(query, sw, ne);
+
+  QVector<GeocacheSummary> ret;
+  while(query.next()) {
+    ret.append(summaryFromQuery(query));
+  }
+  return ret;
+}
+
+/**
+ * Get the summaries and names of the geocaches that follow a waypoint, ordered
+ * by waypoint, to read all geocaches page by page. The page starts on the
+ * primary key, so reading a page does not depend on the number of pages
+ * before it.
+ * @param names Gets the names of the geocaches, in the same order
+ * @param after Waypoint of the last geocache of the previous page, or an
+ *  empty string for the first page
+ * @param limit Maximum number of geocaches to return
+ * @return Summaries of the geocaches, fewer than @a limit on the last page
+ * @throws Failure if anything goes wrong
+ */
+QVector<GeocacheSummary> GeocacheDatabase::summaries(QStringList& names,
+  const QString& after, int limit) {
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  query.prepare(QString("SELECT %1,w.name FROM waypoints w JOIN geocaches c "
+    "ON c.waypoint = w.waypoint WHERE w.waypoint > :after "
+    "ORDER BY w.waypoint LIMIT :limit").arg(SUMMARY_COLUMNS));
+  query.bindValue(":after", after);
+  query.bindValue(":limit", limit);
+  if(!query.exec()) {
+    throw Failure("Failed to read summaries! " + query.lastError().text() +
+      "\nFailed query was: " + query.executedQuery());
+  }
+
+  QVector<GeocacheSummary> ret;
+  names.clear();
+  while(query.next()) {
+    ret.append(summaryFromQuery(query));
+    names << query.value(SUMMARY_COLUMN_COUNT).toString();
+  }
+  return ret;
+}
+
+/**
+ * Get all geocaches inside a circular area. If the area crosses the 180th
+ * meridian, it is queried as two rectangles, one on each side.
+ * @param center Center of the area
+ * @param radius Radius of the area in km
+ * @return Summaries of the geocaches in the area, ordered by ascending distance
+ *  to @a center
+ * @throws Failure if anything goes wrong
+ */
+QVector<GeocacheSummary> GeocacheDatabase::geocachesInRadius(
+  const Coordinate& center, qreal radius) {
+  // bounding box of the circle, then filter by exact distance
+  qreal dLat = radius / KM_PER_DEGREE;
+  qreal south = center.lat - dLat;
+  qreal north = center.lat + dLat;
+  qreal dLon = 180.0;
+  // circles around a pole contain all longitudes
+  if(south > -90.0 && north < 90.0) {
+    // the circle is widest poleward of its center, where the meridian
+    // touches it: sin(dLon) = sin(radius) / cos(lat)
+    qreal sinLon = sin(dLat * M_PI / 180.0) / cos(center.lat * M_PI / 180.0);
+    if(sinLon < 1.0) {
+      dLon = asin(sinLon) * 180.0 / M_PI;
+    }
+  }
+  south = qMax(south, -90.0);
+  north = qMin(north, 90.0);
+  qreal west = center.lon - dLon;
+  qreal east = center.lon + dLon;
+
+  QVector<GeocacheSummary> found;
+  if(dLon >= 180.0) {
+    found = geocachesInRect(Coordinate(south, -180.0),
+      Coordinate(north, 180.0));
+  } else if(west < -180.0) {
+    found = geocachesInRect(Coordinate(south, -180.0), Coordinate(north,
+      east));
+    found += geocachesInRect(Coordinate(south, west + 360.0),
+      Coordinate(north, 180.0));
+  } else if(east > 180.0) {
+    found = geocachesInRect(Coordinate(south, west), Coordinate(north,
+      180.0));
+    found += geocachesInRect(Coordinate(south, -180.0),
+      Coordinate(north, east - 360.0));
+  } else {
+    found = geocachesInRect(Coordinate(south, west), Coordinate(north, east));
+  }
+
+  QMap<qreal, GeocacheSummary> sorted;
+  foreach(const GeocacheSummary& summary, found) {
+    qreal dist = center.distanceTo(summary.coord());
+    if(dist <= radius) {
+      sorted.insertMulti(dist, summary);
+    }
+  }
+  return sorted.values().toVector();
+}
+
+/**
+ * @internal
+ * Build the SQL condition that a column is one of the set bits of a mask
+ */
+static QString maskCondition(const QString& column, quint32 mask) {
+  QStringList values;
+  for(int i = 0; i < 32; ++i) {
+    if(mask & (1u << i)) {
+      values << QString::number(i);
+    }
+  }
+  return QString("%1 IN (%2)").arg(column).arg(values.join(","));
+}
+
+/**
+ * Get the geocaches that match a query. All conditions except the attribute
+ * filter are evaluated by SQLite on the indices of the columns. Attributes
+ * are stored as bitset, so they are tested on the rows returned by SQLite,
+ * and the page is cut out after that.
+ * @param query The filter, sort order and page
+ * @param sortKeys If not @c 0, the sort key of each result is appended here,
+ *  see GeocacheQuery::sortKey()
+ * @return Summaries of the matching geocaches, in the requested order
+ * @throws Failure if anything goes wrong
+ */
+QVector<GeocacheSummary> GeocacheDatabase::query(const GeocacheQuery& query,
+  QVector<QVariant> * sortKeys) {
+  QString from = "waypoints w JOIN geocaches c ON c.waypoint = w.waypoint";
+  QStringList where;
+  QMap<QString, QVariant> values;
+
+  if(query.hasArea()) {
+    const Coordinate& sw = query.areaSouthWest();
+    const Coordinate& ne = query.areaNorthEast();
+    if(hasRtree) {
+      from = "waypoints_rtree r JOIN waypoints w ON w.rowid = r.id "
+        "JOIN geocaches c ON c.waypoint = w.waypoint";
+      where << "r.maxlat >= :rsouth AND r.minlat <= :rnorth "
+        "AND r.maxlon >= :rwest AND r.minlon <= :reast";
+      values.insert(":rsouth", static_cast<double>(sw.lat));
+      values.insert(":rnorth", static_cast<double>(ne.lat));
+      values.insert(":rwest", static_cast<double>(sw.lon));
+      values.insert(":reast", static_cast<double>(ne.lon));
+    }
+    where << "w.lat BETWEEN :south AND :north "
+      "AND w.lon BETWEEN :west AND :east";
+    values.insert(":south", static_cast<double>(sw.lat));
+    values.insert(":north", static_cast<double>(ne.lat));
+    values.insert(":west", static_cast<double>(sw.lon));
+    values.insert(":east", static_cast<double>(ne.lon));
+  }
+  if(query.types()) {
+    where << maskCondition("w.type", query.types());
+  }
+  if(query.sizes()) {
+    where << maskCondition("c.size", query.sizes());
+  }
+  where << "c.difficulty BETWEEN :mindiff AND :maxdiff";
+  values.insert(":mindiff", query.minDifficulty());
+  values.insert(":maxdiff", query.maxDifficulty());
+  where << "c.terrain BETWEEN :minterr AND :maxterr";
+  values.insert(":minterr", query.minTerrain());
+  values.insert(":maxterr", query.maxTerrain());
+  if(query.placedFrom().isValid() || query.placedTo().isValid()) {
+    where << "c.placed > 0";
+  }
+  if(query.placedFrom().isValid()) {
+    where << "c.placed >= :placedfrom";
+    values.insert(":placedfrom", dateToValue(query.placedFrom()));
+  }
+  if(query.placedTo().isValid()) {
+    where << "c.placed <= :placedto";
+    values.insert(":placedto", dateToValue(query.placedTo()));
+  }
+  if(query.foundFrom().isValid() || query.foundTo().isValid()) {
+    where << "c.found > 0";
+  }
+  if(query.foundFrom().isValid()) {
+    where << "c.found >= :foundfrom";
+    values.insert(":foundfrom", dateToValue(query.foundFrom()));
+  }
+  if(query.foundTo().isValid()) {
+    where << "c.found <= :foundto";
+    values.insert(":foundto", dateToValue(query.foundTo()));
+  }
+  if(!query.owner().isNull()) {
+    // the owner is looked up once, then the index on the id is used
+    where << "c.ownerid = :ownerid";
+    values.insert(":ownerid", owners.find(db, query.owner()));
+  }
+  if(query.archived() == GeocacheQuery::ARCHIVED_EXCLUDE) {
+    where << "c.archived = 0";
+  } else if(query.archived() == GeocacheQuery::ARCHIVED_ONLY) {
+    where << "c.archived <> 0";
+  }
+
+  // the sort key is selected, so results can be merged with others
+  QString key = "NULL";
+  QString collate;
+  switch(query.sortOrder()) {
+    case GeocacheQuery::SORT_WAYPOINT:
+      key = "w.waypoint";
+      collate = " COLLATE NOCASE";
+      break;
+    case GeocacheQuery::SORT_NAME:
+      key = "w.name";
+      collate = " COLLATE NOCASE";
+      break;
+    case GeocacheQuery::SORT_DIFFICULTY:
+      key = "c.difficulty";
+      break;
+    case GeocacheQuery::SORT_TERRAIN:
+      key = "c.terrain";
+      break;
+    case GeocacheQuery::SORT_PLACED:
+      key = "c.placed";
+      break;
+    case GeocacheQuery::SORT_FOUND:
+      key = "c.found";
+      break;
+    case GeocacheQuery::SORT_DISTANCE: {
+      // same formula as GeocacheQuery::distanceKey()
+      const Coordinate& center = query.sortCenter();
+      QString lat = QString::number(center.lat, 'g', 17);
+      QString lon = QString::number(center.lon, 'g', 17);
+      QString cosLat = QString::number(cos(center.lat * M_PI / 180.0), 'g',
+        17);
+      key = QString("(w.lat - %1) * (w.lat - %1) + "
+        "(w.lon - %2) * %3 * (w.lon - %2) * %3").arg(lat).arg(lon).
+        arg(cosLat);
+      break;
+    }
+    default:
+      break;
+  }
+
+  QString sql = QString("SELECT %1,%2 AS sortkey,c.attrs FROM %3").
+    arg(SUMMARY_COLUMNS).arg(key).arg(from);
+  if(!where.isEmpty()) {
+    sql += " WHERE " + where.join(" AND ");
+  }
+  if(query.sortOrder() != GeocacheQuery::SORT_NONE) {
+    QString direction = query.descending() ? " DESC" : " ASC";
+    sql += QString(" ORDER BY sortkey%1%2, w.waypoint%2").arg(collate).
+      arg(direction);
+  }
+  bool filterAttrs = query.hasAttributeFilter();
+  if(!filterAttrs && (query.limit() >= 0 || query.offset() > 0)) {
+    sql += QString(" LIMIT %1 OFFSET %2").arg(query.limit()).
+      arg(query.offset());
+  }
+
+  QSqlQuery sqlQuery(db);
+  sqlQuery.setForwardOnly(true);
+  sqlQuery.prepare(sql);
+  for(QMap<QString, QVariant>::const_iterator it = values.constBegin();
+    it != values.constEnd(); ++it) {
+    sqlQuery.bindValue(it.key(), it.value());
+  }
+  if(!sqlQuery.exec()) {
+    throw Failure("Failed to query geocaches! " + sqlQuery.lastError().text() +
+      "\nFailed query was: " + sqlQuery.executedQuery());
+  }
+
+  QVector<GeocacheSummary> ret;
+  int skip = filterAttrs ? query.offset() : 0;
+  while((query.limit() < 0 || ret.size() < query.limit()) && sqlQuery.next()) {
+    if(filterAttrs) {
+      GeocacheAttributes attrs = GeocacheAttributes::fromBlob(
+        sqlQuery.value(SUMMARY_COLUMN_COUNT + 1).toByteArray());
+      if(!attrs.containsAll(query.requiredAttributes()) ||
+        attrs.containsAny(query.excludedAttributes())) {
+        continue;
+      }
+      if(skip > 0) {
+        --skip;
+        continue;
+      }
+    }
+    ret.append(summaryFromQuery(sqlQuery));
+    if(sortKeys) {
+      sortKeys->append(sqlQuery.value(SUMMARY_COLUMN_COUNT));
+    }
+  }
+  return ret;
+}
+
+/**
+ * Read the full details of a single geocache, except for the logs.
+ * @param waypoint Waypoint of the geocache
+ * @return A new geocache object, or @c 0 if there is no geocache with this
+ *  waypoint. The caller is responsible for freeing it.
+ * @throws Failure if anything goes wrong
+ */
+Geocache * GeocacheDatabase::geocache(const QString& waypoint) {
+  QSqlQuery query(db);
+  query.prepare(QString("SELECT %1 FROM waypoints w JOIN geocaches c "
+    "ON w.waypoint = c.waypoint WHERE w.waypoint = :waypoint").
+    arg(GEOCACHE_COLUMNS));
+  query.bindValue(":waypoint", waypoint);
+  if(!query.exec()) {
+    throw Failure("Failed to load geocache " + waypoint + "! " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+  if(!query.next()) {
+    return 0;
+  }
+  Geocache * geocache = geocacheFromQuery(query);
+
+  // additional waypoints are few, so load them with the geocache
+  query.prepare("SELECT prefix, name, lat, lon, type, desc "
+    "FROM geocachewaypoints WHERE geocache = :geocache ORDER BY rowid");
+  query.bindValue(":geocache", waypoint);
+  if(!query.exec()) {
+    delete geocache;
+    throw Failure("Failed to load waypoints of " + waypoint + "! " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+  while(query.next()) {
+    Waypoint wp;
+    wp.waypoint = query.value(0).toString();
+    wp.name = query.value(1).toString();
+    if(!query.value(2).isNull() && !query.value(3).isNull()) {
+      wp.coord = Coordinate(query.value(2).toDouble(),
+        query.value(3).toDouble());
+    }
+    wp.type = static_cast<WaypointType>(query.value(4).toInt());
+    wp.desc = textFromValue(query.value(5));
+    geocache->waypoints.append(wp);
+  }
+
+  return geocache;
+}
+
+/**
+ * Get the log messages of a geocache, newest first. Logs are not part of the
+ * geocaches returned by @a geocache(), because popular geocaches can have
+ * thousands of them; use this function to read them page by page instead.
+ * @param waypoint Waypoint of the geocache
+ * @param limit Maximum number of logs to return
+ * @param offset Number of newer logs to skip
+ * @return The logs, or an empty vector if there are no (more) logs
+ * @throws Failure if anything goes wrong
+ */
+QVector<LogMessage> GeocacheDatabase::logs(const QString& waypoint, int limit,
+  int offset) {
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  query.prepare("SELECT id, date, authorid, type, msg, encrypted, logkey "
+    "FROM logs WHERE geocache = :geocache ORDER BY date DESC, id DESC "
+    "LIMIT :limit OFFSET :offset");
+  query.bindValue(":geocache", waypoint);
+  query.bindValue(":limit", limit);
+  query.bindValue(":offset", offset);
+  if(!query.exec()) {
+    throw Failure("Failed to load logs of " + waypoint + "! " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+
+  QVector<LogMessage> ret;
+  QHash<qlonglong, int> logIndex; // log id -> index in ret
+  while(query.next()) {
+    LogMessage log;
+    log.date = dateFromValue(query.value(1));
+    log.author = authors.name(db, query.value(2).toLongLong());
+    log.type = static_cast<LogType>(query.value(3).toInt());
+    log.msg = textFromValue(query.value(4));
+    log.encrypted = query.value(5).toBool();
+    QString key = query.value(6).toString();
+    if(!key.startsWith('#')) {
+      log.id = key; // not a hash, see logHashKey()
+    }
+    logIndex.insert(query.value(0).toLongLong(), ret.size());
+    ret.append(log);
+  }
+  if(logIndex.isEmpty()) {
+    return ret;
+  }
+
+  // images of all logs on this page in one query
+  QStringList ids;
+  foreach(qlonglong id, logIndex.keys()) {
+    ids << QString::number(id);
+  }
+  if(!query.exec(QString("SELECT li.log, i.filename, i.desc FROM logimages li "
+    "JOIN images i ON i.filename = li.image WHERE li.log IN (%1)").
+    arg(ids.join(",")))) {
+    throw Failure("Failed to load log images of " + waypoint + "! " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+  while(query.next()) {
+    GeocacheImage image;
+    image.fileName = query.value(1).toString();
+    image.desc = query.value(2).toString();
+    ret[logIndex.value(query.value(0).toLongLong())].images.append(image);
+  }
+  return ret;
+}
+
+/**
+ * Get the number of log messages of a geocache
+ * @param waypoint Waypoint of the geocache
+ * @throws Failure if anything goes wrong
+ */
+int GeocacheDatabase::logCount(const QString& waypoint) {
+  QSqlQuery query(db);
+  query.prepare("SELECT COUNT(*) FROM logs WHERE geocache = :geocache");
+  query.bindValue(":geocache", waypoint);
+  if(!query.exec() || !query.next()) {
+    throw Failure("Failed to count logs of " + waypoint + "! " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+  return query.value(0).toInt();
+}
+
+/**
+ * Read the attributes of all geocaches into a bitmap index
+ * @param index The index, it is cleared first
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::loadAttributes(AttributeIndex& index) {
+  index.clear();
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  if(!query.exec("SELECT waypoint, attrs FROM geocaches")) {
+    throw Failure("Failed to load attributes! " + query.lastError().text() +
+      "\nFailed query was: " + query.executedQuery());
+  }
+  while(query.next()) {
+    index.set(query.value(0).toString(),
+      GeocacheAttributes::fromBlob(query.value(1).toByteArray()));
+  }
+}
+
+/**
+ * Get the fetch records of some geocaches
+ * @param waypoints Waypoints of the geocaches
+ * @return The records by waypoint. Geocaches that were never fetched from
+ *  geocaching.com have none.
+ * @throws Failure if anything goes wrong
+ */
+QHash<QString, FetchRecord> GeocacheDatabase::fetchRecords(
+  const QStringList& waypoints) {
+  QHash<QString, FetchRecord> ret;
+  QSqlQuery query(db);
+  query.prepare("SELECT fetched, listhash, hash FROM fetches "
+    "WHERE waypoint = :waypoint");
+  foreach(const QString& waypoint, waypoints) {
+    query.bindValue(":waypoint", waypoint);
+    if(!query.exec()) {
+      throw Failure("Failed to read fetch records! " +
+        query.lastError().text() + "\nFailed query was: " +
+        query.executedQuery());
+    }
+    if(query.next()) {
+      FetchRecord record;
+      record.waypoint = waypoint;
+      record.fetched = QDateTime::fromTime_t(query.value(0).toUInt());
+      record.listHash = query.value(1).toByteArray();
+      record.hash = query.value(2).toByteArray();
+      ret.insert(waypoint, record);
+    }
+  }
+  return ret;
+}
+
+/**
+ * Write fetch records in one transaction, replacing older ones of the same
+ * geocaches
+ * @throws Failure if anything goes wrong
+ */
+void GeocacheDatabase::saveFetchRecords(const QVector<FetchRecord>& records) {
+  if(!db.transaction()) {
+    throw Failure("Could not begin transaction: " + db.lastError().text());
+  }
+  try {
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO fetches (waypoint, fetched, "
+      "listhash, hash) VALUES (:waypoint, :fetched, :listhash, :hash)");
+    foreach(const FetchRecord& record, records) {
+      query.bindValue(":waypoint", record.waypoint);
+      query.bindValue(":fetched", record.fetched.toTime_t());
+      query.bindValue(":listhash", record.listHash);
+      query.bindValue(":hash", record.hash);
+      if(!query.exec()) {
+        throw Failure("Failed to write fetch records! " +
+          query.lastError().text() + "\nFailed query was: " +
+          query.executedQuery());
+      }
+    }
+    if(!db.commit()) {
+      throw Failure("Could not commit transaction: " + db.lastError().text());
+    }
+  } catch(Failure&) {
+    db.rollback();
+    throw;
+  }
+}
+
+/**
+ * @internal
+ * Bind the values of the @c waypoints table to a prepared query
+ */
+static void bindWaypoint(QSqlQuery& query, const Geocache& geocache) {
+  query.bindValue(":waypoint", geocache.waypoint);
+  query.bindValue(":name", geocache.name);
+  query.bindValue(":lat", static_cast<double>(geocache.coord.lat));
+  query.bindValue(":lon", static_cast<double>(geocache.coord.lon));
+  query.bindValue(":type", static_cast<int>(geocache.type));
+  query.bindValue(":desc", textToValue(geocache.desc));
+}
+
+/**
+ * @internal
+ * Bind the values of the @c geocaches table to a prepared query
+ * @param ownerId Id of the owner in the @c owners table
+ */
+static void bindGeocache(QSqlQuery& query, const Geocache& geocache,
+  qlonglong ownerId) {
+  query.bindValue(":waypoint", geocache.waypoint);
+  query.bindValue(":shortdesc", textToValue(geocache.shortDesc));
+  query.bindValue(":size", geocache.size);
+  query.bindValue(":terrain", geocache.terrain);
+  query.bindValue(":difficulty", geocache.difficulty);
+  query.bindValue(":placed", dateToValue(geocache.placed));
+  query.bindValue(":found", dateToValue(geocache.found));
+  query.bindValue(":ownerid", ownerId);
+  query.bindValue(":attrs", geocache.attrs.toBlob());
+  query.bindValue(":hint", geocache.hint);
+  query.bindValue(":archived", geocache.archived);
+}
+
+/**
+ * @internal
+ * Execute an already bound UPDATE statement, and if it did not touch any row,
+ * the equivalent INSERT statement. This replaces an existence probe per row,
+ * and existing rows keep their rowid.
+ * @param update Prepared and bound UPDATE statement
+ * @param insert Prepared and bound INSERT statement
+ * @param table Name of the table, used in the error message
+ * @throws Failure if one of the statements fails
+ */
+static void execUpsert(QSqlQuery& update, QSqlQuery& insert,
+  const QString& table) {
+  QSqlQuery * failed = &update;
+  if(update.exec()) {
+    if(update.numRowsAffected() > 0 || insert.exec()) {
+      return;
+    }
+    failed = &insert;
+  }
+  throw Failure("Error while trying to save to SQL table '" + table + "': " +
+    failed->lastError().text() + "\nFailed query was: " +
+    failed->executedQuery());
+}
+
+/**
+ * @internal
+ * Throw a Failure if an already bound statement cannot be executed
+ * @param query Prepared and bound statement
+ * @param table Name of the table, used in the error message
+ */
+static void execWrite(QSqlQuery& query, const QString& table) {
+  if(!query.exec()) {
+    throw Failure("Error while trying to save to SQL table '" + table + "': " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+}
+
+/**
+ * @internal
+ * Writes the additional waypoints, logs and images of geocaches, with
+ * statements that are prepared once per save. Additional waypoints are
+ * replaced as a whole. Logs are merged by geocache and key, see
+ * GeocacheDatabase::createLogKeys(), so logs that are no longer on a
+ * downloaded page are kept in the database.
+ */
+struct DetailWriter {
+  QSqlDatabase& db;
+  NameDictionary& authors;
+  QSqlQuery deleteWpts, insertWpt, updateLog, adoptLog, insertLog, selectLog;
+  QSqlQuery insertImage, insertLogImage;
+
+  DetailWriter(QSqlDatabase& db, NameDictionary& authors) : db(db),
+    authors(authors), deleteWpts(db), insertWpt(db), updateLog(db),
+    adoptLog(db), insertLog(db), selectLog(db), insertImage(db),
+    insertLogImage(db) {
+    deleteWpts.prepare("DELETE FROM geocachewaypoints "
+      "WHERE geocache = :geocache");
+    insertWpt.prepare("INSERT INTO geocachewaypoints (geocache, prefix, name, "
+      "lat, lon, type, desc) VALUES (:geocache, :prefix, :name, :lat, :lon, "
+      ":type, :desc)");
+    updateLog.prepare("UPDATE logs SET date = :date, authorid = :authorid, "
+      "type = :type, msg = :msg, encrypted = :encrypted "
+      "WHERE geocache = :geocache AND logkey = :logkey");
+    // a log that was saved without its identifier before
+    adoptLog.prepare("UPDATE logs SET logkey = :logkey, date = :date, "
+      "authorid = :authorid, type = :type, msg = :msg, encrypted = :encrypted "
+      "WHERE geocache = :geocache AND logkey = :hashkey");
+    insertLog.prepare("INSERT INTO logs (geocache, logkey, date, authorid, "
+      "type, msg, encrypted) VALUES (:geocache, :logkey, :date, :authorid, "
+      ":type, :msg, :encrypted)");
+    selectLog.prepare("SELECT id FROM logs WHERE geocache = :geocache AND "
+      "logkey = :logkey");
+    insertImage.prepare("INSERT OR REPLACE INTO images (filename, desc) "
+      "VALUES (:filename, :desc)");
+    insertLogImage.prepare("INSERT OR IGNORE INTO logimages (log, image) "
+      "VALUES (:log, :image)");
+  }
+
+  /** Bind the values of a log and its key */
+  static void bindLog(QSqlQuery& query, const QString& geocache,
+    const LogMessage& log, const QString& key, qlonglong authorId) {
+    query.bindValue(":geocache", geocache);
+    query.bindValue(":logkey", key);
+    query.bindValue(":date", dateToValue(log.date));
+    query.bindValue(":authorid", authorId);
+    query.bindValue(":type", static_cast<int>(log.type));
+    query.bindValue(":msg", textToValue(log.msg));
+    query.bindValue(":encrypted", log.encrypted);
+  }
+
+  /** @throws Failure if anything goes wrong */
+  void write(const Geocache& geocache) {
+    deleteWpts.bindValue(":geocache", geocache.waypoint);
+    execWrite(deleteWpts, "geocachewaypoints");
+    foreach(const Waypoint& wp, geocache.waypoints) {
+      insertWpt.bindValue(":geocache", geocache.waypoint);
+      insertWpt.bindValue(":prefix", wp.waypoint);
+      insertWpt.bindValue(":name", wp.name);
+      if(wp.coord.lat == COORD_INVALID.lat) {
+        insertWpt.bindValue(":lat", QVariant(QVariant::Double));
+        insertWpt.bindValue(":lon", QVariant(QVariant::Double));
+      } else {
+        insertWpt.bindValue(":lat", static_cast<double>(wp.coord.lat));
+        insertWpt.bindValue(":lon", static_cast<double>(wp.coord.lon));
+      }
+      insertWpt.bindValue(":type", static_cast<int>(wp.type));
+      insertWpt.bindValue(":desc", textToValue(wp.desc));
+      execWrite(insertWpt, "geocachewaypoints");
+    }
+
+    foreach(const LogMessage& log, geocache.logs) {
+      qlonglong authorId = authors.id(db, log.author);
+      QString hashKey = logHashKey(dateToValue(log.date), authorId, log.type,
+        log.msg.toString());
+      QString key = log.id.isEmpty() ? hashKey : log.id;
+      bindLog(updateLog, geocache.waypoint, log, key, authorId);
+      execWrite(updateLog, "logs");
+      if(updateLog.numRowsAffected() == 0) {
+        int adopted = 0;
+        if(key != hashKey) {
+          bindLog(adoptLog, geocache.waypoint, log, key, authorId);
+          adoptLog.bindValue(":hashkey", hashKey);
+          execWrite(adoptLog, "logs");
+          adopted = adoptLog.numRowsAffected();
+        }
+        if(adopted == 0) {
+          bindLog(insertLog, geocache.waypoint, log, key, authorId);
+          execWrite(insertLog, "logs");
+        }
+      }
+      if(log.images.isEmpty()) {
+        continue;
+      }
+
+      // only look up the id of logs that have images
+      selectLog.bindValue(":geocache", geocache.waypoint);
+      selectLog.bindValue(":logkey", key);
+      execWrite(selectLog, "logs");
+      if(!selectLog.next()) {
+        throw Failure("Saved log of " + geocache.waypoint + " not found");
+      }
+      qlonglong id = selectLog.value(0).toLongLong();
+      selectLog.finish();
+      foreach(const GeocacheImage& image, log.images) {
+        insertImage.bindValue(":filename", image.fileName);
+        insertImage.bindValue(":desc", image.desc);
+        execWrite(insertImage, "images");
+        insertLogImage.bindValue(":log", id);
+        insertLogImage.bindValue(":image", image.fileName);
+        execWrite(insertLogImage, "logimages");
+      }
+    }
+  }
+};
+
+/**
+ * Write geocaches to the database, replacing the ones with the same waypoint.
+ * All rows are written in a single transaction with statements that are
+ * prepared only once, so the cost of an import is dominated by the number of
+ * rows and not by the number of fsyncs.
+ * @param geocaches The geocaches to write
+ * @throws Failure if anything goes wrong. In this case, the transaction is
+ *  rolled back and no geocaches are saved.
+ */
+void GeocacheDatabase::save(const QVector<Geocache>& geocaches) {
+  QTime timer;
+  timer.start();
+
+  if(!db.transaction()) {
+    throw Failure("Could not begin transaction: " + db.lastError().text());
+  }
+
+  // prepare all statements once and reuse them for every geocache
+  QSqlQuery updateWp(db), insertWp(db), updateGc(db), insertGc(db);
+  DetailWriter details(db, authors);
+  SearchWriter search(db, ftsVersion != 0);
+  updateWp.prepare("UPDATE waypoints SET name = :name, lat = :lat, "
+    "lon = :lon, type = :type, desc = :desc WHERE waypoint = :waypoint");
+  insertWp.prepare("INSERT INTO waypoints (waypoint, name, lat, lon, type, "
+    "desc) VALUES (:waypoint, :name, :lat, :lon, :type, :desc)");
+  updateGc.prepare("UPDATE geocaches SET shortdesc = :shortdesc, "
+    "size = :size, terrain = :terrain, difficulty = :difficulty, "
+    "placed = :placed, found = :found, ownerid = :ownerid, attrs = :attrs, "
+    "hint = :hint, archived = :archived WHERE waypoint = :waypoint");
+  insertGc.prepare("INSERT INTO geocaches (waypoint, shortdesc, size, "
+    "terrain, difficulty, placed, found, ownerid, attrs, hint, archived) "
+    "VALUES (:waypoint, :shortdesc, :size, :terrain, :difficulty, :placed, "
+    ":found, :ownerid, :attrs, :hint, :archived)");
+
+  int rows = 0;
+  try {
+    foreach(const Geocache& geocache, geocaches) {
+      bindWaypoint(updateWp, geocache);
+      bindWaypoint(insertWp, geocache);
+      execUpsert(updateWp, insertWp, "waypoints");
+
+      qlonglong ownerId = owners.id(db, geocache.owner);
+      bindGeocache(updateGc, geocache, ownerId);
+      bindGeocache(insertGc, geocache, ownerId);
+      execUpsert(updateGc, insertGc, "geocaches");
+
+      details.write(geocache);
+      search.replace(geocache);
+      ++rows;
+    }
+    if(!q.exec("UPDATE metadata SET value = value + 1 "
+      "WHERE key = 'generation'")) {
+      throw Failure("Failed to update generation! " + q.lastError().text() +
+        "\nFailed query was: " + q.executedQuery());
+    }
+    if(!db.commit()) {
+      throw Failure("Could not commit transaction: " + db.lastError().text());
+    }
+  } catch(Failure&) {
+    db.rollback();
+    // names added in this transaction are gone again
+    owners.clear();
+    authors.clear();
+    throw;
+  }
+
+  int msecs = timer.elapsed();
+  qDebug() << "saved" << rows << "geocaches in" << msecs << "ms," <<
+    (msecs > 0 ? rows * 1000.0 / msecs : rows) << "rows/s";
+}
+
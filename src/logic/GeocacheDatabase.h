@@ -0,0 +1,192 @@
+/**
+ * @file GeocacheDatabase.h
+ * @date 16 Oct 2026
+ * @author Roland Hieber <rohieb@rohieb.name>
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2010 Roland Hieber
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEOCACHEDATABASE_H_
+#define GEOCACHEDATABASE_H_
+
+#include "logic/Geocache.h"
+#include "logic/AttributeIndex.h"
+#include "logic/GeocacheQuery.h"
+#include "logic/NameDictionary.h"
+#include <QtSql>
+
+namespace geojackal {
+
+/**
+ * Result of a full-text search
+ */
+struct SearchResult {
+  /** The geocache that matched */
+  GeocacheSummary summary;
+  /** Name of the geocache, like <em>Wayward Drive!</em> */
+  QString name;
+};
+
+/**
+ * When a geocache was last fetched from geocaching.com, and how its pages
+ * looked then. An import uses it to skip the geocaches that did not change.
+ */
+struct FetchRecord {
+  /** Waypoint of the geocache */
+  QString waypoint;
+  /** Time of the last fetch of the detail page */
+  QDateTime fetched;
+  /** Hash of the row of the geocache on the list page */
+  QByteArray listHash;
+  /** Hash of the data parsed from the detail page */
+  QByteArray hash;
+};
+
+/**
+ * Tuning of a database connection, see GeocacheDatabase::setTuning()
+ */
+struct DatabaseTuning {
+  /** Size of the page cache in KiB */
+  int cacheSize;
+  /** Size of the part of the database file that is memory-mapped, in MiB */
+  int mmapSize;
+  /**
+   * Number of pages in the write-ahead log after which a commit copies them
+   * back to the database, or @c 0 if the connection never does this
+   */
+  int checkpointPages;
+
+  DatabaseTuning() : cacheSize(8192), mmapSize(64), checkpointPages(0) {
+  }
+};
+
+/**
+ * Receives the progress of a schema upgrade in GeocacheDatabase::open()
+ */
+class UpgradeListener {
+public:
+  virtual ~UpgradeListener() {
+  }
+  /**
+   * Called when an upgrade step starts, and after every batch of rows
+   * @param version The schema version the step upgrades to
+   * @param done Number of rows of the step that are done
+   * @param total Number of rows of the step, @c 0 if not known
+   */
+  virtual void upgradeProgress(int version, int done, int total) = 0;
+};
+
+/**
+ * Connection to the SQLite database holding the geocaches. This class does
+ * all the SQL work, but no caching. Each instance has its own named
+ * connection, and must only be used from the thread that opened it.
+ */
+class GeocacheDatabase {
+public:
+  /** Time in ms to wait for a lock held by another connection */
+  static const int BUSY_TIMEOUT = 5000;
+  /** Size in bytes to which the write-ahead log is cut after a checkpoint */
+  static const int WAL_SIZE_LIMIT = 4 * 1024 * 1024;
+  /** Version of the schema that @a open() creates or upgrades to */
+  static const int SCHEMA_VERSION = 10;
+  /** Number of rows changed per transaction by long upgrade steps */
+  static const int UPGRADE_BATCH_SIZE = 1000;
+
+  GeocacheDatabase(const QString& connectionName);
+  virtual ~GeocacheDatabase();
+
+  bool open(const QString& fileName);
+  void close();
+  /** Set the tuning of the connection, used by the next @a open() */
+  inline void setTuning(const DatabaseTuning& tuning) {
+    this->tuning = tuning;
+  }
+  void checkpoint();
+  /** Set the listener for the progress of schema upgrades, or @c 0 */
+  inline void setUpgradeListener(UpgradeListener * listener) {
+    this->listener = listener;
+  }
+  void save(const QVector<Geocache>& geocaches);
+  quint64 generation();
+  void writeSnapshot(const QString& fileName);
+
+  Geocache * geocache(const QString& waypoint);
+  QVector<LogMessage> logs(const QString& waypoint, int limit, int offset = 0);
+  int logCount(const QString& waypoint);
+  void loadAttributes(AttributeIndex& index);
+  QHash<QString, FetchRecord> fetchRecords(const QStringList& waypoints);
+  void saveFetchRecords(const QVector<FetchRecord>& records);
+  QVector<GeocacheSummary> summaries(QStringList& names, const QString& after,
+    int limit);
+  QVector<GeocacheSummary> geocachesInRect(const Coordinate& sw,
+    const Coordinate& ne);
+  QVector<GeocacheSummary> geocachesInRadius(const Coordinate& center,
+    qreal radius);
+  void execSummaryQuery(QSqlQuery& query, const Coordinate& sw,
+    const Coordinate& ne);
+  static GeocacheSummary summaryFromQuery(const QSqlQuery& query);
+  QVector<GeocacheSummary> query(const GeocacheQuery& query,
+    QVector<QVariant> * sortKeys = 0);
+  QVector<SearchResult> search(const QString& text, int limit,
+    int offset = 0);
+
+  /** @return the underlying connection, for queries on this thread */
+  inline QSqlDatabase& database() {
+    return db;
+  }
+
+protected:
+  void tune();
+  int schemaVersion();
+  void upgrade(int from);
+  void upgradeProgress(int version, int done, int total);
+  void detectModules();
+  void createTables();
+  void createDetailTables();
+  void createSpatialIndex();
+  void createSearchIndex();
+  void createQueryIndices();
+  void createMetadata();
+  void compressTexts(int version);
+  void createFetchTable();
+  void createLogKeys(int version);
+  void internNames();
+  void execAreaQuery(QSqlQuery& query, const QString& columns,
+    const Coordinate& sw, const Coordinate& ne);
+  Geocache * geocacheFromQuery(const QSqlQuery& query);
+
+private:
+  QString connectionName;
+  QSqlDatabase db;
+  QSqlQuery q;
+  DatabaseTuning tuning;
+  UpgradeListener * listener;
+  /** Whether the spatial index uses the SQLite R*Tree module */
+  bool hasRtree;
+  /** Version of the full-text module of the search index, @c 0 if none */
+  int ftsVersion;
+  /** Owners of the geocaches */
+  NameDictionary owners;
+  /** Authors of the logs */
+  NameDictionary authors;
+};
+
+}
+
+Q_DECLARE_TYPEINFO(geojackal::SearchResult, Q_MOVABLE_TYPE);
+
+#endif /* GEOCACHEDATABASE_H_ */
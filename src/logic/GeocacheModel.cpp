@@ -19,360 +19,750 @@
  */
 
 #include "logic/GeocacheModel.h"
-#include <QDateTime>
 #include <QStringList>
+#include <QTime>
+#include <QtAlgorithms>
 
 using namespace geojackal;
 
 /**
- * Convert list of attributes to string.
- * @param attrs List of attributes
- * @return A string which contains a @c 0 or a @c 1 for each GeocacheAttribute,
- *  ordered ascending.
+ * Constructor. Starts the database thread, but does not open the database
+ * yet, see @a open().
  */
-QString geojackal::attrsToString(const QVector<GeocacheAttribute>& attrs) {
-  QString field(NUM_ATTRIBUTES, QChar('0'));
-  foreach(GeocacheAttribute attr, attrs) {
-    field[static_cast<int>(attr)] = QChar('1');
+GeocacheModel::GeocacheModel(QObject * parent) : QAbstractListModel(parent),
+  database(QString("geocaches-%1").arg(quintptr(this))), worker(0),
+  ready(false), nextRequest(0), attributeIndexLoaded(false),
+  allFetched(false) {
+  recentList.setMaxCost(g_settings->geocacheCacheSize());
+
+  qRegisterMetaType<Coordinate>("geojackal::Coordinate");
+  qRegisterMetaType<QVector<Geocache> >("QVector<geojackal::Geocache>");
+  qRegisterMetaType<QVector<GeocacheSummary> >(
+    "QVector<geojackal::GeocacheSummary>");
+  qRegisterMetaType<QVector<FetchRecord> >("QVector<geojackal::FetchRecord>");
+
+  // the connection of the GUI thread only reads, so it never checkpoints
+  DatabaseTuning tuning;
+  tuning.cacheSize = g_settings->databaseCacheSize();
+  tuning.mmapSize = g_settings->databaseMmapSize();
+  database.setTuning(tuning);
+  tuning.checkpointPages = g_settings->checkpointPages();
+  worker = new DatabaseWorker(QString("geocaches-worker-%1").
+    arg(quintptr(this)), tuning);
+  worker->moveToThread(&workerThread);
+
+  // calls to the worker are queued to the database thread...
+  connect(this, SIGNAL(workerOpen(const QString&)), worker,
+    SLOT(open(const QString&)));
+  connect(this, SIGNAL(workerQueryRect(int, const geojackal::Coordinate&,
+    const geojackal::Coordinate&, const geojackal::Coordinate&)), worker,
+    SLOT(queryRect(int, const geojackal::Coordinate&,
+    const geojackal::Coordinate&, const geojackal::Coordinate&)));
+  connect(this, SIGNAL(workerSave(const QVector<geojackal::Geocache>&)),
+    worker, SLOT(save(const QVector<geojackal::Geocache>&)));
+  connect(this, SIGNAL(workerWriteSnapshot(const QString&)), worker,
+    SLOT(writeSnapshot(const QString&)));
+  connect(this, SIGNAL(workerSaveFetchRecords(
+    const QVector<geojackal::FetchRecord>&)), worker, SLOT(saveFetchRecords(
+    const QVector<geojackal::FetchRecord>&)));
+
+  // ...and its results are queued back to us
+  connect(worker, SIGNAL(opened(bool, const QString&)),
+    SLOT(workerOpened(bool, const QString&)));
+  connect(worker, SIGNAL(geocachesLoaded(int,
+    const QVector<geojackal::GeocacheSummary>&)), SIGNAL(geocachesLoaded(int,
+    const QVector<geojackal::GeocacheSummary>&)));
+  connect(worker, SIGNAL(queryFinished(int)), SIGNAL(requestFinished(int)));
+  connect(worker, SIGNAL(saved(const QStringList&)),
+    SLOT(workerSaved(const QStringList&)));
+  connect(worker, SIGNAL(saveFailed(const QStringList&, const QString&)),
+    SLOT(workerSaveFailed(const QStringList&, const QString&)));
+  connect(worker, SIGNAL(failed(const QString&)),
+    SIGNAL(failed(const QString&)));
+  connect(worker, SIGNAL(upgrading(int, int, int)),
+    SIGNAL(upgrading(int, int, int)));
+  connect(worker, SIGNAL(snapshotWritten(const QString&)),
+    SLOT(workerSnapshotWritten(const QString&)));
+
+  // results from the snapshot are delivered later, like those of the worker
+  connect(this, SIGNAL(snapshotLoaded(int,
+    const QVector<geojackal::GeocacheSummary>&)), SIGNAL(geocachesLoaded(int,
+    const QVector<geojackal::GeocacheSummary>&)), Qt::QueuedConnection);
+  connect(this, SIGNAL(snapshotFinished(int)), SIGNAL(requestFinished(int)),
+    Qt::QueuedConnection);
+
+  workerThread.start();
+}
+
+GeocacheModel::~GeocacheModel() {
+  // slots are called in order, so this waits until all queued writes are done
+  if(ready && !snapshot.isOpen() && g_settings->useSnapshot()) {
+    QMetaObject::invokeMethod(worker, "writeSnapshot",
+      Qt::BlockingQueuedConnection, Q_ARG(QString, snapshotFileName()));
+  }
+  // close our connection first, so the worker can checkpoint the whole log
+  database.close();
+  QMetaObject::invokeMethod(worker, "close", Qt::BlockingQueuedConnection);
+  workerThread.quit();
+  workerThread.wait();
+  delete worker;
+
+  // clean up unsaved geocaches, recentList cleans up itself
+  foreach(Geocache * pgc, geocacheList) {
+    delete pgc;
+  }
+  foreach(Geocache * pgc, savingList) {
+    delete pgc;
   }
-  return field;
 }
 
 /**
- * Convert a string created by attrsToString() to list of attributes
- * @param str A string which contains a @c 0 or a @c 1 for each
- *  GeocacheAttribute, ordered ascending.
- * @return A list of GeoacheAttributes that are set in @a str, or empty list if
- *  the string was not of size @c NUM_ATTRIBUTES.
+ * Open the database in the database thread, and create the tables if needed.
+ * No geocaches are loaded yet, use the query functions to get them. Emits
+ * @a opened() when done. The model is reset then, and views read the rows
+ * with @a fetchMore().
+ * @param fileName File name of the SQLite Database
  */
-QVector<GeocacheAttribute> geojackal::stringToAttrs(const QString str) {
-  if(str.size() != NUM_ATTRIBUTES) {
-    return QVector<GeocacheAttribute>(); // invalid string
-  }
-  QVector<GeocacheAttribute> ret;
-  for(ushort i = 0; i < NUM_ATTRIBUTES; ++i) {
-    if(str.at(i) == QChar('1')) {
-      ret.append(static_cast<GeocacheAttribute>(i));
+void GeocacheModel::open(const QString& fileName) {
+  ready = false;
+  attributeIndexLoaded = false;
+  attributeIndex.clear();
+  database.close();
+  beginResetModel();
+  rows.clear();
+  rowNames.clear();
+  rowIndex.clear();
+  fetchList.clear();
+  fetchedUpTo.clear();
+  allFetched = false;
+  endResetModel();
+  this->fileName = fileName;
+  snapshot.close();
+  if(g_settings->useSnapshot()) {
+    QTime timer;
+    timer.start();
+    if(snapshot.open(snapshotFileName())) {
+      qDebug() << "mapped snapshot of" << snapshot.size() << "geocaches in" <<
+        timer.elapsed() << "ms";
     }
   }
-  return ret;
+  emit workerOpen(fileName);
+}
+
+/**
+ * @internal
+ * @return the file name of the snapshot of the database
+ */
+QString GeocacheModel::snapshotFileName() const {
+  return fileName + ".summaries";
 }
 
 /**
- * Test whether a value in a database table already exists in a column. A
- * QSqlDatabase connection must be open for this function to work.
- * @param table The database table
- * @param column The column in @a table
- * @param value The value to look for in @a column
- * @return @c true if there is a row in @a column containing @a value or @c
- *  false otherwise
- */
-bool geojackal::sqlValueExists(const QString table, const QString column,
-  const QString value) {
-  QSqlQuery qe;
-  qe.prepare(QString("SELECT * FROM %1 WHERE %2 = :value").arg(table).
-    arg(column));
-  qe.bindValue(":value", value);
-  qe.exec();
-  if(qe.next()) {
-    return true;
+ * @internal
+ * Called when the worker has opened the database. The tables exist now, so
+ * the connection of the GUI thread can be opened quickly. The model is reset,
+ * so views ask for rows with @a fetchMore().
+ */
+void GeocacheModel::workerOpened(bool ok, const QString& message) {
+  if(ok) {
+    try {
+      ready = database.open(fileName);
+      // the snapshot was used until now, check that it was current
+      if(ready && g_settings->useSnapshot() && (!snapshot.isOpen() ||
+        snapshot.generation() != database.generation())) {
+        snapshot.close();
+        emit workerWriteSnapshot(snapshotFileName());
+      }
+      if(ready) {
+        beginResetModel();
+        endResetModel();
+      }
+    } catch(Failure& f) {
+      emit failed(f.what());
+    }
   } else {
-    return false;
+    emit failed(message);
   }
+  emit opened(ready);
 }
 
 /**
- * Constructor
+ * Save all new and changed geocaches to the database. Only geocaches that were
+ * added or marked with @a setDirty() since the last call are written, so the
+ * cost depends on the size of the change and not on the size of the database.
+ * The geocaches are written in one transaction by the database thread, and
+ * @a saved() or @a failed() is emitted when done. Until then, they stay in
+ * memory.
  */
-GeocacheModel::GeocacheModel(QObject * parent) {
-}
+void GeocacheModel::save() {
+  if(geocacheList.isEmpty()) {
+    return;
+  }
 
-GeocacheModel::~GeocacheModel() {
-  // clean up geocache list
-  foreach(Geocache * pgc, geocacheList) {
-    delete pgc;
+  // the worker gets copies, which share their data with ours
+  QVector<Geocache> geocaches;
+  geocaches.reserve(geocacheList.size());
+  QHash<QString, Geocache *>::iterator it = geocacheList.begin();
+  for(; it != geocacheList.end(); ++it) {
+    geocaches.append(*it.value());
+    delete savingList.take(it.key()); // an older version is still being saved
+    savingList.insert(it.key(), it.value());
   }
+  geocacheList.clear();
+  emit workerSave(geocaches);
 }
 
 /**
- * Connect to the database and load the geocaches
- * @param fileName File name of the SQLite Database
- * @throws Failure if anything goes wrong
- * @return @c true if all geocaches could be loaded, @c false otherwise
- */
-bool GeocacheModel::open(const QString& fileName) {
-  qDebug() << "connecting to database" << fileName;
-
-  // create data folder if if does not eist
-  QDir dir = QDir(fileName + "/.."); // trim file name
-  dir.makeAbsolute();
-  qDebug() << "dir" << dir.absolutePath();
-  if(!dir.exists()) {
-    if(!dir.mkpath(dir.absolutePath())) {
-      qDebug() << "Failure: Could not mkdir" << dir.absolutePath();
-      return false;
+ * @internal
+ * Called when the worker has saved geocaches. They are on disk now, so they
+ * may leave memory again. Logs are read page by page with @a logs(), so they
+ * are not kept around. Only the rows of the saved geocaches are updated.
+ * The fetch records of the saved geocaches are written after them, unless
+ * the geocache was changed again in the meantime.
+ */
+void GeocacheModel::workerSaved(const QStringList& waypoints) {
+  snapshot.close(); // stale now, it is written again on exit
+  QVector<GeocacheSummary> summaries;
+  QStringList geocacheNames;
+  QVector<FetchRecord> records;
+  foreach(QString waypoint, waypoints) {
+    if(!geocacheList.contains(waypoint) && fetchList.contains(waypoint)) {
+      records.append(fetchList.take(waypoint));
+    }
+    Geocache * geocache = savingList.take(waypoint);
+    if(geocache) {
+      if(attributeIndexLoaded) {
+        attributeIndex.set(waypoint, geocache->attrs);
+      }
+      summaries.append(GeocacheSummary::fromGeocache(*geocache));
+      geocacheNames << geocache->name;
+      geocache->logs.clear();
+      recentList.insert(waypoint, geocache);
     }
   }
+  updateRows(summaries, geocacheNames);
+  if(!records.isEmpty()) {
+    emit workerSaveFetchRecords(records);
+  }
+  emit saved();
+}
 
-  // open sqlite database
-  db = QSqlDatabase::addDatabase("QSQLITE");
-  db.setDatabaseName(fileName);
-  if(!db.open()) {
-    qDebug() << "Failure: " << db.lastError();
-    return false;
+/**
+ * @internal
+ * Update the rows of saved geocaches. Rows of known geocaches are changed in
+ * place, and the new ones are appended in one block, so the signals of the
+ * item model are proportional to the number of saved geocaches.
+ * @param summaries Summaries of the saved geocaches
+ * @param names Names of the saved geocaches, in the same order
+ */
+void GeocacheModel::updateRows(const QVector<GeocacheSummary>& summaries,
+  const QStringList& names) {
+  QVector<int> added;
+  for(int i = 0; i < summaries.size(); ++i) {
+    int row = rowOf(summaries[i].waypointString());
+    if(row < 0) {
+      added.append(i);
+    } else {
+      rows[row] = summaries[i];
+      rowNames[row] = names[i];
+      emit dataChanged(index(row), index(row));
+    }
   }
+  appendRows(summaries, names, added);
+}
 
-  q = QSqlQuery(db);
+/**
+ * @internal
+ * Append rows in one block
+ * @param summaries Summaries of geocaches
+ * @param names Names of the geocaches, in the same order
+ * @param which Indices of the geocaches in @a summaries that get a row
+ */
+void GeocacheModel::appendRows(const QVector<GeocacheSummary>& summaries,
+  const QStringList& names, const QVector<int>& which) {
+  if(which.isEmpty()) {
+    return;
+  }
+  int first = rows.size();
+  beginInsertRows(QModelIndex(), first, first + which.size() - 1);
+  foreach(int i, which) {
+    rowIndex.insert(summaries[i].waypointString(), rows.size());
+    rows.append(summaries[i]);
+    rowNames << names[i];
+  }
+  endInsertRows();
+}
 
-  // if our tables do not exist yet, create them
-  QStringList tableList = db.tables(QSql::Tables);
+/**
+ * from QAbstractItemModel: @return @c true if there are saved geocaches that
+ * @a fetchMore() has not read yet
+ */
+bool GeocacheModel::canFetchMore(const QModelIndex& parent) const {
+  return !parent.isValid() && ready && !allFetched;
+}
 
-  if(!tableList.contains("waypoints")) {
-    if(!q.exec("CREATE TABLE waypoints("
-      "waypoint TEXT PRIMARY KEY,"
-      "name TEXT NOT NULL,"
-      "lat REAL NOT NULL,"
-      "lon REAL NOT NULL,"
-      "type INTEGER NOT NULL,"
-      "desc TEXT"
-      ");")) {
-      throw Failure("Failed to create table 'waypoints'! "
-        + q.lastError().text() + "\nFailed query was: " + q.executedQuery());
-      return false;
+/**
+ * from QAbstractItemModel: read the next @a FETCH_SIZE geocaches, ordered by
+ * waypoint, and append rows for them. Geocaches that got a row when they were
+ * saved are skipped.
+ */
+void GeocacheModel::fetchMore(const QModelIndex& parent) {
+  QVector<int> added;
+  while(added.isEmpty() && canFetchMore(parent)) {
+    QStringList names;
+    QVector<GeocacheSummary> summaries;
+    try {
+      summaries = database.summaries(names, fetchedUpTo, FETCH_SIZE);
+    } catch(Failure& f) {
+      allFetched = true; // do not fail again on every scroll
+      emit failed(f.what());
+      return;
     }
+    allFetched = summaries.size() < FETCH_SIZE;
+    if(!summaries.isEmpty()) {
+      fetchedUpTo = summaries.last().waypointString();
+    }
+    for(int i = 0; i < summaries.size(); ++i) {
+      if(!rowIndex.contains(summaries[i].waypointString())) {
+        added.append(i);
+      }
+    }
+    appendRows(summaries, names, added);
   }
-  if(!tableList.contains("geocaches")) {
-    if(!q.exec("CREATE TABLE geocaches("
-      "waypoint TEXT PRIMARY KEY "
-      "  REFERENCES waypoints(oid) ON DELETE CASCADE ON UPDATE CASCADE,"
-      "shortdesc TEXT,"
-      "size INT NOT NULL,"
-      "terrain INTEGER NOT NULL,"
-      "difficulty INTEGER NOT NULL,"
-      "placed INTEGER NOT NULL,"
-      "found INTEGER NOT NULL,"
-      "owner TEXT NOT NULL,"
-      "attrs BLOB NOT NULL,"
-      "hint TEXT,"
-      "archived INTEGER DEFAULT 0,"
-      "vote INT DEFAULT 0"
-      ");")) {
-      throw Failure("Failed to create table 'geocaches'! " + q.lastError().
-        text() + "\nFailed query was: " + q.executedQuery());
-      return false;
+}
+
+/**
+ * Get the model index of a geocache
+ * @param waypoint Waypoint of the geocache
+ * @return the index, or an invalid index if the geocache has no row yet
+ */
+QModelIndex GeocacheModel::indexOf(const QString& waypoint) const {
+  int row = rowOf(waypoint);
+  return row < 0 ? QModelIndex() : index(row);
+}
+
+/**
+ * @internal
+ * Called when the worker could not save geocaches, even one by one. They are
+ * dropped, so they do not fail every later save again, and their fetch
+ * records with them, so the next import fetches them again.
+ */
+void GeocacheModel::workerSaveFailed(const QStringList& waypoints,
+  const QString& message) {
+  foreach(QString waypoint, waypoints) {
+    delete savingList.take(waypoint);
+    if(!geocacheList.contains(waypoint)) {
+      fetchList.remove(waypoint); // not changed again in the meantime
     }
   }
+  qDebug() << "could not save" << waypoints;
+  emit saveFailed(message);
+}
 
-  // not needed yet and still fails
-//  if(!tableList.contains("geocachewaypoints")) {
-//    if(!q.exec("CREATE TABLE geocachewaypoints("
-//      "waypoint TEXT PRIMARY KEY "
-//      "  REFERENCES waypoints ON DELETE CASCADE ON UPDATE CASCADE,"
-//      "geocache TEXT PRIMARY KEY "
-//      "  REFERENCES geocaches(waypoint) ON DELETE CASCADE ON UPDATE CASCADE"
-//      ");")) {
-//      throw Failure("Failed to create table 'geocachewaypoints'! "
-//        + q.lastError().text() + "\nFailed query was: " + q.executedQuery());
-//      return false;
-//    }
-//  }
-//  if(!tableList.contains("logs")) {
-//    if(!q.exec("CREATE TABLE logs("
-//      "geocache TEXT "
-//      "  REFERENCES geocaches(oid) ON DELETE CASCADE ON UPDATE CASCADE,"
-//      "author TEXT NOT NULL,"
-//      "type INTEGER NOT NULL,"
-//      "msg TEXT NOT NULL,"
-//      "encrypted INTEGER NOT NULL DEFAULT 0"
-//      ");")) {
-//      throw Failure("Failed to create table 'logs'! " +
-//        q.lastError().text() + "\nFailed query was: " + q.executedQuery());
-//      return false;
-//    }
-//  }
-//  if(!tableList.contains("images")) {
-//    if(!q.exec("CREATE TABLE images("
-//      "filename TEXT PRIMARY KEY,"
-//      "desc TEXT"
-//      ");")) {
-//      throw Failure("Failed to create table 'images'! " +
-//        q.lastError().text() + "\nFailed query was: " + q.executedQuery());
-//      return false;
-//    }
-//  }
-//  if(!tableList.contains("geocacheimages")) {
-//    if(!q.exec("CREATE TABLE geocacheimages("
-//      "geocache INTEGER "
-//      "  REFERENCES geocaches(oid) ON DELETE CASCADE ON UPDATE CASCADE,"
-//      "image TEXT "
-//      "  REFERENCES images(oid) ON DELETE CASCADE ON UPDATE CASCADE"
-//      ");")) {
-//      throw Failure("Failed to create table 'geocacheimages'! "
-//        + q.lastError().text() + "\nFailed query was: " + q.executedQuery());
-//      return false;
-//    }
-//  }
-//  if(!tableList.contains("logimages;")) {
-//    if(!q.exec("CREATE TABLE logimages("
-//      "log INTEGER "
-//      "  REFERENCES logs(oid) ON DELETE CASCADE ON UPDATE CASCADE,"
-//      "image TEXT "
-//      "  REFERENCES images(oid) ON DELETE CASCADE ON UPDATE CASCADE"
-//      ");")) {
-//      throw Failure("Failed to create table 'logimages'! "
-//        + q.lastError().text() + "\nFailed query was: " + q.executedQuery());
-//      return false;
-//    }
-//  }
-
-  // load geocaches
-  q.exec("SELECT w.waypoint,w.name,w.lat,w.lon,w.type,w.desc,c.shortdesc,"
-    "c.size,c.terrain,c.difficulty,c.placed,c.found,c.owner,c.attrs,c.hint,"
-    "c.archived FROM waypoints w JOIN geocaches c ON w.waypoint = c.waypoint");
-  while(q.next()) {
-    Geocache * geocache = new Geocache;
-    bool ok;
-    geocache->waypoint = q.value(0).toString();
-    geocache->name = q.value(1).toString();
-    geocache->coord = new Coordinate(q.value(2).toDouble(&ok),
-      q.value(3).toDouble(&ok));
-    geocache->type = static_cast<WaypointType>(q.value(4).toInt(&ok));
-    geocache->desc = q.value(5).toString();
-    geocache->shortDesc = q.value(6).toString();
-    geocache->size = static_cast<GeocacheSize>(q.value(7).toInt(&ok));
-    geocache->terrain = q.value(8).toInt(&ok);
-    geocache->difficulty = q.value(9).toInt(&ok);
-    geocache->placed = new QDate(QDateTime::fromTime_t(q.value(10).toInt(&ok)).
-      date());
-    geocache->found = new QDate(QDateTime::fromTime_t(q.value(11).toInt(&ok)).
-      date());
-    geocache->owner = q.value(12).toString();
-    geocache->attrs = new QVector<GeocacheAttribute>(
-      stringToAttrs(q.value(13).toString()));
-    geocache->hint = q.value(13).toString();
-    geocache->archived = q.value(14).toBool();
-
-    qDebug() << "loaded" << geocache->waypoint << "from database";
-    geocacheList[geocache->waypoint] = geocache;
-  }
-  return true;
-}
-
-/**
- * Save all changed, updated and removed geocaches to the database.
- * @return @c true if the process was successful, @c false otherwise. In the
- *  latter case, some geocaches may be saved, some not.
- */
-bool GeocacheModel::save() {
-  bool success = true;
-
-  foreach(QString wp, geocacheList.keys()) {
-    Geocache * geocache = geocacheList.value(wp);
-
-    // table 'waypoints'
-    bool alreadyExists = sqlValueExists("waypoints", "waypoint", wp);
-    if(alreadyExists) {
-      qDebug() << "updating" << wp;
-      q.prepare("UPDATE waypoints SET name = :name, lat = :lat, lon = :lon, "
-        "type = :type, desc = :desc WHERE waypoint = :waypoint");
-    } else {
-      qDebug() << "inserting" << wp;
-      q.prepare("INSERT INTO waypoints (waypoint, name, lat, lon, type, desc) "
-        "VALUES (:waypoint, :name, :lat, :lon, :type, :desc);");
+/**
+ * @internal
+ * Called when the worker has written the snapshot. It is only mapped if it
+ * is still current.
+ */
+void GeocacheModel::workerSnapshotWritten(const QString& fileName) {
+  if(!ready || fileName != snapshotFileName() || snapshot.isOpen()) {
+    return;
+  }
+  try {
+    if(snapshot.open(fileName) &&
+      snapshot.generation() != database.generation()) {
+      snapshot.close(); // saved again in the meantime
     }
-    q.bindValue(":name", geocache->name);
-    q.bindValue(":lat", static_cast<double>(geocache->coord->lat));
-    q.bindValue(":lon", static_cast<double>(geocache->coord->lon));
-    q.bindValue(":type", static_cast<int>(geocache->type));
-    q.bindValue(":desc", geocache->desc);
-    q.bindValue(":waypoint", geocache->waypoint);
-    if(!(success = q.exec())) {
-      throw Failure("Error while trying to save to SQL table 'waypoints': " +
-        q.lastError().text() + "\nFailed query was: " + q.executedQuery());
+  } catch(Failure& f) {
+    snapshot.close();
+    emit failed(f.what());
+  }
+}
+
+/**
+ * Request the summaries of all geocaches inside a rectangular area. The query
+ * runs in the database thread, and the results are delivered in batches by
+ * @a geocachesLoaded(), followed by @a requestFinished(). The geocaches
+ * nearest to @a center come first, so the caller can draw them while the rest
+ * is still loading. A new request cancels the older ones that are not done
+ * yet; they only get their @a requestFinished(). See
+ * @a GeocacheDatabase::geocachesInRect() for the constraints on the area.
+ * If the snapshot is current, it answers the request instead of the database
+ * thread, still by queued signals.
+ * @param sw South-western corner of the area
+ * @param ne North-eastern corner of the area
+ * @param center Coordinate of most interest, by default the center of the
+ *  area
+ * @return Identifier of the request, passed on to the signals
+ */
+int GeocacheModel::requestGeocachesInRect(const Coordinate& sw,
+  const Coordinate& ne, const Coordinate& center) {
+  int request = ++nextRequest;
+  worker->cancelBefore(request);
+  if(snapshotUsable()) {
+    Coordinate c = center;
+    if(c.lat < sw.lat || c.lat > ne.lat || c.lon < sw.lon || c.lon > ne.lon) {
+      c = Coordinate((sw.lat + ne.lat) / 2, (sw.lon + ne.lon) / 2);
     }
-    q.finish();
-
-    // table 'geocaches'
-    if(alreadyExists) {
-      q.prepare("UPDATE geocaches SET shortdesc = :shortdesc, size = :size, "
-        "terrain = :terrain, difficulty = :difficulty, placed = :placed, "
-        "found = :found, owner = :owner, attrs = :attrs, hint = :hint, "
-        "archived = :archived WHERE waypoint = :waypoint");
-    } else {
-      q.prepare("INSERT INTO geocaches (waypoint, shortdesc, size, terrain, "
-        "difficulty, placed, found, owner, attrs, hint, archived) "
-        "VALUES(:waypoint, :shortdesc, :size, :terrain, :difficulty, :placed, "
-        ":found, :owner, :attrs, :hint, :archived);");
+    emit snapshotLoaded(request, snapshot.geocachesInRect(sw, ne, c));
+    emit snapshotFinished(request);
+  } else {
+    emit workerQueryRect(request, sw, ne, center);
+  }
+  return request;
+}
+
+/**
+ * @internal
+ * A result of GeocacheModel::geocaches() with its sort key
+ */
+struct QueryResult {
+  QVariant key;
+  GeocacheSummary summary;
+};
+
+/**
+ * @internal
+ * Orders query results like the query does
+ */
+class QueryResultLess {
+public:
+  QueryResultLess(const GeocacheQuery& query) : query_(query) {}
+  bool operator()(const QueryResult& a, const QueryResult& b) const {
+    return query_.lessThan(a.key, a.summary.waypointString(), b.key,
+      b.summary.waypointString());
+  }
+private:
+  const GeocacheQuery& query_;
+};
+
+/**
+ * Get the geocaches that match a query, like all unfound traditional caches
+ * in an area with terrain up to 2 that allow dogs, nearest first. The saved
+ * geocaches are filtered and sorted by SQLite on the indices of the columns.
+ * Geocaches with unsaved changes are already in memory, so they are tested
+ * with GeocacheQuery::matches() and merged into the results.
+ * @param query The filter, sort order and page
+ * @return Summaries of the matching geocaches, in the requested order
+ * @throws Failure if anything goes wrong
+ */
+QVector<GeocacheSummary> GeocacheModel::geocaches(const GeocacheQuery& query) {
+  // geocaches in memory take precedence over their saved version
+  QHash<QString, Geocache *> resident = savingList;
+  for(QHash<QString, Geocache *>::const_iterator it = geocacheList.
+    constBegin(); it != geocacheList.constEnd(); ++it) {
+    resident.insert(it.key(), it.value());
+  }
+  if(resident.isEmpty()) {
+    return ready ? database.query(query) : QVector<GeocacheSummary>();
+  }
+
+  // read enough saved rows to fill the page after merging
+  QVector<QueryResult> results;
+  if(ready) {
+    GeocacheQuery saved(query);
+    saved.setLimit(query.limit() < 0 ? -1 : query.offset() + query.limit() +
+      resident.size());
+    QVector<QVariant> keys;
+    QVector<GeocacheSummary> summaries = database.query(saved, &keys);
+    for(int i = 0; i < summaries.size(); ++i) {
+      if(!resident.contains(summaries[i].waypointString())) {
+        QueryResult result;
+        result.key = keys[i];
+        result.summary = summaries[i];
+        results.append(result);
+      }
     }
-    q.bindValue(":waypoint", geocache->waypoint);
-    q.bindValue(":shortdesc", geocache->shortDesc);
-    q.bindValue(":size", geocache->size);
-    q.bindValue(":terrain", geocache->terrain);
-    q.bindValue(":difficulty", geocache->difficulty);
-    q.bindValue(":placed", QDateTime(*geocache->placed).toUTC().toTime_t());
-    q.bindValue(":found", QDateTime(*geocache->found).toUTC().toTime_t());
-    q.bindValue(":owner", geocache->owner);
-    q.bindValue(":attrs", attrsToString(*geocache->attrs));
-    q.bindValue(":hint", geocache->hint);
-    q.bindValue(":archived", geocache->archived);
-    if(!(success = q.exec())) {
-      throw Failure("Error while trying to save to SQL table 'geocaches': " +
-        q.lastError().text() + "\nFailed query was: " + q.executedQuery());
+  }
+  foreach(const Geocache * geocache, resident) {
+    if(query.matches(*geocache)) {
+      QueryResult result;
+      result.key = query.sortKey(*geocache);
+      result.summary = GeocacheSummary::fromGeocache(*geocache);
+      results.append(result);
     }
   }
+  if(query.sortOrder() != GeocacheQuery::SORT_NONE) {
+    qStableSort(results.begin(), results.end(), QueryResultLess(query));
+  }
+
+  QVector<GeocacheSummary> ret;
+  int end = results.size();
+  if(query.limit() >= 0) {
+    end = qMin(end, query.offset() + query.limit());
+  }
+  for(int i = query.offset(); i < end; ++i) {
+    ret.append(results[i].summary);
+  }
+  return ret;
+}
+
+/**
+ * Get all geocaches inside a rectangular area synchronously, see
+ * @a GeocacheDatabase::geocachesInRect(). Prefer
+ * @a requestGeocachesInRect() for large areas.
+ * @return Summaries of the geocaches in the area, or an empty vector if the
+ *  database is not open yet
+ * @throws Failure if anything goes wrong
+ */
+QVector<GeocacheSummary> GeocacheModel::geocachesInRect(const Coordinate& sw,
+  const Coordinate& ne) {
+  if(snapshotUsable()) {
+    return snapshot.geocachesInRect(sw, ne);
+  }
+  return ready ? database.geocachesInRect(sw, ne) : QVector<GeocacheSummary>();
+}
+
+/**
+ * Get all geocaches inside a circular area synchronously, see
+ * @a GeocacheDatabase::geocachesInRadius().
+ * @return Summaries of the geocaches in the area ordered by distance, or an
+ *  empty vector if the database is not open yet
+ * @throws Failure if anything goes wrong
+ */
+QVector<GeocacheSummary> GeocacheModel::geocachesInRadius(
+  const Coordinate& center, qreal radius) {
+  return ready ? database.geocachesInRadius(center, radius) :
+    QVector<GeocacheSummary>();
+}
+
+/**
+ * Get the full details of a single geocache. The details are read from the
+ * database on demand and kept in a cache of limited size. Logs are not
+ * included, use @a logs() to read them.
+ * @param waypoint Waypoint of the geocache
+ * @return The geocache, or @c 0 if there is no geocache with this waypoint.
+ *  The geocache is owned by the model and stays valid at least until the next
+ *  call to this function or to @a save().
+ * @throws Failure if anything goes wrong
+ */
+Geocache * GeocacheModel::geocache(const QString& waypoint) {
+  Geocache * geocache = geocacheList.value(waypoint, 0);
+  if(!geocache) {
+    geocache = savingList.value(waypoint, 0);
+  }
+  if(geocache) {
+    return geocache; // has unsaved changes
+  }
+  geocache = recentList.object(waypoint);
+  if(geocache || !ready) {
+    return geocache;
+  }
+
+  geocache = database.geocache(waypoint);
+  if(geocache && !recentList.insert(waypoint, geocache)) {
+    return 0; // deleted by the cache, which cannot hold it
+  }
+  return geocache;
+}
+
+/**
+ * Get the log messages of a geocache, newest first, see
+ * @a GeocacheDatabase::logs()
+ * @throws Failure if anything goes wrong
+ */
+QVector<LogMessage> GeocacheModel::logs(const QString& waypoint, int limit,
+  int offset) {
+  return ready ? database.logs(waypoint, limit, offset) :
+    QVector<LogMessage>();
+}
 
-  return success;
+/**
+ * Get the number of log messages of a geocache
+ * @throws Failure if anything goes wrong
+ */
+int GeocacheModel::logCount(const QString& waypoint) {
+  return ready ? database.logCount(waypoint) : 0;
 }
 
-///** from QAbstractItemModel: get number of elements in the model */
-//int GeocacheModel::rowCount(const QModelIndex &parent) const {
-//  return geocacheList.size();
-//}
-//
-///** from QAbstractItemModel: get data in the model */
-//QVariant GeocacheModel::data(const QModelIndex &index, int role) const {
-//  if(!index.isValid()) {
-//    return QVariant();
-//  }
-//  if(index.row() >= geocacheList.size()) {
-//    return QVariant();
-//  }
-//
-//  if(role == Qt::DisplayRole) {
-//    return geocacheList.at(index.row());
-//  } else {
-//    return QVariant();
-//  }
-//}
+/**
+ * Get all saved geocaches that match an attribute filter, like "kids-friendly
+ * AND dogs allowed AND NOT night-only". The filter runs on an in-memory bitmap
+ * index, which is read from the database on first use and updated on every
+ * save.
+ * @param required Attributes that a geocache must all have
+ * @param excluded Attributes that a geocache must not have
+ * @param anyOf If not empty, a geocache must have at least one of these
+ * @return The waypoints of the matching geocaches, or an empty list if the
+ *  database is not open yet
+ * @throws Failure if anything goes wrong
+ */
+QStringList GeocacheModel::geocachesWithAttributes(
+  const GeocacheAttributes& required, const GeocacheAttributes& excluded,
+  const GeocacheAttributes& anyOf) {
+  if(!ready) {
+    return QStringList();
+  }
+  if(!attributeIndexLoaded) {
+    QTime timer;
+    timer.start();
+    database.loadAttributes(attributeIndex);
+    attributeIndexLoaded = true;
+    qDebug() << "loaded attributes of" << attributeIndex.size() <<
+      "geocaches in" << timer.elapsed() << "ms";
+  }
+  return attributeIndex.filter(required, excluded, anyOf);
+}
+
+/**
+ * Get the fetch records of the saved geocaches inside a circular area, so an
+ * import of the area can skip the geocaches that did not change
+ * @param center Center of the area
+ * @param radius Radius of the area in km
+ * @return The records by waypoint, or an empty hash if the database is not
+ *  open yet
+ * @throws Failure if anything goes wrong
+ */
+QHash<QString, FetchRecord> GeocacheModel::fetchRecords(
+  const Coordinate& center, qreal radius) {
+  if(!ready) {
+    return QHash<QString, FetchRecord>();
+  }
+  QStringList waypoints;
+  foreach(const GeocacheSummary& summary,
+    database.geocachesInRadius(center, radius)) {
+    waypoints << summary.waypointString();
+  }
+  return database.fetchRecords(waypoints);
+}
+
+/**
+ * Search the geocaches for words in their names, owners, descriptions, hints
+ * and logs, see @a GeocacheDatabase::search(). The search uses the full-text
+ * index, so it is fast enough to run in the GUI thread.
+ * @return The matching geocaches, best matches first, or an empty vector if
+ *  the database is not open yet
+ * @throws Failure if anything goes wrong
+ */
+QVector<SearchResult> GeocacheModel::search(const QString& text, int limit,
+  int offset) {
+  return ready ? database.search(text, limit, offset) :
+    QVector<SearchResult>();
+}
+
+/** from QAbstractItemModel: get number of geocaches in the model */
+int GeocacheModel::rowCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : rows.size();
+}
+
+/**
+ * from QAbstractItemModel: get data of a geocache in the model. The display
+ * text is the name followed by the waypoint, see Roles for the other data.
+ */
+QVariant GeocacheModel::data(const QModelIndex& index, int role) const {
+  if(!index.isValid() || index.row() >= rows.size()) {
+    return QVariant();
+  }
+
+  const GeocacheSummary& summary = rows.at(index.row());
+  switch(role) {
+    case Qt::DisplayRole:
+      return rowNames.at(index.row()) + " (" + summary.waypointString() + ")";
+    case WaypointRole:
+      return summary.waypointString();
+    case TypeRole:
+      return int(summary.type);
+    case NameRole:
+      return rowNames.at(index.row());
+    default:
+      return QVariant();
+  }
+}
 
 /**
  * Add geocaches to the database. Because geocaches are indexed by their 
  * waypoint, already existent geocaches with the same waypoint are overwritten.
- * @param geocaches A list of geocaches. You do not have to care about the 
- *  elements of this list to be deleted, they are automagically deleted if no 
- *  longer needed.
+ * Only the added geocaches are written to the database.
+ * @param geocaches A list of geocaches. The model keeps its own copies, which
+ *  share the string and vector data with the originals.
+ * @param records Fetch records of an import, see ImportBatch. Records of the
+ *  added geocaches are written when they are saved, so a geocache that fails
+ *  to save is fetched again; the others belong to unchanged geocaches and
+ *  are written at once. Older records of the same geocaches are replaced.
  */
-void GeocacheModel::addGeocaches(QList<Geocache *>& geocaches) {
-  foreach(Geocache * geocache, geocaches) {
-    geocacheList[geocache->waypoint] = geocache;
+void GeocacheModel::addGeocaches(const QVector<Geocache>& geocaches,
+  const QVector<FetchRecord>& records) {
+  foreach(const Geocache& geocache, geocaches) {
+    insertGeocache(geocache);
+  }
+  QVector<FetchRecord> unchanged;
+  foreach(const FetchRecord& record, records) {
+    if(geocacheList.contains(record.waypoint)) {
+      fetchList.insert(record.waypoint, record);
+    } else {
+      unchanged.append(record);
+    }
   }
   save();
+  if(!unchanged.isEmpty()) {
+    emit workerSaveFetchRecords(unchanged);
+  }
 }
 
 /**
  * Add a single geocache to the database. Because geocaches are indexed by 
  * their waypoint, already existent geocaches with the same waypoint are 
  * overwritten.
- * @param geocache The geocache. You do not have to care about the pointer to be
- *  deleted, it is automagically deleted if no longer needed.
+ * @param geocache The geocache. The model keeps its own copy.
  */
-void GeocacheModel::addGeocache(Geocache * geocache) {
-  geocacheList[geocache->waypoint] = geocache;
+void GeocacheModel::addGeocache(const Geocache& geocache) {
+  insertGeocache(geocache);
   save();
 }
+
 /**
- * Get list of geocaches
+ * Mark a geocache as modified, so it is written to the database on the next
+ * call to @a save(). Call this function after changing the members of a
+ * geocache returned by @a geocache(). The geocache is kept in memory until it
+ * is saved.
+ * @param waypoint Waypoint of the modified geocache
  */
-QList<Geocache *> GeocacheModel::geocaches() const {
-  return geocacheList.values();
+void GeocacheModel::setDirty(const QString& waypoint) {
+  if(geocacheList.contains(waypoint)) {
+    return;
+  }
+  if(savingList.contains(waypoint)) {
+    // the worker has its own copy, so save this one again later
+    geocacheList[waypoint] = new Geocache(*savingList.value(waypoint));
+  } else if(recentList.contains(waypoint)) {
+    geocacheList[waypoint] = recentList.take(waypoint);
+  }
+}
+
+/**
+ * @return @c true if there are changes that have not been saved yet
+ */
+bool GeocacheModel::isDirty() const {
+  return !geocacheList.isEmpty() || !savingList.isEmpty();
+}
+
+/**
+ * @return the number of geocaches that were handed to the database thread
+ *  and are not written yet. Importers use this to wait for the database.
+ */
+int GeocacheModel::savingCount() const {
+  return savingList.size();
+}
+
+/**
+ * @internal
+ * Put a copy of a geocache into the model and mark it as dirty. An older
+ * geocache with the same waypoint is overwritten.
+ */
+void GeocacheModel::insertGeocache(const Geocache& geocache) {
+  Geocache * pgc = geocacheList.value(geocache.waypoint);
+  if(!pgc) {
+    pgc = recentList.take(geocache.waypoint);
+    if(!pgc) {
+      pgc = new Geocache;
+    }
+    geocacheList[geocache.waypoint] = pgc;
+  }
+  *pgc = geocache;
+
+  // the same people own and log many geocaches, keep their names only once
+  pgc->owner = names.intern(pgc->owner);
+  for(int i = 0; i < pgc->logs.size(); ++i) {
+    pgc->logs[i].author = names.intern(pgc->logs[i].author);
+  }
 }
@@ -22,47 +22,204 @@
 #define GEOCACHEMODEL_H_
 
 #include "logic/Geocache.h"
-#include <QObject>
-#include <QtSql>
+#include "logic/GeocacheDatabase.h"
+#include "logic/DatabaseWorker.h"
+#include "logic/SummarySnapshot.h"
+#include "logic/StringPool.h"
 #include <QAbstractListModel>
+#include <QThread>
+#include <QCache>
 
 namespace geojackal {
 
 /**
  * Geocache Model. Loads the geocaches from a SQLite database and defines the
  * interface to access them.
+ * Opening, area queries and saving run in a separate database thread, and
+ * their results are delivered by signals, so the GUI does not block on the
+ * database. Area queries return compact GeocacheSummary records in batches.
+ * The full details of a geocache are only loaded by @a geocache() on a second
+ * connection in the GUI thread, and kept in a bounded cache of recently used
+ * ones.
+ * If enabled in the settings, area queries are answered from a SummarySnapshot
+ * file next to the database as soon as @a open() is called, without waiting
+ * for SQLite. The snapshot is checked against the database once it is open,
+ * and rewritten in the database thread when it is stale.
  * All changes to the data are cached in memory, and not transferred to the
  * database until @a save() is called.
+ *
+ * As an item model, it has one row for every saved geocache, holding its
+ * summary and name. The rows are read page by page by @a fetchMore() when a
+ * view scrolls to the end, so opening a database does not depend on its size.
+ * Every save inserts rows for new geocaches and emits @c dataChanged() for
+ * changed ones, so views can follow an import without reading all geocaches
+ * again; later pages skip the geocaches that got a row that way. Rows keep
+ * their position until the next reset; geocaches are never deleted.
  */
-class GeocacheModel : public QObject {
+class GeocacheModel : public QAbstractListModel {
   Q_OBJECT
 public:
+  /** Item data roles besides Qt::DisplayRole */
+  enum Roles {
+    /** The waypoint of the geocache, as QString */
+    WaypointRole = Qt::UserRole,
+    /** The type of the geocache, as WaypointType */
+    TypeRole,
+    /** The name of the geocache, as QString */
+    NameRole
+  };
+
+  /** Number of rows read by @a fetchMore() */
+  static const int FETCH_SIZE = 500;
+
   GeocacheModel(QObject * parent = 0);
   virtual ~GeocacheModel();
 
-  bool open(const QString& fileName);
-  bool save();
+  void open(const QString& fileName);
+  void save();
+  /** @return @c true if the database is open and can be queried */
+  inline bool isOpen() const {
+    return ready;
+  }
+
+  virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
+  virtual bool canFetchMore(const QModelIndex& parent) const;
+  virtual void fetchMore(const QModelIndex& parent);
+  virtual QVariant data(const QModelIndex& index,
+    int role = Qt::DisplayRole) const;
+  /** @return the summary of the geocache in @a row */
+  inline const GeocacheSummary& summary(int row) const {
+    return rows.at(row);
+  }
+  QModelIndex indexOf(const QString& waypoint) const;
+  void addGeocaches(const QVector<Geocache>& geocaches,
+    const QVector<FetchRecord>& records = QVector<FetchRecord>());
+  void addGeocache(const Geocache& geocache);
+  void setDirty(const QString& waypoint);
+  bool isDirty() const;
+  int savingCount() const;
+  Geocache * geocache(const QString& waypoint);
+  QVector<LogMessage> logs(const QString& waypoint, int limit, int offset = 0);
+  int logCount(const QString& waypoint);
+  QVector<GeocacheSummary> geocaches(const GeocacheQuery& query);
+  QVector<GeocacheSummary> geocachesInRect(const Coordinate& sw,
+    const Coordinate& ne);
+  QVector<GeocacheSummary> geocachesInRadius(const Coordinate& center,
+    qreal radius);
+  QStringList geocachesWithAttributes(const GeocacheAttributes& required,
+    const GeocacheAttributes& excluded = GeocacheAttributes(),
+    const GeocacheAttributes& anyOf = GeocacheAttributes());
+  QVector<SearchResult> search(const QString& text, int limit,
+    int offset = 0);
+  int requestGeocachesInRect(const Coordinate& sw, const Coordinate& ne,
+    const Coordinate& center = COORD_INVALID);
+  QHash<QString, FetchRecord> fetchRecords(const Coordinate& center,
+    qreal radius);
 
-//  int rowCount(const QModelIndex &parent = QModelIndex()) const;
-//  QVariant data(const QModelIndex &index, int role) const;
-  void addGeocaches(QList<Geocache *>& geocaches);
-  void addGeocache(Geocache * geocache);
-  QList<Geocache *> geocaches() const;
+signals:
+  /** Emitted when the database is opened, or could not be opened */
+  void opened(bool ok);
+  /**
+   * Emitted while @a open() upgrades the schema of an older database
+   * @param version The schema version of the running upgrade step
+   * @param done Number of rows of the step that are done
+   * @param total Number of rows of the step, @c 0 if not known
+   */
+  void upgrading(int version, int done, int total);
+  /** Emitted when something went wrong in the database thread */
+  void failed(const QString& message);
+  /**
+   * Emitted for every batch of results of @a requestGeocachesInRect()
+   * @param request The value returned by @a requestGeocachesInRect()
+   * @param batch The next summaries of the geocaches in the area
+   */
+  void geocachesLoaded(int request,
+    const QVector<geojackal::GeocacheSummary>& batch);
+  /** Emitted when all results of a request are delivered */
+  void requestFinished(int request);
+  /** Emitted when changes were written to the database */
+  void saved();
+  /**
+   * Emitted when geocaches could not be written to the database. They are
+   * dropped, see @a workerSaveFailed().
+   * @param message Error message
+   */
+  void saveFailed(const QString& message);
+
+  /** @internal Calls to the worker in the database thread */
+  void workerOpen(const QString& fileName);
+  void workerQueryRect(int request, const geojackal::Coordinate& sw,
+    const geojackal::Coordinate& ne, const geojackal::Coordinate& center);
+  void workerSave(const QVector<geojackal::Geocache>& geocaches);
+  void workerWriteSnapshot(const QString& fileName);
+  void workerSaveFetchRecords(const QVector<geojackal::FetchRecord>& records);
+  /** @internal Results from the snapshot, queued to the public signals */
+  void snapshotLoaded(int request,
+    const QVector<geojackal::GeocacheSummary>& batch);
+  void snapshotFinished(int request);
+
+protected slots:
+  void workerOpened(bool ok, const QString& message);
+  void workerSaved(const QStringList& waypoints);
+  void workerSaveFailed(const QStringList& waypoints, const QString& message);
+  void workerSnapshotWritten(const QString& fileName);
 
 protected:
+  void insertGeocache(const Geocache& geocache);
+  /** @return the row of a geocache, or -1 if the geocache has no row */
+  inline int rowOf(const QString& waypoint) const {
+    return rowIndex.value(waypoint, -1);
+  }
+  void updateRows(const QVector<GeocacheSummary>& summaries,
+    const QStringList& names);
+  void appendRows(const QVector<GeocacheSummary>& summaries,
+    const QStringList& names, const QVector<int>& which);
+  QString snapshotFileName() const;
+  /** @return @c true if the snapshot holds the current summaries */
+  inline bool snapshotUsable() const {
+    return snapshot.isOpen() && geocacheList.isEmpty() &&
+      savingList.isEmpty();
+  }
 
 private:
-  QSqlDatabase db;
-  QSqlQuery q;
-  /** List of geocaches in the model, indexed by waypoint */
+  QString fileName;
+  /** Connection for point lookups in the GUI thread */
+  GeocacheDatabase database;
+  /** Worker doing the slow database work, lives in @a workerThread */
+  DatabaseWorker * worker;
+  QThread workerThread;
+  /** Whether @a database is open */
+  bool ready;
+  /** Identifier of the next area request */
+  int nextRequest;
+  /** Geocaches that were added or changed since last save, by waypoint */
   QHash<QString, Geocache *> geocacheList;
+  /** Geocaches that are being saved by the worker, by waypoint */
+  QHash<QString, Geocache *> savingList;
+  /** Fetch records of geocaches that are not saved yet, by waypoint */
+  QHash<QString, FetchRecord> fetchList;
+  /** Recently used geocache details, by waypoint */
+  QCache<QString, Geocache> recentList;
+  /** Attributes of all saved geocaches, built on first use */
+  AttributeIndex attributeIndex;
+  /** Whether @a attributeIndex has been loaded */
+  bool attributeIndexLoaded;
+  /** Mapped summaries of all saved geocaches, closed when stale */
+  SummarySnapshot snapshot;
+  /** Owner and author names of the geocaches in memory */
+  StringPool names;
+  /** Summaries of the rows of the item model */
+  QVector<GeocacheSummary> rows;
+  /** Names of the geocaches in @a rows */
+  QStringList rowNames;
+  /** Row of each geocache in @a rows, by waypoint */
+  QHash<QString, int> rowIndex;
+  /** Waypoint of the last geocache read by @a fetchMore() */
+  QString fetchedUpTo;
+  /** Whether @a fetchMore() has read all geocaches */
+  bool allFetched;
 };
 
-QString attrsToString(const QVector<GeocacheAttribute>& attrs);
-QVector<GeocacheAttribute> stringToAttrs(const QString str);
-bool sqlValueExists(const QString table, const QString column,
-  const QString value);
-
 }
 
 #endif /* GEOCACHEMODEL_H_ */
@@ -0,0 +1,280 @@
+/**
+ * @file GeocacheQuery.cpp
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logic/GeocacheQuery.h"
+#include <cmath>
+
+using namespace geojackal;
+
+/** Highest difficulty and terrain rating, multiplied by 2 */
+static const unsigned int MAX_RATING = 10;
+
+/**
+ * Constructor, creates a query that matches all geocaches
+ */
+GeocacheQuery::GeocacheQuery() : types_(0), sizes_(0), minDifficulty_(0),
+  maxDifficulty_(MAX_RATING), minTerrain_(0), maxTerrain_(MAX_RATING),
+  archived_(ARCHIVED_INCLUDE), hasArea_(false), sw_(COORD_INVALID),
+  ne_(COORD_INVALID), order_(SORT_NONE), descending_(false),
+  center_(COORD_INVALID), limit_(-1), offset_(0) {
+}
+
+/**
+ * Allow geocaches of a type. If no type is added, all types are allowed.
+ */
+GeocacheQuery& GeocacheQuery::addType(WaypointType type) {
+  types_ |= 1u << type;
+  return *this;
+}
+
+/**
+ * Allow geocaches of a container size. If no size is added, all sizes are
+ * allowed.
+ */
+GeocacheQuery& GeocacheQuery::addSize(GeocacheSize size) {
+  sizes_ |= 1u << size;
+  return *this;
+}
+
+/**
+ * Restrict the difficulty rating
+ * @param min Lowest allowed rating, multiplied by 2
+ * @param max Highest allowed rating, multiplied by 2
+ */
+GeocacheQuery& GeocacheQuery::setDifficulty(unsigned int min,
+  unsigned int max) {
+  minDifficulty_ = min;
+  maxDifficulty_ = max;
+  return *this;
+}
+
+/**
+ * Restrict the terrain rating
+ * @param min Lowest allowed rating, multiplied by 2
+ * @param max Highest allowed rating, multiplied by 2
+ */
+GeocacheQuery& GeocacheQuery::setTerrain(unsigned int min, unsigned int max) {
+  minTerrain_ = min;
+  maxTerrain_ = max;
+  return *this;
+}
+
+/**
+ * Restrict the date the geocaches were placed
+ * @param from First allowed day, or a null date for no lower bound
+ * @param to Last allowed day, or a null date for no upper bound
+ */
+GeocacheQuery& GeocacheQuery::setPlaced(const QDate& from, const QDate& to) {
+  placedFrom_ = from;
+  placedTo_ = to;
+  return *this;
+}
+
+/**
+ * Restrict the date the geocaches were found. Geocaches that were not found
+ * never match if any bound is given.
+ * @param from First allowed day, or a null date for no lower bound
+ * @param to Last allowed day, or a null date for no upper bound
+ */
+GeocacheQuery& GeocacheQuery::setFound(const QDate& from, const QDate& to) {
+  foundFrom_ = from;
+  foundTo_ = to;
+  return *this;
+}
+
+/**
+ * Set whether to return archived geocaches
+ */
+GeocacheQuery& GeocacheQuery::setArchived(ArchivedFilter archived) {
+  archived_ = archived;
+  return *this;
+}
+
+/**
+ * Only return the geocaches of one owner
+ * @param owner Name of the owner, or a null string for all owners
+ */
+GeocacheQuery& GeocacheQuery::setOwner(const QString& owner) {
+  owner_ = owner;
+  return *this;
+}
+
+/**
+ * Filter by attributes
+ * @param required Attributes that a geocache must all have
+ * @param excluded Attributes that a geocache must not have
+ */
+GeocacheQuery& GeocacheQuery::setAttributes(const GeocacheAttributes& required,
+  const GeocacheAttributes& excluded) {
+  requiredAttrs_ = required;
+  excludedAttrs_ = excluded;
+  return *this;
+}
+
+/**
+ * Restrict the query to a rectangular area. The area must not cross the
+ * 180th meridian.
+ * @param sw South-western corner of the area
+ * @param ne North-eastern corner of the area
+ */
+GeocacheQuery& GeocacheQuery::setArea(const Coordinate& sw,
+  const Coordinate& ne) {
+  hasArea_ = true;
+  sw_ = sw;
+  ne_ = ne;
+  return *this;
+}
+
+/**
+ * Set the sort order of the results. Geocaches with the same sort key are
+ * ordered by waypoint.
+ * @param order The sort order
+ * @param descending Whether to sort in descending order
+ * @param center Reference point for @c SORT_DISTANCE
+ */
+GeocacheQuery& GeocacheQuery::setSortOrder(SortOrder order, bool descending,
+  const Coordinate& center) {
+  order_ = order;
+  descending_ = descending;
+  center_ = center;
+  if(order_ == SORT_DISTANCE && center_.lat == ANGLE_INVALID) {
+    order_ = SORT_NONE;
+  }
+  return *this;
+}
+
+/**
+ * Return only a page of the results
+ * @param limit Maximum number of results, negative for no limit
+ * @param offset Number of results to skip
+ */
+GeocacheQuery& GeocacheQuery::setLimit(int limit, int offset) {
+  limit_ = limit;
+  offset_ = qMax(offset, 0);
+  return *this;
+}
+
+/**
+ * Check a geocache against the filter, ignoring sort order and page. This is
+ * used for geocaches that are not in the database yet.
+ */
+bool GeocacheQuery::matches(const Geocache& geocache) const {
+  if(types_ && !(types_ & (1u << geocache.type))) {
+    return false;
+  }
+  if(sizes_ && !(sizes_ & (1u << geocache.size))) {
+    return false;
+  }
+  if(geocache.difficulty < minDifficulty_ ||
+    geocache.difficulty > maxDifficulty_ ||
+    geocache.terrain < minTerrain_ || geocache.terrain > maxTerrain_) {
+    return false;
+  }
+  if((placedFrom_.isValid() || placedTo_.isValid()) &&
+    (!geocache.placed.isValid() ||
+    (placedFrom_.isValid() && geocache.placed < placedFrom_) ||
+    (placedTo_.isValid() && geocache.placed > placedTo_))) {
+    return false;
+  }
+  if((foundFrom_.isValid() || foundTo_.isValid()) &&
+    (!geocache.found.isValid() ||
+    (foundFrom_.isValid() && geocache.found < foundFrom_) ||
+    (foundTo_.isValid() && geocache.found > foundTo_))) {
+    return false;
+  }
+  if((archived_ == ARCHIVED_EXCLUDE && geocache.archived) ||
+    (archived_ == ARCHIVED_ONLY && !geocache.archived)) {
+    return false;
+  }
+  if(!owner_.isNull() && geocache.owner != owner_) {
+    return false;
+  }
+  if(!geocache.attrs.containsAll(requiredAttrs_) ||
+    geocache.attrs.containsAny(excludedAttrs_)) {
+    return false;
+  }
+  if(hasArea_ && (geocache.coord.lat < sw_.lat || geocache.coord.lat > ne_.lat
+    || geocache.coord.lon < sw_.lon || geocache.coord.lon > ne_.lon)) {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Get the value that the results are sorted by. The values are the same that
+ * GeocacheDatabase selects as sort key, so results from memory and from the
+ * database can be merged with @a lessThan().
+ * @return the sort key, or a null value for @c SORT_NONE
+ */
+QVariant GeocacheQuery::sortKey(const Geocache& geocache) const {
+  switch(order_) {
+    case SORT_WAYPOINT:
+      return geocache.waypoint;
+    case SORT_NAME:
+      return geocache.name;
+    case SORT_DIFFICULTY:
+      return geocache.difficulty;
+    case SORT_TERRAIN:
+      return geocache.terrain;
+    case SORT_PLACED:
+      return geocache.placed.isValid() ?
+        QDateTime(geocache.placed).toUTC().toTime_t() : 0u;
+    case SORT_FOUND:
+      return geocache.found.isValid() ?
+        QDateTime(geocache.found).toUTC().toTime_t() : 0u;
+    case SORT_DISTANCE:
+      return distanceKey(geocache.coord.lat, geocache.coord.lon);
+    default:
+      return QVariant();
+  }
+}
+
+/**
+ * Compare two results by their sort keys, as returned by @a sortKey()
+ * @return @c true if the first result comes before the second one
+ */
+bool GeocacheQuery::lessThan(const QVariant& key, const QString& waypoint,
+  const QVariant& otherKey, const QString& otherWaypoint) const {
+  int cmp = 0;
+  if(order_ == SORT_WAYPOINT || order_ == SORT_NAME) {
+    cmp = QString::compare(key.toString(), otherKey.toString(),
+      Qt::CaseInsensitive);
+  } else if(order_ != SORT_NONE) {
+    double a = key.toDouble(), b = otherKey.toDouble();
+    cmp = (a < b) ? -1 : (a > b) ? 1 : 0;
+  }
+  if(cmp == 0) {
+    cmp = QString::compare(waypoint, otherWaypoint);
+  }
+  return descending_ ? cmp > 0 : cmp < 0;
+}
+
+/**
+ * Get the sort key for @c SORT_DISTANCE. This is the squared distance to the
+ * center on a plane with longitudes scaled to the center latitude, which has
+ * the same order as the real distance for any area shown on the map, and can
+ * be computed by SQLite.
+ */
+double GeocacheQuery::distanceKey(double lat, double lon) const {
+  double cosLat = cos(center_.lat * M_PI / 180.0);
+  double dLat = lat - center_.lat;
+  double dLon = (lon - center_.lon) * cosLat;
+  return dLat * dLat + dLon * dLon;
+}
@@ -0,0 +1,201 @@
+/**
+ * @file GeocacheQuery.h
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEOCACHEQUERY_H_
+#define GEOCACHEQUERY_H_
+
+#include "logic/Geocache.h"
+#include <QVariant>
+
+namespace geojackal {
+
+/**
+ * Filter, sort order and page for a query on the geocaches. All setters
+ * return a reference to the query, so the conditions can be chained, like
+ * <tt>GeocacheQuery().addType(TYPE_TRADI).setTerrain(2, 4).setLimit(50)</tt>.
+ * A new query matches all geocaches, unsorted and without a limit. Pass it
+ * to GeocacheModel::geocaches() to run it.
+ */
+class GeocacheQuery {
+public:
+  /** Sort order of the results */
+  enum SortOrder {
+    /** Order in which the database finds them, the fastest */
+    SORT_NONE,
+    /** By waypoint */
+    SORT_WAYPOINT,
+    /** By name, case-insensitive */
+    SORT_NAME,
+    /** By difficulty rating */
+    SORT_DIFFICULTY,
+    /** By terrain rating */
+    SORT_TERRAIN,
+    /** By date placed */
+    SORT_PLACED,
+    /** By date found */
+    SORT_FOUND,
+    /** By distance to the center given to @a setSortOrder() */
+    SORT_DISTANCE
+  };
+
+  /** Whether to return archived geocaches */
+  enum ArchivedFilter {
+    /** Return archived and active geocaches */
+    ARCHIVED_INCLUDE,
+    /** Only return active geocaches */
+    ARCHIVED_EXCLUDE,
+    /** Only return archived geocaches */
+    ARCHIVED_ONLY
+  };
+
+  GeocacheQuery();
+
+  GeocacheQuery& addType(WaypointType type);
+  GeocacheQuery& addSize(GeocacheSize size);
+  GeocacheQuery& setDifficulty(unsigned int min, unsigned int max);
+  GeocacheQuery& setTerrain(unsigned int min, unsigned int max);
+  GeocacheQuery& setPlaced(const QDate& from, const QDate& to);
+  GeocacheQuery& setFound(const QDate& from, const QDate& to);
+  GeocacheQuery& setArchived(ArchivedFilter archived);
+  GeocacheQuery& setOwner(const QString& owner);
+  GeocacheQuery& setAttributes(const GeocacheAttributes& required,
+    const GeocacheAttributes& excluded = GeocacheAttributes());
+  GeocacheQuery& setArea(const Coordinate& sw, const Coordinate& ne);
+  GeocacheQuery& setSortOrder(SortOrder order, bool descending = false,
+    const Coordinate& center = COORD_INVALID);
+  GeocacheQuery& setLimit(int limit, int offset = 0);
+
+  /** @return bit @c t is set if type @c t is allowed, @c 0 for all types */
+  inline quint32 types() const {
+    return types_;
+  }
+  /** @return bit @c s is set if size @c s is allowed, @c 0 for all sizes */
+  inline quint32 sizes() const {
+    return sizes_;
+  }
+  inline unsigned int minDifficulty() const {
+    return minDifficulty_;
+  }
+  inline unsigned int maxDifficulty() const {
+    return maxDifficulty_;
+  }
+  inline unsigned int minTerrain() const {
+    return minTerrain_;
+  }
+  inline unsigned int maxTerrain() const {
+    return maxTerrain_;
+  }
+  /** @return start of the date placed range, null for no lower bound */
+  inline const QDate& placedFrom() const {
+    return placedFrom_;
+  }
+  /** @return end of the date placed range, null for no upper bound */
+  inline const QDate& placedTo() const {
+    return placedTo_;
+  }
+  /** @return start of the date found range, null for no lower bound */
+  inline const QDate& foundFrom() const {
+    return foundFrom_;
+  }
+  /** @return end of the date found range, null for no upper bound */
+  inline const QDate& foundTo() const {
+    return foundTo_;
+  }
+  inline ArchivedFilter archived() const {
+    return archived_;
+  }
+  /** @return the owner to filter by, or a null string for all owners */
+  inline const QString& owner() const {
+    return owner_;
+  }
+  inline const GeocacheAttributes& requiredAttributes() const {
+    return requiredAttrs_;
+  }
+  inline const GeocacheAttributes& excludedAttributes() const {
+    return excludedAttrs_;
+  }
+  /** @return @c true if the query filters by attributes */
+  inline bool hasAttributeFilter() const {
+    return !requiredAttrs_.isEmpty() || !excludedAttrs_.isEmpty();
+  }
+  /** @return @c true if the query is restricted to an area */
+  inline bool hasArea() const {
+    return hasArea_;
+  }
+  inline const Coordinate& areaSouthWest() const {
+    return sw_;
+  }
+  inline const Coordinate& areaNorthEast() const {
+    return ne_;
+  }
+  inline SortOrder sortOrder() const {
+    return order_;
+  }
+  inline bool descending() const {
+    return descending_;
+  }
+  inline const Coordinate& sortCenter() const {
+    return center_;
+  }
+  /** @return the maximum number of results, negative for no limit */
+  inline int limit() const {
+    return limit_;
+  }
+  /** @return the number of results to skip */
+  inline int offset() const {
+    return offset_;
+  }
+
+  bool matches(const Geocache& geocache) const;
+  QVariant sortKey(const Geocache& geocache) const;
+  bool lessThan(const QVariant& key, const QString& waypoint,
+    const QVariant& otherKey, const QString& otherWaypoint) const;
+  double distanceKey(double lat, double lon) const;
+
+private:
+  quint32 types_;
+  quint32 sizes_;
+  unsigned int minDifficulty_;
+  unsigned int maxDifficulty_;
+  unsigned int minTerrain_;
+  unsigned int maxTerrain_;
+  QDate placedFrom_;
+  QDate placedTo_;
+  QDate foundFrom_;
+  QDate foundTo_;
+  ArchivedFilter archived_;
+  QString owner_;
+  GeocacheAttributes requiredAttrs_;
+  GeocacheAttributes excludedAttrs_;
+  bool hasArea_;
+  Coordinate sw_;
+  Coordinate ne_;
+  SortOrder order_;
+  bool descending_;
+  Coordinate center_;
+  int limit_;
+  int offset_;
+};
+
+}
+
+Q_DECLARE_TYPEINFO(geojackal::GeocacheQuery, Q_MOVABLE_TYPE);
+
+#endif /* GEOCACHEQUERY_H_ */
@@ -0,0 +1,135 @@
+/**
+ * @file NameDictionary.cpp
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logic/NameDictionary.h"
+#include "logic/Failure.h"
+
+using namespace geojackal;
+
+/**
+ * Constructor
+ * @param table Name of the dictionary table
+ */
+NameDictionary::NameDictionary(const QString& table) : table_(table) {
+}
+
+/**
+ * Create the dictionary table, if it does not exist yet
+ * @throws Failure if anything goes wrong
+ */
+void NameDictionary::create(QSqlDatabase& db) {
+  QSqlQuery query(db);
+  if(!query.exec(QString("CREATE TABLE IF NOT EXISTS %1("
+    "id INTEGER PRIMARY KEY,"
+    "name TEXT NOT NULL UNIQUE"
+    ")").arg(table_))) {
+    throw Failure("Failed to create table '" + table_ + "'! " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+}
+
+/**
+ * Get the id of a name, and add the name to the table if it is not there yet
+ * @throws Failure if anything goes wrong
+ */
+qlonglong NameDictionary::id(QSqlDatabase& db, const QString& name) {
+  qlonglong ret = find(db, name);
+  if(ret >= 0) {
+    return ret;
+  }
+
+  QSqlQuery query(db);
+  query.prepare(QString("INSERT INTO %1 (name) VALUES (:name)").arg(table_));
+  query.bindValue(":name", name);
+  if(!query.exec()) {
+    throw Failure("Error while trying to save to SQL table '" + table_ +
+      "': " + query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+  ret = query.lastInsertId().toLongLong();
+  ids_.insert(name, ret);
+  names_.insert(ret, name);
+  return ret;
+}
+
+/**
+ * Get the id of a name without adding it
+ * @return the id, or @c -1 if the name is not in the table
+ * @throws Failure if anything goes wrong
+ */
+qlonglong NameDictionary::find(QSqlDatabase& db, const QString& name) {
+  QHash<QString, qlonglong>::const_iterator it = ids_.constFind(name);
+  if(it != ids_.constEnd()) {
+    return it.value();
+  }
+
+  QSqlQuery query(db);
+  query.prepare(QString("SELECT id FROM %1 WHERE name = :name").arg(table_));
+  query.bindValue(":name", name);
+  if(!query.exec()) {
+    throw Failure("Failed to read table '" + table_ + "'! " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+  if(!query.next()) {
+    return -1;
+  }
+  qlonglong ret = query.value(0).toLongLong();
+  ids_.insert(name, ret);
+  names_.insert(ret, name);
+  return ret;
+}
+
+/**
+ * Get the name with an id
+ * @return the name, or an empty string if there is none with this id
+ * @throws Failure if anything goes wrong
+ */
+QString NameDictionary::name(QSqlDatabase& db, qlonglong id) {
+  QHash<qlonglong, QString>::const_iterator it = names_.constFind(id);
+  if(it != names_.constEnd()) {
+    return it.value();
+  }
+
+  QSqlQuery query(db);
+  query.prepare(QString("SELECT name FROM %1 WHERE id = :id").arg(table_));
+  query.bindValue(":id", id);
+  if(!query.exec()) {
+    throw Failure("Failed to read table '" + table_ + "'! " +
+      query.lastError().text() + "\nFailed query was: " +
+      query.executedQuery());
+  }
+  if(!query.next()) {
+    return QString();
+  }
+  QString ret = query.value(0).toString();
+  ids_.insert(ret, id);
+  names_.insert(id, ret);
+  return ret;
+}
+
+/**
+ * Forget all cached names and ids
+ */
+void NameDictionary::clear() {
+  ids_.clear();
+  names_.clear();
+}
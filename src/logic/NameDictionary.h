@@ -0,0 +1,64 @@
+/**
+ * @file NameDictionary.h
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAMEDICTIONARY_H_
+#define NAMEDICTIONARY_H_
+
+#include <QtSql>
+#include <QHash>
+#include <QString>
+
+namespace geojackal {
+
+/**
+ * Dictionary table in the database that stores each distinct name once, like
+ * the owners of geocaches or the authors of logs. Other tables reference the
+ * names by integer id. Names and ids that were looked up are cached, so every
+ * name is read from the database and held in memory only once.
+ *
+ * The table has the columns @c id and @c name. Call @a clear() when a
+ * transaction that added names is rolled back, as their ids are void then.
+ */
+class NameDictionary {
+public:
+  NameDictionary(const QString& table);
+
+  void create(QSqlDatabase& db);
+  qlonglong id(QSqlDatabase& db, const QString& name);
+  qlonglong find(QSqlDatabase& db, const QString& name);
+  QString name(QSqlDatabase& db, qlonglong id);
+  void clear();
+
+  /** @return the name of the table */
+  inline const QString& table() const {
+    return table_;
+  }
+
+private:
+  QString table_;
+  /** Cached ids, by name */
+  QHash<QString, qlonglong> ids_;
+  /** Cached names, by id */
+  QHash<qlonglong, QString> names_;
+};
+
+}
+
+#endif /* NAMEDICTIONARY_H_ */
@@ -86,6 +86,19 @@ void SettingsManager::setGcPassword(const QString password) {
 }
 /** @} */
 
+/**
+ * @{
+ * The server geocaching.com is reached at, without a trailing slash. Set it
+ * to a local stand-in like tools/gcstandin to import from recorded pages.
+ */
+QString SettingsManager::gcBaseUrl() {
+  return s->value("gc/baseUrl", "http://www.geocaching.com").toString();
+}
+void SettingsManager::setGcBaseUrl(const QString& url) {
+  s->setValue("gc/baseUrl", url);
+}
+/** @} */
+
 /**
  * @{
  * The maximum distance between the center and the geocaches to be imported
@@ -99,6 +112,61 @@ void SettingsManager::setMaxImportDist(qreal dist) {
 }
 /** @} */
 
+/**
+ * @{
+ * The number of hours after an import in which geocaches are not fetched
+ * again by the next import of the same area
+ */
+int SettingsManager::fetchFreshness() {
+  bool ok;
+  return s->value("gc/freshness", 24).toInt(&ok);
+}
+void SettingsManager::setFetchFreshness(int hours) {
+  s->setValue("gc/freshness", hours);
+}
+/** @} */
+
+/**
+ * @{
+ * The maximum number of geocache pages that are loaded at the same time
+ */
+int SettingsManager::fetchConcurrency() {
+  bool ok;
+  return s->value("gc/concurrency", 4).toInt(&ok);
+}
+void SettingsManager::setFetchConcurrency(int requests) {
+  s->setValue("gc/concurrency", requests);
+}
+/** @} */
+
+/**
+ * @{
+ * The minimum time in ms between the starts of two requests to
+ * geocaching.com, so the server is not flooded
+ */
+int SettingsManager::fetchInterval() {
+  bool ok;
+  return s->value("gc/fetchInterval", 250).toInt(&ok);
+}
+void SettingsManager::setFetchInterval(int interval) {
+  s->setValue("gc/fetchInterval", interval);
+}
+/** @} */
+
+/**
+ * @{
+ * The time in ms after which a request to geocaching.com is aborted if the
+ * server did not answer, or 0 to wait forever
+ */
+int SettingsManager::fetchTimeout() {
+  bool ok;
+  return s->value("gc/timeout", 30000).toInt(&ok);
+}
+void SettingsManager::setFetchTimeout(int timeout) {
+  s->setValue("gc/timeout", timeout);
+}
+/** @} */
+
 /**
  * @{
  * The center coordinate
@@ -115,3 +183,86 @@ void SettingsManager::setCenter(const Coordinate& center) {
   s->setValue("gc/centerLon", (double)center.lon);
 }
 /** @} */
+
+/**
+ * @{
+ * The number of recently viewed geocaches whose details are kept in memory,
+ * see GeocacheModel::geocache(). At least one, as the model hands out a
+ * pointer to the last one.
+ */
+int SettingsManager::geocacheCacheSize() {
+  bool ok;
+  int size = s->value("cache/geocaches", 2000).toInt(&ok);
+  return ok ? qMax(size, 1) : 2000;
+}
+void SettingsManager::setGeocacheCacheSize(int size) {
+  s->setValue("cache/geocaches", size);
+}
+/** @} */
+
+/**
+ * @{
+ * Whether to keep a memory-mapped snapshot of the geocache summaries next to
+ * the database, for a fast start
+ */
+bool SettingsManager::useSnapshot() {
+  return s->value("cache/snapshot", true).toBool();
+}
+void SettingsManager::setUseSnapshot(bool use) {
+  s->setValue("cache/snapshot", use);
+}
+/** @} */
+
+/**
+ * @{
+ * Whether to keep the raw geocache pages loaded from geocaching.com on disk,
+ * so they can be revalidated and parsed again
+ */
+bool SettingsManager::usePageCache() {
+  return s->value("cache/pages", true).toBool();
+}
+void SettingsManager::setUsePageCache(bool use) {
+  s->setValue("cache/pages", use);
+}
+/** @} */
+
+/**
+ * @{
+ * The size of the SQLite page cache of each database connection, in KiB
+ */
+int SettingsManager::databaseCacheSize() {
+  bool ok;
+  return s->value("db/cacheSize", 8192).toInt(&ok);
+}
+void SettingsManager::setDatabaseCacheSize(int size) {
+  s->setValue("db/cacheSize", size);
+}
+/** @} */
+
+/**
+ * @{
+ * The size of the part of the database file that is memory-mapped by each
+ * connection, in MiB. 0 disables memory-mapped I/O.
+ */
+int SettingsManager::databaseMmapSize() {
+  bool ok;
+  return s->value("db/mmapSize", 64).toInt(&ok);
+}
+void SettingsManager::setDatabaseMmapSize(int size) {
+  s->setValue("db/mmapSize", size);
+}
+/** @} */
+
+/**
+ * @{
+ * The number of pages in the write-ahead log of the database after which the
+ * database thread copies them back to the database
+ */
+int SettingsManager::checkpointPages() {
+  bool ok;
+  return s->value("db/checkpointPages", 1000).toInt(&ok);
+}
+void SettingsManager::setCheckpointPages(int pages) {
+  s->setValue("db/checkpointPages", pages);
+}
+/** @} */
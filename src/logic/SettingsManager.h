@@ -47,12 +47,45 @@ public:
   QString gcPassword();
   void setGcPassword(const QString password);
 
+  QString gcBaseUrl();
+  void setGcBaseUrl(const QString& url);
+
   qreal maxImportDist();
   void setMaxImportDist(qreal dist);
 
+  int fetchFreshness();
+  void setFetchFreshness(int hours);
+
+  int fetchConcurrency();
+  void setFetchConcurrency(int requests);
+
+  int fetchInterval();
+  void setFetchInterval(int interval);
+
+  int fetchTimeout();
+  void setFetchTimeout(int timeout);
+
   Coordinate center();
   void setCenter(const Coordinate& center);
 
+  int geocacheCacheSize();
+  void setGeocacheCacheSize(int size);
+
+  bool useSnapshot();
+  void setUseSnapshot(bool use);
+
+  bool usePageCache();
+  void setUsePageCache(bool use);
+
+  int databaseCacheSize();
+  void setDatabaseCacheSize(int size);
+
+  int databaseMmapSize();
+  void setDatabaseMmapSize(int size);
+
+  int checkpointPages();
+  void setCheckpointPages(int pages);
+
 private:
   SettingsManager();
   SettingsManager(const SettingsManager&);
@@ -0,0 +1,44 @@
+/**
+ * @file StringPool.cpp
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logic/StringPool.h"
+
+using namespace geojackal;
+
+/**
+ * Constructor, creates an empty pool
+ */
+StringPool::StringPool() {
+}
+
+/**
+ * Intern a string
+ * @param string The string
+ * @return the instance in the pool that is equal to @a string, which is added
+ *  to the pool if there is none yet
+ */
+QString StringPool::intern(const QString& string) {
+  QSet<QString>::const_iterator it = strings_.constFind(string);
+  if(it != strings_.constEnd()) {
+    return *it;
+  }
+  strings_.insert(string);
+  return string;
+}
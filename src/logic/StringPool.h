@@ -0,0 +1,55 @@
+/**
+ * @file StringPool.h
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STRINGPOOL_H_
+#define STRINGPOOL_H_
+
+#include <QSet>
+#include <QString>
+
+namespace geojackal {
+
+/**
+ * Pool of interned strings. Equal strings passed to @a intern() come back as
+ * copies of one instance, so with implicit sharing their characters exist in
+ * memory only once. Use this for names that are repeated many times, like
+ * owners and log authors. The pool is not thread-safe.
+ */
+class StringPool {
+public:
+  StringPool();
+
+  QString intern(const QString& string);
+  /** @return the number of distinct strings in the pool */
+  inline int size() const {
+    return strings_.size();
+  }
+  /** Remove all strings from the pool */
+  inline void clear() {
+    strings_.clear();
+  }
+
+private:
+  QSet<QString> strings_;
+};
+
+}
+
+#endif /* STRINGPOOL_H_ */
@@ -0,0 +1,91 @@
+/**
+ * @file SummarySnapshot.h
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SUMMARYSNAPSHOT_H_
+#define SUMMARYSNAPSHOT_H_
+
+#include "logic/Geocache.h"
+#include <QFile>
+#include <QVector>
+
+namespace geojackal {
+
+/**
+ * Read-only binary snapshot of the summaries of all geocaches, stored in a
+ * file next to the database. The file is mapped into memory and the records
+ * are used in place, so opening it costs no parsing and no allocations, no
+ * matter how many geocaches there are; only the string offsets are checked.
+ * Names and owners are interned into one string table. The snapshot carries
+ * the generation counter of the database it was written from, see
+ * GeocacheDatabase::generation(), so a stale snapshot can be detected.
+ *
+ * The file is written in host byte order and with the host's layout of
+ * GeocacheSummary; a snapshot from another machine is simply rejected.
+ */
+class SummarySnapshot {
+public:
+  SummarySnapshot();
+  virtual ~SummarySnapshot();
+
+  bool open(const QString& fileName);
+  void close();
+  /** @return @c true if a snapshot is mapped */
+  inline bool isOpen() const {
+    return records_ != 0;
+  }
+  /** @return the generation of the database the snapshot was written from */
+  inline quint64 generation() const {
+    return generation_;
+  }
+  /** @return the number of geocaches in the snapshot */
+  inline int size() const {
+    return count_;
+  }
+  /** @return the summary of the geocache at @a i, ordered by waypoint */
+  inline const GeocacheSummary& at(int i) const {
+    return records_[i];
+  }
+  QString name(int i) const;
+  QString owner(int i) const;
+  int indexOf(const QString& waypoint) const;
+  QVector<GeocacheSummary> geocachesInRect(const Coordinate& sw,
+    const Coordinate& ne, const Coordinate& center = COORD_INVALID) const;
+
+  static void write(const QString& fileName, quint64 generation,
+    const QVector<GeocacheSummary>& summaries, const QStringList& names,
+    const QStringList& owners);
+
+private:
+  SummarySnapshot(const SummarySnapshot&);
+  SummarySnapshot& operator=(const SummarySnapshot&);
+
+  QFile file_;
+  uchar * data_;
+  quint64 generation_;
+  int count_;
+  const GeocacheSummary * records_;
+  const quint32 * names_;
+  const quint32 * owners_;
+  const char * strings_;
+};
+
+}
+
+#endif /* SUMMARYSNAPSHOT_H_ */
@@ -84,7 +84,7 @@ void InfoTab::setGeocache(Geocache * geocache) {
   if(geocache) {
     waypoint_->setText(geocache->waypoint);
     owner_->setText(geocache->owner);
-    placed_->setText(geocache->placed->toString(Qt::SystemLocaleShortDate));
+    placed_->setText(geocache->placed.toString(Qt::SystemLocaleShortDate));
     size_->setText(sizeToText(geocache->size));
     diff_->setText(QString("%1").arg(qreal(geocache->difficulty) / 2.0));
     terrain_->setText(QString("%1").arg(qreal(geocache->terrain) / 2.0));
@@ -99,8 +99,8 @@ void InfoTab::setGeocache(Geocache * geocache) {
 }
 
 /** Geocache information dialog */
-GeocacheInfoWidget::GeocacheInfoWidget(Geocache * geocache, QWidget * parent) :
-  QWidget(parent), geocache_(geocache) {
+GeocacheInfoWidget::GeocacheInfoWidget(GeocacheModel * model,
+  QWidget * parent) : QWidget(parent), model_(model) {
 
   mainLayout_ = new QGridLayout(this);
 
@@ -121,26 +121,47 @@ GeocacheInfoWidget::GeocacheInfoWidget(Geocache * geocache, QWidget * parent) :
   geocacheDescBrowser_ = new QTextBrowser;
   geocacheDescBrowser_->setOpenExternalLinks(true);
 
+  // log browser
+  geocacheLogBrowser_ = new QTextBrowser;
+  geocacheLogBrowser_->setOpenExternalLinks(true);
+
   tab_ = new QTabWidget;
   tab_->addTab(geocacheInfoTab_, tr("&General"));
   tab_->addTab(geocacheDescBrowser_, tr("&Description"));
+  tab_->addTab(geocacheLogBrowser_, tr("&Logs"));
   mainLayout_->addWidget(tab_, 1, 0, 1, 2);
 
   setLayout(mainLayout_);
 
-  // fill in the values
-  setGeocache(geocache);
+  // show changes of the geocache when it is saved again
+  connect(model_, SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)),
+    SLOT(geocachesChanged(const QModelIndex&, const QModelIndex&)));
+
+  // no geocache selected yet
+  setGeocache(QString());
 }
 
 GeocacheInfoWidget::~GeocacheInfoWidget() {
 }
 
 /**
- * Set the geocache whose data is to be displayed.
- * @param geocache the new geocache. If this parameter is @c 0, the controls
- * holding the geocache information are cleared.
+ * Set the geocache whose data is to be displayed. The details are loaded from
+ * the model here, and not before.
+ * @param waypoint Waypoint of the new geocache. If this parameter is empty or
+ * there is no such geocache, the controls holding the geocache information
+ * are cleared.
  */
-void GeocacheInfoWidget::setGeocache(Geocache * geocache) {
+void GeocacheInfoWidget::setGeocache(const QString& waypoint) {
+  waypoint_ = waypoint;
+  Geocache * geocache = 0;
+  if(!waypoint.isEmpty()) {
+    try {
+      geocache = model_->geocache(waypoint);
+    } catch(Failure& f) {
+      qDebug() << "Failure while loading" << waypoint << ":" << f.what();
+    }
+  }
+
   if(!geocache) {
     // clear values
     geocacheName_->setText("<big><b>" + tr("No geocache selected") +
@@ -148,11 +169,57 @@ void GeocacheInfoWidget::setGeocache(Geocache * geocache) {
     geocacheIcon_->setText("");
     geocacheInfoTab_->setGeocache(0);
     geocacheDescBrowser_->setText("");
+    geocacheLogBrowser_->setText("");
 
   } else {
     geocacheName_->setText("<big><b>" + geocache->name + "</b></big>");
-    geocacheIcon_->setPixmap(geocacheIcon(geocache));
+    geocacheIcon_->setPixmap(geocacheIcon(geocache->type));
     geocacheInfoTab_->setGeocache(geocache);
-    geocacheDescBrowser_->setHtml(geocache->desc);
+    geocacheDescBrowser_->setHtml(geocache->desc.toString());
+    setLogs(waypoint);
+  }
+}
+
+/**
+ * Show the newest logs of a geocache in the log browser. Only one page of
+ * logs is read from the model.
+ * @param waypoint Waypoint of the geocache
+ */
+void GeocacheInfoWidget::setLogs(const QString& waypoint) {
+  QVector<LogMessage> logs;
+  int count = 0;
+  try {
+    logs = model_->logs(waypoint, LOGS_SHOWN);
+    count = model_->logCount(waypoint);
+  } catch(Failure& f) {
+    qDebug() << "Failure while loading logs of" << waypoint << ":" << f.what();
+  }
+
+  QString html;
+  foreach(const LogMessage& log, logs) {
+    html += "<p><b>" + log.author + "</b>, " +
+      log.date.toString(Qt::SystemLocaleShortDate) + "<br/>" +
+      log.msg.toString() + "</p>";
+  }
+  if(count > logs.size()) {
+    html += "<p><i>" + tr("%1 older logs not shown").arg(count - logs.size()) +
+      "</i></p>";
+  }
+  geocacheLogBrowser_->setHtml(html);
+}
+
+/**
+ * @internal
+ * Called when geocaches in the model were changed. The shown geocache is
+ * loaded again if it is among them.
+ */
+void GeocacheInfoWidget::geocachesChanged(const QModelIndex& topLeft,
+  const QModelIndex& bottomRight) {
+  if(waypoint_.isEmpty()) {
+    return;
+  }
+  int row = model_->indexOf(waypoint_).row();
+  if(row >= topLeft.row() && row <= bottomRight.row()) {
+    setGeocache(waypoint_);
   }
 }
@@ -22,6 +22,7 @@
 #define GEOCACHEINFOWIDGET_H_
 
 #include "logic/Geocache.h"
+#include "logic/GeocacheModel.h"
 #include <QObject>
 #include <QtGui>
 
@@ -50,22 +51,37 @@ private:
 /** @} */
 
 /**
- * Geocache information dialog
+ * Geocache information dialog. The details of the geocache are loaded from
+ * the model only when a geocache is selected, and again when its row in the
+ * model changes.
  */
 class GeocacheInfoWidget : public QWidget {
   Q_OBJECT
 public:
-  GeocacheInfoWidget(Geocache * geocache = 0, QWidget * parent = 0);
+  GeocacheInfoWidget(GeocacheModel * model, QWidget * parent = 0);
   virtual ~GeocacheInfoWidget();
 
 public slots:
-  void setGeocache(Geocache * geocache);
+  void setGeocache(const QString& waypoint);
+
+protected:
+  void setLogs(const QString& waypoint);
+
+protected slots:
+  void geocachesChanged(const QModelIndex& topLeft,
+    const QModelIndex& bottomRight);
 
 private:
-  Geocache * geocache_;
+  /** Maximum number of logs shown in the log browser */
+  static const int LOGS_SHOWN = 25;
+
+  GeocacheModel * model_;
+  /** Waypoint of the shown geocache */
+  QString waypoint_;
   QLabel * geocacheName_;
   QLabel * geocacheIcon_;
   QTextBrowser * geocacheDescBrowser_;
+  QTextBrowser * geocacheLogBrowser_;
   InfoTab * geocacheInfoTab_;
   QTabWidget * tab_;
   QGridLayout * mainLayout_;
@@ -21,6 +21,8 @@
 #include "ui/PrefDialog.h"
 #include "ui/GCSpiderDialog.h"
 #include "import/GCSpider.h"
+#include "import/GCImport.h"
+#include "import/PageCache.h"
 #include "logic/Geocache.h"
 #include "logic/GeocacheModel.h"
 #include <QSettings>
@@ -28,10 +30,13 @@
 using namespace geojackal;
 
 MainWindow::MainWindow() :
-  QMainWindow(0), stack_(0), map_(0), infoPane_(0), model_(0),
+  QMainWindow(0), stack_(0), map_(0), infoPane_(0), listPane_(0), model_(0),
+  searchEdit_(0), searchResults_(0),
   aboutAction_(0), exitAction_(0), prefAction_(0), importGCRegionAction_(0),
   importGCSingleAction_(0), detailViewAction_(0), mapViewAction_(0),
-  gotoHomeAction_(0), gotoSignalMap_(0), mainViewActionGroup_(0) {
+  listViewAction_(0), gotoHomeAction_(0), gotoSignalMap_(0),
+  mainViewActionGroup_(0), import_(0), importDialog_(0), loginAction_(0),
+  pageCache_(0), replayAction_(0) {
 
   setWindowTitle(APPNAME);
   qApp->setWindowIcon(QIcon(":/geojackal.png"));
@@ -40,31 +45,57 @@ MainWindow::MainWindow() :
   setupActions();
   setupMenu();
 
-  // load data
+  // load data, this is done in the background
   model_ = new GeocacheModel(this);
-  try {
-    model_->open(g_settings->storageLocation().
-      absoluteFilePath("geocaches.sqlite"));
-  } catch(Failure &f) {
-    QMessageBox::critical(this, "Failure", f.what());
+  connect(model_, SIGNAL(failed(const QString&)),
+    SLOT(databaseFailure(const QString&)));
+  connect(model_, SIGNAL(upgrading(int, int, int)),
+    SLOT(databaseUpgrading(int, int, int)));
+  connect(model_, SIGNAL(opened(bool)), statusBar(), SLOT(clearMessage()));
+  connect(model_, SIGNAL(saved()), SLOT(geocachesSaved()));
+  connect(model_, SIGNAL(saveFailed(const QString&)),
+    SLOT(geocachesSaveFailed(const QString&)));
+  model_->open(g_settings->storageLocation().
+    absoluteFilePath("geocaches.sqlite"));
+
+  // raw geocache pages, to revalidate and parse them again
+  pageCache_ = new PageCache;
+  if(g_settings->usePageCache()) {
+    pageCache_->open(g_settings->storageLocation().absoluteFilePath("pages"));
   }
 
+  // imports wait for the login to geocaching.com
+  GCSpider * spider = GCSpider::instance();
+  connect(spider, SIGNAL(loginSucceeded()), SLOT(loginSucceeded()));
+  connect(spider, SIGNAL(loginFailed(const QString&)),
+    SLOT(loginFailed(const QString&)));
+
   // setup map widget
   QDir cacheDir(g_settings->storageLocation().absoluteFilePath("maps"));
   map_ = new OsmSlippyMap(this, g_settings->center(), 16, cacheDir);
-  map_->setCaches(model_->geocaches());
+  map_->setModel(model_);
 
   // setup geocache detail widget
-  infoPane_ = new GeocacheInfoWidget;
+  infoPane_ = new GeocacheInfoWidget(model_);
   // display geocache in detail widget on click on map
-  connect(map_, SIGNAL(clicked(Geocache *)), infoPane_,
-    SLOT(setGeocache(Geocache *)));
-  connect(map_, SIGNAL(clicked(Geocache *)), SLOT(detailView()));
+  connect(map_, SIGNAL(clicked(const QString&)), infoPane_,
+    SLOT(setGeocache(const QString&)));
+  connect(map_, SIGNAL(clicked(const QString&)), SLOT(detailView()));
+
+  // list of all geocaches, follows the model row by row
+  listPane_ = new QListView;
+  listPane_->setUniformItemSizes(true);
+  listPane_->setModel(model_);
+  connect(listPane_, SIGNAL(activated(const QModelIndex&)),
+    SLOT(geocacheActivated(const QModelIndex&)));
 
   // stacked widget as central widget of the window
   stack_ = new QStackedWidget;
   stack_->addWidget(map_);
   stack_->addWidget(infoPane_);
+  stack_->addWidget(listPane_);
+
+  setupSearch();
 
   setCentralWidget(stack_);
   stack_->setCurrentWidget(map_);
@@ -85,81 +116,135 @@ MainWindow::~MainWindow() {
   if(model_) {
     delete model_;
   }
+  if(pageCache_) {
+    delete pageCache_;
+  }
 }
 
 /**
- * Shows the preferences dialog to the user
+ * Shows the preferences dialog to the user. If the geocaching.com account was
+ * changed, the next import logs in with the new one.
  * @return whatever PrefDialog::exec() returns
  */
 int MainWindow::showPrefDialog() {
+  QString username = g_settings->gcUsername();
+  QString password = g_settings->gcPassword();
   PrefDialog prefs(this);
-  return prefs.exec();
+  int ret = prefs.exec();
+  if(g_settings->gcUsername() != username ||
+    g_settings->gcPassword() != password) {
+    GCSpider::logout();
+  }
+  return ret;
 }
 
 /**
- * Validate the geocaching.com login data by displaying the Preferences dialog
- * until login succeds. The login data are taken from the application settings.
- * @return A GCSpider instance, or @c 0 if the user cancelled the Preferences
- *  dialog.
+ * Make sure the user is logged in to geocaching.com. If not, the login is
+ * started with the login data from the application settings, and @a retry is
+ * triggered again when it succeeded. If it fails, the Preferences dialog is
+ * shown until the login succeeds or the user cancels the dialog.
+ * @param retry The action that needs the login
+ * @return The GCSpider instance if the user is logged in, otherwise @c 0.
  */
-GCSpider * MainWindow::validateLogin() {
-  GCSpider * spider = 0;
-
-  // try to login until login succeeds or the user gets weary
-  bool validLogin = false;
-  while(!validLogin) {
-    QString failMsg;
-    try {
-      spider = GCSpider::login(g_settings->gcUsername(),
-        g_settings->gcPassword());
-    } catch(Failure &f) {
-      validLogin = false;
-      failMsg = f.what();
-    }
-    if(spider) { // login successful
-      validLogin = true; // for the accounts... *cough*
-      return spider;
-    }
+GCSpider * MainWindow::validateLogin(QAction * retry) {
+  GCSpider * spider = GCSpider::instance();
+  if(spider->loggedIn()) {
+    return spider;
+  }
 
-    // show prefs dialogue if login fails
-    if(!validLogin) {
-      QMessageBox::critical(this, tr("Error"), tr("There was an error while "
-        "trying to log in to geocaching.com. Maybe the user name or password "
-        "you supplied is wrong.\n\nPlease fill in the correct values and try "
-        "again.\n\nThe message was: ") + failMsg);
+  loginAction_ = retry;
+  try {
+    spider->login(g_settings->gcUsername(), g_settings->gcPassword());
+  } catch(Failure &f) {
+    loginFailed(f.what());
+  }
+  return 0;
+}
 
-      if(showPrefDialog() == QDialog::Rejected) {
-        return 0; // user gave up
-      }
-    }
+/** Called when the login started by @a validateLogin() succeeded */
+void MainWindow::loginSucceeded() {
+  QAction * action = loginAction_;
+  loginAction_ = 0;
+  if(action) {
+    action->trigger();
   }
-  Q_ASSERT(spider == 0 && !validLogin);
-  return 0; // anyways, should not happen!
 }
 
+/**
+ * Called when the login started by @a validateLogin() failed. Shows the
+ * Preferences dialog, and tries again if the user accepts it.
+ * @param message Error message
+ */
+void MainWindow::loginFailed(const QString& message) {
+  // logins from the Preferences dialog are not ours
+  QAction * action = loginAction_;
+  loginAction_ = 0;
+  if(!action) {
+    return;
+  }
+
+  QMessageBox::critical(this, tr("Error"), tr("There was an error while "
+    "trying to log in to geocaching.com. Maybe the user name or password "
+    "you supplied is wrong.\n\nPlease fill in the correct values and try "
+    "again.\n\nThe message was: ") + message);
+
+  if(showPrefDialog() == QDialog::Accepted) {
+    action->trigger();
+  }
+}
+
+/**
+ * Create a new import and the progress dialog that shows it
+ * @param spider The logged in GCSpider
+ * @param finishedSlot Slot that is called when the import is complete
+ * @param failedSlot Slot that is called with the message when the import
+ *  stopped because of an error
+ * @return The import, also in import_
+ */
+GCImport * MainWindow::createImport(GCSpider * spider,
+  const char * finishedSlot, const char * failedSlot) {
+  import_ = new GCImport(spider, this);
+  import_->setCache(pageCache_->isOpen() ? pageCache_ : 0);
+  connect(import_, SIGNAL(finished()), finishedSlot);
+  connect(import_, SIGNAL(failed(const QString&)), failedSlot);
+  connect(import_, SIGNAL(progress(int, int, const QString&)),
+    SLOT(importProgress(int, int, const QString&)));
+  connect(import_, SIGNAL(geocachesReady(const QVector<geojackal::Geocache>&,
+    const QVector<geojackal::FetchRecord>&)), SLOT(importGeocaches(
+    const QVector<geojackal::Geocache>&,
+    const QVector<geojackal::FetchRecord>&)));
+
+  importDialog_ = new QProgressDialog(tr("Import geocaches"), tr("Abort"), 0,
+    0, this);
+  importDialog_->setWindowModality(Qt::WindowModal);
+  importDialog_->setMinimumDuration(0);
+  importDialog_->setAutoReset(false);
+  importDialog_->setAutoClose(false);
+  connect(importDialog_, SIGNAL(canceled()), import_, SLOT(abort()));
+  return import_;
+}
 
 /** Called when the user clicks on the Geocaches->Import region menu item */
 void MainWindow::importGCRegion() {
-  GCSpider * spider = validateLogin();
+  GCSpider * spider = validateLogin(importGCRegionAction_);
 
-  if(spider) {
+  if(spider && !import_) {
     GCSpiderDialog dialog(this);
     if(dialog.exec() == QDialog::Accepted) {
       Coordinate center(dialog.lat(), dialog.lon());
       float maxDist = dialog.maxDist();
 
-      QList<Geocache *> geocacheList;
+      // geocaches that are known and did not change are not fetched again
+      createImport(spider, SLOT(importFinished()));
+      import_->batch().setKnown(model_->fetchRecords(center, maxDist),
+        g_settings->fetchFreshness());
       try {
-        if(!spider->nearest(center, maxDist, geocacheList)) {
-          throw Failure(tr("Something went wrong, but I don't know what. "
-            "Some geocaches could not be imported."));
-        }
+        import_->nearest(center, maxDist);
       } catch(Failure& f) {
-        QMessageBox::critical(this, tr("Error"), f.what());
+        importFailed(f.what());
+        return;
       }
-
-      model_->addGeocaches(geocacheList);
-      map_->setCaches(model_->geocaches());
+      // the map shows the geocaches as they are saved
       map_->setCenter(center);
     }
   }
@@ -167,30 +252,159 @@ void MainWindow::importGCRegion() {
 
 /** Called when the user clicks on the Geocaches->Import single menu item */
 void MainWindow::importGCSingle() {
-  GCSpider * spider = validateLogin();
+  GCSpider * spider = validateLogin(importGCSingleAction_);
 
-  if(spider) {
+  if(spider && !import_) {
     bool ok;
     QString waypoint = QInputDialog::getText(this, tr("Import single geocache"),
       tr("Enter the waypoint of the geocache:"), QLineEdit::Normal, "GC", &ok);
     if(ok) {
-      Geocache * pgc = new Geocache;
+      createImport(spider, SLOT(singleImported()));
       try {
-        spider->single(waypoint, *pgc);
+        import_->single(waypoint);
       } catch(Failure& f) {
-        QMessageBox::critical(this, tr("Error"), f.what());
-        delete pgc;
-        return;
+        importFailed(f.what());
       }
-      model_->addGeocache(pgc);
-      map_->setCaches(model_->geocaches());
-      map_->setCenter(*pgc->coord);
-      // also save in profile, like for region
-      g_settings->setCenter(*pgc->coord);
     }
   }
 }
 
+/**
+ * Show the progress of the running import
+ * @see GCImport::progress()
+ */
+void MainWindow::importProgress(int done, int total, const QString& text) {
+  importDialog_->setMaximum(total);
+  importDialog_->setValue(done);
+  importDialog_->setLabelText(text);
+}
+
+/**
+ * Called when the running import has parsed a block of geocaches. They are
+ * written by the database thread, and the map shows them when they are
+ * saved. The import is told how many are still waiting for the database.
+ * @param geocaches The parsed geocaches; the model keeps its own copies
+ */
+void MainWindow::importGeocaches(const QVector<Geocache>& geocaches,
+  const QVector<FetchRecord>& records) {
+  model_->addGeocaches(geocaches, records);
+  import_->setWriteBacklog(model_->savingCount());
+}
+
+/**
+ * Called when the model has written geocaches. The running import continues
+ * if it waited for the database.
+ */
+void MainWindow::geocachesSaved() {
+  if(import_) {
+    import_->setWriteBacklog(model_->savingCount());
+  }
+}
+
+/**
+ * Called when the model could not write geocaches. A running import is
+ * stopped, as its next geocaches would likely fail the same way, and reports
+ * the error once; otherwise the error is shown here.
+ * @param message Error message
+ */
+void MainWindow::geocachesSaveFailed(const QString& message) {
+  if(import_ && import_->running()) {
+    import_->abort(message);
+  } else {
+    geocachesSaved();
+    databaseFailure(message);
+  }
+}
+
+/**
+ * Called when the running import is complete or aborted. The geocaches and
+ * their fetch records are already handed to the model, so the import is
+ * freed.
+ */
+void MainWindow::importFinished() {
+  freeImport();
+}
+
+/**
+ * Free the running import and its progress dialog, and write the index of
+ * the page cache.
+ */
+void MainWindow::freeImport() {
+  import_->deleteLater();
+  import_ = 0;
+  importDialog_->close();
+  importDialog_->deleteLater();
+  importDialog_ = 0;
+  try {
+    pageCache_->save();
+  } catch(Failure& f) {
+    qDebug() << f.what();
+  }
+}
+
+/**
+ * Called when the running import stopped because of an error. The geocaches
+ * loaded so far are kept.
+ * @param message Error message
+ */
+void MainWindow::importFailed(const QString& message) {
+  importFinished();
+  QMessageBox::critical(this, tr("Error"), message);
+}
+
+/** Called when the import of a single geocache is complete */
+void MainWindow::singleImported() {
+  const ImportBatch& batch = import_->batch();
+  if(batch.size() > 0) {
+    Coordinate coord = batch.geocaches().first().coord;
+    map_->setCenter(coord);
+    // also save in profile, like for region
+    g_settings->setCenter(coord);
+  }
+  importFinished();
+}
+
+/**
+ * Called when the user clicks on the Geocaches->Re-parse cached pages menu
+ * item. All pages in the page cache are parsed again and saved, without
+ * network access.
+ */
+void MainWindow::replayPageCache() {
+  if(import_) {
+    return;
+  }
+  if(pageCache_->size() == 0) {
+    QMessageBox::information(this, tr("Re-parse cached pages"),
+      tr("There are no cached geocache pages."));
+    return;
+  }
+  createImport(GCSpider::instance(), SLOT(replayFinished()),
+    SLOT(replayFailed(const QString&)));
+  try {
+    import_->replay();
+  } catch(Failure& f) {
+    replayFailed(f.what());
+  }
+}
+
+/**
+ * Called when the cached pages were parsed again. The pages were not
+ * fetched now, so no fetch records are saved.
+ */
+void MainWindow::replayFinished() {
+  freeImport();
+}
+
+/**
+ * Called when parsing the cached pages again stopped because of an error.
+ * Like @a replayFinished(), no fetch records are saved.
+ * @param message Error message
+ */
+void MainWindow::replayFailed(const QString& message) {
+  replayFinished();
+  QMessageBox::critical(this, tr("Error"), message);
+}
+
 /**
  * show the specified bookmark in the map
  * @param index Index of bookmark, or @c -1 for home coordinates
@@ -221,6 +435,9 @@ void MainWindow::setupActions() {
   importGCSingleAction_ = new QAction(tr("Import &single..."), this);
   connect(importGCSingleAction_, SIGNAL(triggered()), SLOT(importGCSingle()));
 
+  replayAction_ = new QAction(tr("Re-&parse cached pages"), this);
+  connect(replayAction_, SIGNAL(triggered()), SLOT(replayPageCache()));
+
   mainViewActionGroup_ = new QActionGroup(this);
 
   mapViewAction_ = new QAction(tr("&Map"), mainViewActionGroup_);
@@ -233,6 +450,11 @@ void MainWindow::setupActions() {
   detailViewAction_->setCheckable(true);
   connect(detailViewAction_, SIGNAL(triggered()), SLOT(detailView()));
 
+  listViewAction_ = new QAction(tr("Geocache &list"), mainViewActionGroup_);
+  listViewAction_->setShortcut(Qt::ALT | Qt::Key_3);
+  listViewAction_->setCheckable(true);
+  connect(listViewAction_, SIGNAL(triggered()), SLOT(listView()));
+
   // wire Go To actions up to just on function which does essentially the same
   // for other bookmarks too
   gotoSignalMap_ = new QSignalMapper(this);
@@ -246,6 +468,23 @@ void MainWindow::setupActions() {
   connect(aboutAction_, SIGNAL(triggered()), SLOT(about()));
 }
 
+/** setup the search box and the list of search results */
+void MainWindow::setupSearch() {
+  searchEdit_ = new QLineEdit;
+  searchEdit_->setToolTip(tr("Search geocaches by name, owner, description, "
+    "hint and logs"));
+  connect(searchEdit_, SIGNAL(returnPressed()), SLOT(search()));
+
+  QToolBar * searchBar = addToolBar(tr("Search"));
+  searchBar->addWidget(new QLabel(tr("Search:")));
+  searchBar->addWidget(searchEdit_);
+
+  searchResults_ = new QListWidget;
+  connect(searchResults_, SIGNAL(itemActivated(QListWidgetItem *)),
+    SLOT(searchResultActivated(QListWidgetItem *)));
+  stack_->addWidget(searchResults_);
+}
+
 /** setup the menu by inserting actions */
 void MainWindow::setupMenu() {
   QMenu * appMenu = menuBar()->addMenu(tr("&Application"));
@@ -255,10 +494,12 @@ void MainWindow::setupMenu() {
   QMenu * geocacheMenu = menuBar()->addMenu(tr("&Geocaches"));
   geocacheMenu->addAction(importGCRegionAction_);
   geocacheMenu->addAction(importGCSingleAction_);
+  geocacheMenu->addAction(replayAction_);
 
   QMenu * viewMenu = menuBar()->addMenu(tr("&View"));
   viewMenu->addAction(mapViewAction_);
   viewMenu->addAction(detailViewAction_);
+  viewMenu->addAction(listViewAction_);
 
   QMenu * gotoMenu = menuBar()->addMenu(tr("&Places"));
   gotoMenu->addAction(gotoHomeAction_);
@@ -342,3 +583,65 @@ void MainWindow::detailView() {
   stack_->setCurrentWidget(infoPane_);
   detailViewAction_->setChecked(true);
 }
+
+/** display the list of all geocaches */
+void MainWindow::listView() {
+  stack_->setCurrentWidget(listPane_);
+  listViewAction_->setChecked(true);
+}
+
+/** Called when the user selects a geocache in the list, shows its details */
+void MainWindow::geocacheActivated(const QModelIndex& index) {
+  infoPane_->setGeocache(index.data(GeocacheModel::WaypointRole).toString());
+  detailView();
+}
+
+/** Called when the user enters a search term, shows the results */
+void MainWindow::search() {
+  static const int MAX_RESULTS = 100;
+
+  QVector<SearchResult> results;
+  try {
+    results = model_->search(searchEdit_->text(), MAX_RESULTS);
+  } catch(Failure& f) {
+    QMessageBox::critical(this, tr("Error"), f.what());
+    return;
+  }
+
+  searchResults_->clear();
+  foreach(const SearchResult& result, results) {
+    QListWidgetItem * item = new QListWidgetItem(geocacheIcon(
+      static_cast<WaypointType>(result.summary.type)), result.name + " (" +
+      result.summary.waypointString() + ")", searchResults_);
+    item->setData(Qt::UserRole, result.summary.waypointString());
+  }
+  if(results.isEmpty()) {
+    searchResults_->addItem(tr("No geocaches found"));
+  }
+  stack_->setCurrentWidget(searchResults_);
+}
+
+/** Called when the user selects a search result, shows its details */
+void MainWindow::searchResultActivated(QListWidgetItem * item) {
+  QString waypoint = item->data(Qt::UserRole).toString();
+  if(!waypoint.isEmpty()) {
+    infoPane_->setGeocache(waypoint);
+    detailView();
+  }
+}
+
+/** Called when the database thread reports an error */
+void MainWindow::databaseFailure(const QString& message) {
+  QMessageBox::critical(this, "Failure", message);
+}
+
+/** Called while the database thread upgrades an older database */
+void MainWindow::databaseUpgrading(int version, int done, int total) {
+  if(total > 0) {
+    statusBar()->showMessage(tr("Upgrading database to version %1: %2 of %3 "
+      "entries").arg(version).arg(done).arg(total));
+  } else {
+    statusBar()->showMessage(tr("Upgrading database to version %1...").
+      arg(version));
+  }
+}
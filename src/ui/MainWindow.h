@@ -22,6 +22,8 @@
 
 #include "logic/GeocacheModel.h"
 #include "import/GCSpider.h"
+#include "import/GCImport.h"
+#include "import/PageCache.h"
 #include "ui/OsmSlippyMap.h"
 #include "ui/GeocacheInfoWidget.h"
 #include <QObject>
@@ -34,26 +36,52 @@ class MainWindow : public QMainWindow {
 public:
   MainWindow();
   virtual ~MainWindow();
-  GCSpider * validateLogin();
+  GCSpider * validateLogin(QAction * retry);
 
 protected:
   void setupActions();
   void setupMenu();
+  void setupSearch();
+  GCImport * createImport(GCSpider * spider, const char * finishedSlot,
+    const char * failedSlot = SLOT(importFailed(const QString&)));
+  void freeImport();
 
 protected slots:
   int showPrefDialog();
   void importGCRegion();
   void importGCSingle();
+  void importProgress(int done, int total, const QString& text);
+  void importGeocaches(const QVector<geojackal::Geocache>& geocaches,
+    const QVector<geojackal::FetchRecord>& records);
+  void geocachesSaved();
+  void geocachesSaveFailed(const QString& message);
+  void importFinished();
+  void importFailed(const QString& message);
+  void singleImported();
+  void replayPageCache();
+  void replayFinished();
+  void replayFailed(const QString& message);
+  void loginSucceeded();
+  void loginFailed(const QString& message);
   void about();
   void mapView();
   void detailView();
+  void listView();
   void gotoBookmark(int index = -1);
+  void databaseFailure(const QString& message);
+  void databaseUpgrading(int version, int done, int total);
+  void search();
+  void searchResultActivated(QListWidgetItem * item);
+  void geocacheActivated(const QModelIndex& index);
 
 private:
   QStackedWidget * stack_;
   OsmSlippyMap * map_;
   GeocacheInfoWidget * infoPane_;
+  QListView * listPane_;
   GeocacheModel * model_;
+  QLineEdit * searchEdit_;
+  QListWidget * searchResults_;
 
   QAction * aboutAction_;
   QAction * exitAction_;
@@ -62,10 +90,21 @@ private:
   QAction * importGCSingleAction_;
   QAction * detailViewAction_;
   QAction * mapViewAction_;
+  QAction * listViewAction_;
   QAction * gotoHomeAction_;
   QSignalMapper * gotoSignalMap_;
 
   QActionGroup * mainViewActionGroup_;
+
+  /** The running import, or @c 0 */
+  GCImport * import_;
+  /** Shows the progress of the running import */
+  QProgressDialog * importDialog_;
+  /** Action that is triggered again when the pending login succeeded */
+  QAction * loginAction_;
+  /** Raw geocache pages of the imports */
+  PageCache * pageCache_;
+  QAction * replayAction_;
 };
 
 }
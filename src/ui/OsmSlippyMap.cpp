@@ -26,6 +26,9 @@ using namespace geojackal;
 
 const ushort OsmSlippyMap::TILE_DIM = 256;
 const uchar OsmSlippyMap::MAX_ZOOM = 16;
+const uchar OsmSlippyMap::MIN_GEOCACHE_ZOOM = 10;
+const int OsmSlippyMap::PAGE_MARGIN = 2;
+const int OsmSlippyMap::LEFT_CACHE_SIZE = 5000;
 
 const QPoint OsmSlippyMap::zoomButtonTopLeft(3, 3);
 const uint OsmSlippyMap::zoomButtonSize = 15;
@@ -94,7 +97,8 @@ Coordinate geojackal::tileToGeo(const QPointF tile, const uchar zoom) {
 OsmSlippyMap::OsmSlippyMap(QWidget * parent, const Coordinate& center,
   const uchar zoom, const QDir& cacheDir) :
   QWidget(parent), pnam_(0), cacheDir_(cacheDir), zoomLevel_(zoom),
-  drawZoomButtons_(true), center_(center) {
+  drawZoomButtons_(true), center_(center), model_(0), pagedZoom_(0),
+  pagedRequest_(0), pagedReceived_(false), leftGeocaches_(LEFT_CACHE_SIZE) {
 
   // set up sizes and so on
   setMinimumSize(140, 140);
@@ -171,6 +175,246 @@ void OsmSlippyMap::invalidate() {
       tilePixmaps_.remove(p);
     }
   }
+
+  pageGeocaches();
+  update();
+}
+
+/**
+ * @internal
+ * Ask the model for the geocaches in the visible area plus a margin of
+ * @a PAGE_MARGIN tiles. Nothing is done as long as the visible area stays
+ * inside the area that was loaded last time. Geocaches that leave the area
+ * are kept in a cache of @a LEFT_CACHE_SIZE entries, so the memory of the map
+ * does not grow with the database.
+ * @param force Reload the geocaches even if the visible area has not left the
+ *  loaded area
+ */
+void OsmSlippyMap::pageGeocaches(bool force) {
+  if(force) {
+    leftGeocaches_.clear(); // may be from another database
+  }
+  if(!model_ || zoomLevel_ < MIN_GEOCACHE_ZOOM) {
+    // too many geocaches to show on a world map
+    foreach(const GeocacheSummary& summary, geocacheList) {
+      leaveArea(summary);
+    }
+    setGeocaches(QVector<GeocacheSummary>());
+    pagedTiles_ = QRect();
+    pagedRequest_ = 0;
+    return;
+  }
+  if(!force && zoomLevel_ == pagedZoom_ && pagedTiles_.contains(shownTiles_)) {
+    return;
+  }
+
+  pagedTiles_ = shownTiles_.adjusted(-PAGE_MARGIN, -PAGE_MARGIN, PAGE_MARGIN,
+    PAGE_MARGIN);
+  pagedZoom_ = zoomLevel_;
+  pagedNorthWest_ = tileToGeo(pagedTiles_.topLeft(), zoomLevel_);
+  pagedSouthEast_ = tileToGeo(QPointF(pagedTiles_.right() + 1,
+    pagedTiles_.bottom() + 1), zoomLevel_);
+
+  // until the first results arrive, which are the ones nearest to the center,
+  // show the old geocaches that are still in the area and those that come
+  // back into it
+  QVector<GeocacheSummary> shown;
+  foreach(const GeocacheSummary& summary, geocacheList) {
+    if(inPagedArea(summary)) {
+      shown.append(summary);
+    } else {
+      leaveArea(summary);
+    }
+  }
+  foreach(const QString& waypoint, leftGeocaches_.keys()) {
+    if(inPagedArea(*leftGeocaches_.object(waypoint))) {
+      GeocacheSummary * summary = leftGeocaches_.take(waypoint);
+      shown.append(*summary);
+      delete summary;
+    }
+  }
+  setGeocaches(shown);
+
+  pagedRequest_ = model_->requestGeocachesInRect(Coordinate(
+    pagedSouthEast_.lat, pagedNorthWest_.lon), Coordinate(pagedNorthWest_.lat,
+    pagedSouthEast_.lon), center_);
+  pagedReceived_ = false;
+}
+
+/**
+ * @internal
+ * Keep a geocache that left the loaded area, the least recently left ones are
+ * dropped when there are more than @a LEFT_CACHE_SIZE
+ */
+void OsmSlippyMap::leaveArea(const GeocacheSummary& summary) {
+  leftGeocaches_.insert(summary.waypointString(),
+    new GeocacheSummary(summary));
+}
+
+/**
+ * @internal
+ * Replace the loaded geocaches
+ */
+void OsmSlippyMap::setGeocaches(const QVector<GeocacheSummary>& geocaches) {
+  geocacheList = geocaches;
+  geocacheIndex_.clear();
+  for(int i = 0; i < geocacheList.size(); ++i) {
+    geocacheIndex_.insert(geocacheList[i].waypointString(), i);
+  }
+}
+
+/**
+ * @internal
+ * Add a geocache to the loaded geocaches, or replace it if it is loaded
+ */
+void OsmSlippyMap::showGeocache(const GeocacheSummary& summary) {
+  QString waypoint = summary.waypointString();
+  QHash<QString, int>::const_iterator it = geocacheIndex_.find(waypoint);
+  if(it != geocacheIndex_.constEnd()) {
+    geocacheList[*it] = summary;
+  } else {
+    geocacheIndex_.insert(waypoint, geocacheList.size());
+    geocacheList.append(summary);
+  }
+}
+
+/**
+ * @internal
+ * Remove a loaded geocache. The last one takes its place, so the order of
+ * @a geocacheList is not kept.
+ * @param i Index of the geocache in @a geocacheList
+ */
+void OsmSlippyMap::hideGeocache(int i) {
+  geocacheIndex_.remove(geocacheList[i].waypointString());
+  int last = geocacheList.size() - 1;
+  if(i != last) {
+    geocacheList[i] = geocacheList[last];
+    geocacheIndex_.insert(geocacheList[i].waypointString(), i);
+  }
+  geocacheList.remove(last);
+}
+
+/**
+ * @internal
+ * Called for every batch of geocaches the model delivers. Batches of older
+ * requests are dropped, so the map draws what it has while the rest is
+ * still loading.
+ */
+void OsmSlippyMap::geocachesLoaded(int request,
+  const QVector<GeocacheSummary>& batch) {
+  if(request != pagedRequest_) {
+    return;
+  }
+  if(!pagedReceived_) {
+    setGeocaches(batch);
+    pagedReceived_ = true;
+  } else {
+    foreach(const GeocacheSummary& summary, batch) {
+      showGeocache(summary);
+    }
+  }
+  update();
+}
+
+/**
+ * @internal
+ * Called when the model has delivered all geocaches of a request
+ */
+void OsmSlippyMap::requestFinished(int request) {
+  if(request == pagedRequest_ && !pagedReceived_) {
+    setGeocaches(QVector<GeocacheSummary>()); // no geocaches in this area
+    update();
+  }
+}
+
+/**
+ * @internal
+ * Called when geocaches were added to the model
+ */
+void OsmSlippyMap::geocachesInserted(const QModelIndex&, int first, int last) {
+  updateGeocaches(first, last);
+}
+
+/**
+ * @internal
+ * Called when geocaches in the model were changed
+ */
+void OsmSlippyMap::geocachesChanged(const QModelIndex& topLeft,
+  const QModelIndex& bottomRight) {
+  updateGeocaches(topLeft.row(), bottomRight.row());
+}
+
+/**
+ * @internal
+ * Update the loaded geocaches from some rows of the model. Geocaches that are
+ * in the loaded area are added or replaced, and those that moved out of it
+ * are moved to the cache of left geocaches, so the area does not need to be
+ * loaded again.
+ * @param first First row of the model
+ * @param last Last row of the model
+ */
+void OsmSlippyMap::updateGeocaches(int first, int last) {
+  if(!model_ || pagedTiles_.isNull()) {
+    return;
+  }
+
+  bool changed = false;
+  for(int row = first; row <= last; ++row) {
+    const GeocacheSummary& summary = model_->summary(row);
+    bool inside = inPagedArea(summary);
+    if(inside) {
+      delete leftGeocaches_.take(summary.waypointString());
+    } else if(leftGeocaches_.contains(summary.waypointString())) {
+      leaveArea(summary);
+    }
+    int i = geocacheIndex_.value(summary.waypointString(), -1);
+    if(inside) {
+      showGeocache(summary);
+      changed = true;
+    } else if(i >= 0) {
+      hideGeocache(i);
+      leaveArea(summary);
+      changed = true;
+    }
+  }
+  if(changed) {
+    update();
+  }
+}
+
+/**
+ * Set the model from which the geocaches are loaded. The map only asks the
+ * model for the geocaches in the visible area plus a margin, and reloads them
+ * when the model has been opened. Saved geocaches are taken from the changed
+ * rows of the model.
+ * @param model The geocache model, or @c 0 to show no geocaches
+ */
+void OsmSlippyMap::setModel(GeocacheModel * model) {
+  if(model_) {
+    disconnect(model_, 0, this, 0);
+  }
+  model_ = model;
+  if(model_) {
+    connect(model_, SIGNAL(geocachesLoaded(int,
+      const QVector<geojackal::GeocacheSummary>&)), SLOT(geocachesLoaded(int,
+      const QVector<geojackal::GeocacheSummary>&)));
+    connect(model_, SIGNAL(requestFinished(int)), SLOT(requestFinished(int)));
+    connect(model_, SIGNAL(opened(bool)), SLOT(reloadCaches()));
+    connect(model_, SIGNAL(rowsInserted(const QModelIndex&, int, int)),
+      SLOT(geocachesInserted(const QModelIndex&, int, int)));
+    connect(model_, SIGNAL(dataChanged(const QModelIndex&,
+      const QModelIndex&)), SLOT(geocachesChanged(const QModelIndex&,
+      const QModelIndex&)));
+  }
+  reloadCaches();
+}
+
+/**
+ * Reload the geocaches in the visible area from the model, e.&nbsp;g. after
+ * geocaches have been added to the model.
+ */
+void OsmSlippyMap::reloadCaches() {
+  pageGeocaches(true);
   update();
 }
 
@@ -232,10 +476,16 @@ QPoint OsmSlippyMap::tileToPixel(const QPoint& tileCoord) {
   return QPoint(x, y);
 }
 
-/** return the icon for a geocache */
-QPixmap geojackal::geocacheIcon(Geocache * geocache) {
+/** return the icon for a geocache type */
+QPixmap geojackal::geocacheIcon(WaypointType type) {
+  // icons are drawn for every geocache on every repaint, so keep them
+  static QHash<int, QPixmap> icons;
+  if(icons.contains(type)) {
+    return icons.value(type);
+  }
+
   QString fileName;
-  switch(geocache->type) {
+  switch(type) {
     case TYPE_TRADI: fileName = "tradi.gif"; break;
     case TYPE_MULTI: fileName = "multi.gif"; break;
     case TYPE_MYSTERY: fileName = "mystery.gif"; break;
@@ -261,7 +511,10 @@ QPixmap geojackal::geocacheIcon(Geocache * geocache) {
   }
   QImage icon;
   icon.load(":/cachetype/" + fileName);
-  return QPixmap::fromImage(icon.scaledToWidth(24, Qt::SmoothTransformation));
+  QPixmap pixmap = QPixmap::fromImage(icon.scaledToWidth(24,
+    Qt::SmoothTransformation));
+  icons.insert(type, pixmap);
+  return pixmap;
 }
 
 /** from QWidget */
@@ -287,16 +540,17 @@ void OsmSlippyMap::paintEvent(QPaintEvent * event) {
 
   // draw geocache icons
   geocacheRects.clear(); // or we get bogus positions after zooming etc.
-  foreach(Geocache * gc, geocacheList) {
-    QPixmap icon = geocacheIcon(gc).scaled(24, 24, Qt::KeepAspectRatio);
-    QPointF tileCoordF = geoToTile(*gc->coord, zoomLevel_);
+  foreach(const GeocacheSummary& gc, geocacheList) {
+    QPixmap icon = geocacheIcon(static_cast<WaypointType>(gc.type)).
+      scaled(24, 24, Qt::KeepAspectRatio);
+    QPointF tileCoordF = geoToTile(gc.coord(), zoomLevel_);
     QPointF t = tileCoordF - shownTiles_.topLeft();
     // FIXME we need a k-d-tree here
     int x = (int) (t.x() * TILE_DIM + offset_.x());
     int y = (int) (t.y() * TILE_DIM + offset_.y());
     QRect target(QPoint(x, y), QSize(24, 24));
     target.adjust(-12, -12, -12, -12);
-    geocacheRects[target] = gc; // save for later
+    geocacheRects[target] = gc.waypointString(); // save for later
     p.drawPixmap(target, icon);
   }
 
@@ -365,7 +619,7 @@ void OsmSlippyMap::mousePressEvent(QMouseEvent * event) {
     foreach(QRect gcr, geocacheRects.keys()) {
       qDebug() << gcr << "?contains?" << event->pos();
       if(gcr.contains(event->pos())) {
-        qDebug() << "you clicked on" << geocacheRects.value(gcr)->name;
+        qDebug() << "you clicked on" << geocacheRects.value(gcr);
         emit clicked(geocacheRects.value(gcr));
         event->accept(); // only do it the first time
         return;
@@ -24,8 +24,10 @@
 #include "global.h"
 #include "logic/Coordinate.h"
 #include "logic/Geocache.h"
+#include "logic/GeocacheModel.h"
 #include <QtGui>
 #include <QList>
+#include <QCache>
 #include <QtNetwork>
 
 namespace geojackal {
@@ -45,6 +47,12 @@ public:
   static const ushort TILE_DIM;
   /** Maximum zoom level (in OSM zoom level units...) */
   static const uchar MAX_ZOOM;
+  /** Minimum zoom level on which geocaches are shown */
+  static const uchar MIN_GEOCACHE_ZOOM;
+  /** Margin around the visible tiles whose geocaches are loaded, in tiles */
+  static const int PAGE_MARGIN;
+  /** Number of geocaches kept after they left the loaded area */
+  static const int LEFT_CACHE_SIZE;
 
   OsmSlippyMap(QWidget * parent = 0, const Coordinate& center = COORD_INVALID,
     const uchar zoom = 16,
@@ -120,16 +128,17 @@ public:
     return cacheDir_;
   }
 
-  void setCaches(QList<Geocache *> geocaches) {
-    geocacheList = geocaches;
-  }
+  void setModel(GeocacheModel * model);
+
+public slots:
+  void reloadCaches();
 
 signals:
   /**
    * Emitted if the user clicks on a geocache icon
-   * @param gc The geocache the user clicked on
+   * @param waypoint The waypoint of the geocache the user clicked on
    */
-  void clicked(Geocache * gc);
+  void clicked(const QString& waypoint);
   /**
    * Emitted if the center has changed, particularly when the user has dragged
    * the map.
@@ -140,6 +149,19 @@ signals:
 protected:
   void download(const uint xTile, const uint yTile);
   void invalidate();
+  void pageGeocaches(bool force = false);
+  void leaveArea(const GeocacheSummary& summary);
+  void setGeocaches(const QVector<GeocacheSummary>& geocaches);
+  void showGeocache(const GeocacheSummary& summary);
+  void hideGeocache(int i);
+  /** @return @c true if a geocache is inside the loaded area */
+  inline bool inPagedArea(const GeocacheSummary& summary) const {
+    return summary.lat <= pagedNorthWest_.lat &&
+      summary.lat >= pagedSouthEast_.lat &&
+      summary.lon >= pagedNorthWest_.lon &&
+      summary.lon <= pagedSouthEast_.lon;
+  }
+  void updateGeocaches(int first, int last);
   QPoint tileToPixel(const QPoint& tileCoord);
 
   virtual void paintEvent(QPaintEvent *event);
@@ -152,6 +174,12 @@ protected:
 
 protected slots:
   void httpFinished(QNetworkReply * reply);
+  void geocachesLoaded(int request,
+    const QVector<geojackal::GeocacheSummary>& batch);
+  void requestFinished(int request);
+  void geocachesInserted(const QModelIndex& parent, int first, int last);
+  void geocachesChanged(const QModelIndex& topLeft,
+    const QModelIndex& bottomRight);
 
 private:
   /**
@@ -185,12 +213,34 @@ private:
   /** Horizontal padding between the zoom buttons, in pixels */
   static const uint zoomButtonPadding;
 
-  /** List of geocaches */
-  QList<Geocache *> geocacheList;
-  QHash<QRect, Geocache *> geocacheRects;
+  /** Model from which the geocaches are loaded */
+  GeocacheModel * model_;
+  /** Tile area whose geocaches are currently loaded */
+  QRect pagedTiles_;
+  /** Zoom level on which @a pagedTiles_ was calculated */
+  uchar pagedZoom_;
+  /** North-western corner of @a pagedTiles_ */
+  Coordinate pagedNorthWest_;
+  /** South-eastern corner of @a pagedTiles_ */
+  Coordinate pagedSouthEast_;
+  /** Model request for the geocaches in @a pagedTiles_ */
+  int pagedRequest_;
+  /** Whether results of @a pagedRequest_ have arrived yet */
+  bool pagedReceived_;
+  /** Summaries of the geocaches in the loaded area */
+  QVector<GeocacheSummary> geocacheList;
+  /** Index of each geocache in @a geocacheList, by waypoint */
+  QHash<QString, int> geocacheIndex_;
+  /**
+   * Geocaches that left the loaded area, by waypoint. They are shown again
+   * at once when the area comes back into view, until the model answers.
+   */
+  QCache<QString, GeocacheSummary> leftGeocaches_;
+  /** Icon positions of the drawn geocaches, and their waypoints */
+  QHash<QRect, QString> geocacheRects;
 };
 
-QPixmap geocacheIcon(Geocache * geocache);
+QPixmap geocacheIcon(WaypointType type);
 QPointF geoToTile(const Coordinate& coord, const uchar zoom);
 Coordinate tileToGeo(const QPointF tile, const uchar zoom);
 
@@ -84,7 +84,7 @@ void PrefGeneralPage::updateCenter(Coordinate& newCoord) {
  * Set up the Import page of the Preferences dialog
  */
 PrefImportPage::PrefImportPage(QWidget * parent) :
-  QWidget(parent), userNameEdit(0), passwordEdit(0) {
+  QWidget(parent), userNameEdit(0), passwordEdit(0), verifyButton(0) {
 
   QVBoxLayout * mainLayout = new QVBoxLayout;
   QFormLayout * loginBoxLayout = new QFormLayout;
@@ -104,7 +104,7 @@ PrefImportPage::PrefImportPage(QWidget * parent) :
   passwordEdit->setText(g_settings->gcPassword());
   loginBoxLayout->addRow(tr("&Password:"), passwordEdit);
 
-  QPushButton * verifyButton = new QPushButton(tr("&Test login"), this);
+  verifyButton = new QPushButton(tr("&Test login"), this);
   connect(verifyButton, SIGNAL(clicked()), this, SLOT(verifyLogin()));
   loginBoxLayout->addRow(verifyButton);
 
@@ -125,21 +125,37 @@ void PrefImportPage::verifyLogin() {
   QString userName = userNameEdit->text();
   QString password = passwordEdit->text();
 
-  // validate user data
+  // validate user data, the result comes in loginSucceeded() or loginFailed()
+  GCSpider * spider = GCSpider::instance();
+  connect(spider, SIGNAL(loginSucceeded()), this, SLOT(loginSucceeded()));
+  connect(spider, SIGNAL(loginFailed(const QString&)), this,
+    SLOT(loginFailed(const QString&)));
+  verifyButton->setEnabled(false);
   try {
-    GCSpider::login(userName, password);
+    spider->login(userName, password);
   } catch(Failure& f) {
-    QMessageBox::critical(this, "Error", tr("There was an error while trying "
-      "to log in to geocaching.com. Maybe the user name or password you "
-      "supplied is wrong.\n\nPlease fill in the correct values and try again."
-      "\n\nThe message was: ") + f.what());
-    return;
+    loginFailed(f.what());
   }
-  // else: login ok
+}
+
+/** called when the login started by verifyLogin() succeeded */
+void PrefImportPage::loginSucceeded() {
+  GCSpider::instance()->disconnect(this);
+  verifyButton->setEnabled(true);
   QMessageBox::information(this, "Success", tr("The login to "
     "geocaching.com was successful."));
 }
 
+/** called when the login started by verifyLogin() failed */
+void PrefImportPage::loginFailed(const QString& message) {
+  GCSpider::instance()->disconnect(this);
+  verifyButton->setEnabled(true);
+  QMessageBox::critical(this, "Error", tr("There was an error while trying "
+    "to log in to geocaching.com. Maybe the user name or password you "
+    "supplied is wrong.\n\nPlease fill in the correct values and try again."
+    "\n\nThe message was: ") + message);
+}
+
 PrefDialog::PrefDialog(QWidget * parent) :
   QDialog(parent), generalPage(0), importPage(0) {
 
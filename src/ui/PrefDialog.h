@@ -47,9 +47,14 @@ public:
 public slots:
   void verifyLogin();
 
+protected slots:
+  void loginSucceeded();
+  void loginFailed(const QString& message);
+
 private:
   QLineEdit * userNameEdit;
   QLineEdit * passwordEdit;
+  QPushButton * verifyButton;
 };
 
 class PrefDialog : public QDialog {
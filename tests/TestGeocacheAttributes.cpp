@@ -0,0 +1,55 @@
+#include <logic/Geocache.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace geojackal;
+
+BOOST_AUTO_TEST_CASE(GeocacheAttributes_blob) {
+  GeocacheAttributes attrs;
+  attrs.insert(ATTR_AVAILABLE_NO);
+  attrs.insert(ATTR_DOGS_YES);
+  attrs.insert(ATTR_WATER_NO); // last bit of the lower half
+  attrs.insert(ATTR_WATER_YES); // first bit of the upper half
+  attrs.insert(ATTR_WINTER_YES);
+
+  QByteArray blob = attrs.toBlob();
+  BOOST_CHECK_EQUAL(blob.size(), GeocacheAttributes::BLOB_SIZE);
+  // each half in little endian byte order
+  BOOST_CHECK_EQUAL(static_cast<uchar>(blob.at(0)), 0x01);
+  BOOST_CHECK_EQUAL(static_cast<uchar>(blob.at(1)), 0x80);
+  BOOST_CHECK_EQUAL(static_cast<uchar>(blob.at(7)), 0x80);
+  BOOST_CHECK_EQUAL(static_cast<uchar>(blob.at(8)), 0x11);
+  BOOST_CHECK_EQUAL(static_cast<uchar>(blob.at(12)), 0x00);
+
+  GeocacheAttributes read = GeocacheAttributes::fromBlob(blob);
+  BOOST_CHECK(read == attrs);
+  BOOST_CHECK_EQUAL(read.toVector().size(), 5);
+
+  // the empty set is a blob of zeros, not an empty blob
+  BOOST_CHECK_EQUAL(GeocacheAttributes().toBlob().size(),
+    GeocacheAttributes::BLOB_SIZE);
+  BOOST_CHECK(GeocacheAttributes::fromBlob(GeocacheAttributes().toBlob()).
+    isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(GeocacheAttributes_legacyString) {
+  // older versions stored a '0' or a '1' for each attribute
+  QByteArray legacy(NUM_ATTRIBUTES, '0');
+  legacy[ATTR_BOAT] = '1';
+  legacy[ATTR_KIDS_YES] = '1';
+  legacy[ATTR_WINTER_YES] = '1';
+
+  GeocacheAttributes read = GeocacheAttributes::fromBlob(legacy);
+  QVector<GeocacheAttribute> expected;
+  expected << ATTR_BOAT << ATTR_KIDS_YES << ATTR_WINTER_YES;
+  BOOST_CHECK(read.toVector() == expected);
+
+  // written back in the new format
+  BOOST_CHECK(GeocacheAttributes::fromBlob(read.toBlob()) == read);
+}
+
+BOOST_AUTO_TEST_CASE(GeocacheAttributes_invalidBlob) {
+  BOOST_CHECK(GeocacheAttributes::fromBlob(QByteArray()).isEmpty());
+  BOOST_CHECK(GeocacheAttributes::fromBlob(QByteArray(5, '1')).isEmpty());
+  BOOST_CHECK(GeocacheAttributes::fromBlob(QByteArray(NUM_ATTRIBUTES + 1,
+    '1')).isEmpty());
+}
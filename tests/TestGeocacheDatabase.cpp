@@ -0,0 +1,332 @@
+#include <logic/GeocacheDatabase.h>
+#include <QTemporaryFile>
+#include <QDir>
+#include <boost/test/unit_test.hpp>
+
+using namespace geojackal;
+
+/** Database in a temporary file, which is removed afterwards */
+struct TemporaryDatabase {
+  QTemporaryFile file;
+  GeocacheDatabase db;
+
+  TemporaryDatabase() : file(QDir::tempPath() + "/geojackal-XXXXXX.sqlite"),
+    db("test") {
+    file.open(); // creates the file, so the name is reserved
+    file.close();
+  }
+};
+
+/** @return a geocache with all mandatory values set */
+static Geocache testGeocache(const QString& waypoint) {
+  Geocache geocache;
+  geocache.waypoint = waypoint;
+  geocache.name = "Wayward Drive!";
+  geocache.coord = Coordinate(52.2625, 10.5225);
+  geocache.type = TYPE_TRADI;
+  geocache.size = SIZE_SMALL;
+  geocache.difficulty = 3;
+  geocache.terrain = 4;
+  geocache.owner = "rohieb";
+  return geocache;
+}
+
+BOOST_FIXTURE_TEST_CASE(GeocacheDatabase_unsetDates, TemporaryDatabase) {
+  BOOST_REQUIRE(db.open(file.fileName()));
+
+  // the spider never knows when a geocache was found
+  QVector<Geocache> geocaches;
+  geocaches << testGeocache("GC1Q743") << testGeocache("GC2ABCD");
+  geocaches[0].placed = QDate(2009, 5, 17);
+  BOOST_REQUIRE_NO_THROW(db.save(geocaches));
+
+  Geocache * loaded = db.geocache("GC1Q743");
+  BOOST_REQUIRE(loaded);
+  BOOST_CHECK(loaded->placed == QDate(2009, 5, 17));
+  BOOST_CHECK(loaded->found.isNull());
+  delete loaded;
+
+  loaded = db.geocache("GC2ABCD");
+  BOOST_REQUIRE(loaded);
+  BOOST_CHECK(loaded->placed.isNull());
+  BOOST_CHECK(loaded->found.isNull());
+  delete loaded;
+}
+
+BOOST_FIXTURE_TEST_CASE(GeocacheDatabase_sameDayLogs, TemporaryDatabase) {
+  BOOST_REQUIRE(db.open(file.fileName()));
+
+  // two notes of the same author on the same day, one without identifier
+  LogMessage note;
+  note.author = "rohieb";
+  note.type = LOG_NOTE;
+  note.date = QDate(2010, 7, 9);
+  note.msg = CompressedText("Replaced the logbook.");
+  QVector<Geocache> geocaches;
+  geocaches << testGeocache("GC1Q743");
+  geocaches[0].logs << note;
+  note.id = "1bd4d2f5-3bb8-4c53-a6a4-bd0e86bf5a41";
+  note.msg = CompressedText("Container is wet again.");
+  geocaches[0].logs << note;
+  BOOST_REQUIRE_NO_THROW(db.save(geocaches));
+  // saving again merges the logs instead of adding them twice
+  BOOST_REQUIRE_NO_THROW(db.save(geocaches));
+
+  QVector<LogMessage> logs = db.logs("GC1Q743", 10);
+  BOOST_REQUIRE_EQUAL(logs.size(), 2);
+  QStringList messages;
+  foreach(const LogMessage& log, logs) {
+    messages << log.msg.toString();
+  }
+  BOOST_CHECK(messages.contains("Replaced the logbook."));
+  BOOST_CHECK(messages.contains("Container is wet again."));
+
+  // a log that is imported again with its identifier takes over the row
+  geocaches[0].logs[0].id = "0e3fd0cd-3bd3-4b8b-8b4d-8f1e3dd1ab58";
+  BOOST_REQUIRE_NO_THROW(db.save(geocaches));
+  BOOST_CHECK_EQUAL(db.logCount("GC1Q743"), 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(GeocacheDatabase_legacyAttributes, TemporaryDatabase) {
+  BOOST_REQUIRE(db.open(file.fileName()));
+  QVector<Geocache> geocaches;
+  geocaches << testGeocache("GC1Q743");
+  BOOST_REQUIRE_NO_THROW(db.save(geocaches));
+
+  // a row as older versions wrote it
+  QByteArray legacy(NUM_ATTRIBUTES, '0');
+  legacy[ATTR_DOGS_YES] = '1';
+  legacy[ATTR_WINTER_YES] = '1';
+  QSqlQuery query(db.database());
+  query.prepare("UPDATE geocaches SET attrs = :attrs");
+  query.bindValue(":attrs", QString::fromLatin1(legacy));
+  BOOST_REQUIRE(query.exec());
+
+  Geocache * loaded = db.geocache("GC1Q743");
+  BOOST_REQUIRE(loaded);
+  BOOST_CHECK(loaded->attrs.contains(ATTR_DOGS_YES));
+  BOOST_CHECK(loaded->attrs.contains(ATTR_WINTER_YES));
+  BOOST_CHECK_EQUAL(loaded->attrs.toVector().size(), 2);
+
+  AttributeIndex index;
+  db.loadAttributes(index);
+  GeocacheAttributes dogs;
+  dogs.insert(ATTR_DOGS_YES);
+  BOOST_CHECK(index.filter(dogs) == QStringList("GC1Q743"));
+
+  // the next save converts the row
+  geocaches[0] = *loaded;
+  delete loaded;
+  BOOST_REQUIRE_NO_THROW(db.save(geocaches));
+  BOOST_REQUIRE(query.exec("SELECT attrs FROM geocaches") && query.next());
+  BOOST_CHECK_EQUAL(query.value(0).toByteArray().size(),
+    GeocacheAttributes::BLOB_SIZE);
+}
+
+BOOST_FIXTURE_TEST_CASE(GeocacheDatabase_upgradeBaseline, TemporaryDatabase) {
+  // a database as written before schema versions were introduced, with the
+  // logs table of that time, which still had the author names in every row.
+  // Deleted geocaches leave gaps in the rowids, which the spatial and the
+  // search index must still match after the upgrade.
+  QStringList words;
+  words << "Alpha" << "Bravo" << "Charlie" << "Delta" << "Echo" << "Foxtrot";
+  {
+    QSqlDatabase old = QSqlDatabase::addDatabase("QSQLITE", "baseline");
+    old.setDatabaseName(file.fileName());
+    BOOST_REQUIRE(old.open());
+    QSqlQuery query(old);
+    BOOST_REQUIRE(query.exec("CREATE TABLE waypoints("
+      "waypoint TEXT PRIMARY KEY,"
+      "name TEXT NOT NULL,"
+      "lat REAL NOT NULL,"
+      "lon REAL NOT NULL,"
+      "type INTEGER NOT NULL,"
+      "desc TEXT"
+      ");"));
+    BOOST_REQUIRE(query.exec("CREATE TABLE geocaches("
+      "waypoint TEXT PRIMARY KEY "
+      "  REFERENCES waypoints(oid) ON DELETE CASCADE ON UPDATE CASCADE,"
+      "shortdesc TEXT,"
+      "size INT NOT NULL,"
+      "terrain INTEGER NOT NULL,"
+      "difficulty INTEGER NOT NULL,"
+      "placed INTEGER NOT NULL,"
+      "found INTEGER NOT NULL,"
+      "owner TEXT NOT NULL,"
+      "attrs BLOB NOT NULL,"
+      "hint TEXT,"
+      "archived INTEGER DEFAULT 0,"
+      "vote INT DEFAULT 0"
+      ");"));
+    BOOST_REQUIRE(query.exec("CREATE TABLE logs("
+      "id INTEGER PRIMARY KEY,"
+      "geocache TEXT NOT NULL,"
+      "date INTEGER NOT NULL DEFAULT 0,"
+      "author TEXT NOT NULL,"
+      "type INTEGER NOT NULL,"
+      "msg TEXT NOT NULL,"
+      "encrypted INTEGER NOT NULL DEFAULT 0"
+      ");"));
+
+    for(int i = 0; i < words.size(); ++i) {
+      BOOST_REQUIRE(query.exec(QString("INSERT INTO waypoints (waypoint, "
+        "name, lat, lon, type) VALUES ('GC%1', '%2', %3, %4, %5)").
+        arg(10001 + i).arg(words[i]).arg(40 + i).arg(20 + i).
+        arg(int(TYPE_TRADI))));
+      BOOST_REQUIRE(query.exec(QString("INSERT INTO geocaches (waypoint, "
+        "size, terrain, difficulty, placed, found, owner, attrs) "
+        "VALUES ('GC%1', %2, 2, 2, 0, 0, 'rohieb', '%3')").arg(10001 + i).
+        arg(int(SIZE_SMALL)).arg(QString(NUM_ATTRIBUTES, '0'))));
+    }
+    BOOST_REQUIRE(query.exec("DELETE FROM geocaches "
+      "WHERE waypoint IN ('GC10001', 'GC10003', 'GC10005')"));
+    BOOST_REQUIRE(query.exec("DELETE FROM waypoints "
+      "WHERE waypoint IN ('GC10001', 'GC10003', 'GC10005')"));
+
+    query.prepare("INSERT INTO waypoints (waypoint, name, lat, lon, type, "
+      "desc) VALUES (:waypoint, :name, :lat, :lon, :type, :desc)");
+    query.bindValue(":waypoint", "GC1Q743");
+    query.bindValue(":name", "Wayward Drive!");
+    query.bindValue(":lat", 52.2625);
+    query.bindValue(":lon", 10.5225);
+    query.bindValue(":type", int(TYPE_TRADI));
+    query.bindValue(":desc", "<p>Take the second exit.</p>");
+    BOOST_REQUIRE(query.exec());
+
+    QByteArray attrs(NUM_ATTRIBUTES, '0');
+    attrs[ATTR_DOGS_YES] = '1';
+    query.prepare("INSERT INTO geocaches (waypoint, shortdesc, size, terrain, "
+      "difficulty, placed, found, owner, attrs, hint, archived) "
+      "VALUES (:waypoint, :shortdesc, :size, :terrain, :difficulty, :placed, "
+      ":found, :owner, :attrs, :hint, :archived)");
+    query.bindValue(":waypoint", "GC1Q743");
+    query.bindValue(":shortdesc", "A drive-in");
+    query.bindValue(":size", int(SIZE_SMALL));
+    query.bindValue(":terrain", 4);
+    query.bindValue(":difficulty", 3);
+    query.bindValue(":placed",
+      QDateTime(QDate(2009, 5, 17)).toUTC().toTime_t());
+    query.bindValue(":found", 0);
+    query.bindValue(":owner", "rohieb");
+    query.bindValue(":attrs", QString::fromLatin1(attrs));
+    query.bindValue(":hint", "Under the bench");
+    query.bindValue(":archived", false);
+    BOOST_REQUIRE(query.exec());
+
+    query.prepare("INSERT INTO logs (geocache, date, author, type, msg) "
+      "VALUES (:geocache, :date, :author, :type, :msg)");
+    query.bindValue(":geocache", "GC1Q743");
+    query.bindValue(":date", QDateTime(QDate(2010, 7, 9)).toUTC().toTime_t());
+    query.bindValue(":author", "Dobby");
+    query.bindValue(":type", int(LOG_FOUND));
+    query.bindValue(":msg", "TFTC!");
+    BOOST_REQUIRE(query.exec());
+    old.close();
+  }
+  QSqlDatabase::removeDatabase("baseline");
+
+  BOOST_REQUIRE(db.open(file.fileName()));
+  QSqlQuery query(db.database());
+  BOOST_REQUIRE(query.exec("PRAGMA user_version") && query.next());
+  BOOST_CHECK_EQUAL(query.value(0).toInt(), GeocacheDatabase::SCHEMA_VERSION);
+
+  Geocache * loaded = db.geocache("GC1Q743");
+  BOOST_REQUIRE(loaded);
+  BOOST_CHECK(loaded->name == "Wayward Drive!");
+  BOOST_CHECK(loaded->type == TYPE_TRADI);
+  BOOST_CHECK(loaded->size == SIZE_SMALL);
+  BOOST_CHECK_EQUAL(loaded->difficulty, 3u);
+  BOOST_CHECK_EQUAL(loaded->terrain, 4u);
+  BOOST_CHECK(loaded->placed == QDate(2009, 5, 17));
+  BOOST_CHECK(loaded->found.isNull());
+  BOOST_CHECK(loaded->owner == "rohieb");
+  BOOST_CHECK(loaded->desc.toString() == "<p>Take the second exit.</p>");
+  BOOST_CHECK(loaded->shortDesc.toString() == "A drive-in");
+  BOOST_CHECK(loaded->hint == "Under the bench");
+  BOOST_CHECK(loaded->attrs.contains(ATTR_DOGS_YES));
+  BOOST_CHECK_EQUAL(loaded->attrs.toVector().size(), 1);
+  delete loaded;
+
+  QVector<LogMessage> logs = db.logs("GC1Q743", 10);
+  BOOST_REQUIRE_EQUAL(logs.size(), 1);
+  BOOST_CHECK(logs[0].author == "Dobby");
+  BOOST_CHECK(logs[0].type == LOG_FOUND);
+  BOOST_CHECK(logs[0].date == QDate(2010, 7, 9));
+  BOOST_CHECK(logs[0].msg.toString() == "TFTC!");
+  BOOST_CHECK(logs[0].id.isEmpty());
+
+  // the spatial index covers the old rows
+  QVector<GeocacheSummary> found = db.geocachesInRect(Coordinate(52, 10),
+    Coordinate(53, 11));
+  BOOST_REQUIRE_EQUAL(found.size(), 1);
+  BOOST_CHECK(found[0].waypointString() == "GC1Q743");
+  QVector<SearchResult> results = db.search("Wayward", 10);
+  BOOST_REQUIRE_EQUAL(results.size(), 1);
+  BOOST_CHECK(results[0].summary.waypointString() == "GC1Q743");
+
+  // the rows after the gaps are still found by both indices
+  for(int i = 1; i < words.size(); i += 2) {
+    QString waypoint = QString("GC%1").arg(10001 + i);
+    found = db.geocachesInRect(Coordinate(39.5 + i, 19.5 + i),
+      Coordinate(40.5 + i, 20.5 + i));
+    BOOST_REQUIRE_EQUAL(found.size(), 1);
+    BOOST_CHECK(found[0].waypointString() == waypoint);
+    results = db.search(words[i], 10);
+    BOOST_REQUIRE_EQUAL(results.size(), 1);
+    BOOST_CHECK(results[0].summary.waypointString() == waypoint);
+  }
+
+  // opening again does not upgrade twice
+  db.close();
+  BOOST_REQUIRE(db.open(file.fileName()));
+  BOOST_CHECK_EQUAL(db.logCount("GC1Q743"), 1);
+}
+
+/** @return the sorted waypoints of some summaries */
+static QStringList waypointsOf(const QVector<GeocacheSummary>& summaries) {
+  QStringList waypoints;
+  foreach(const GeocacheSummary& summary, summaries) {
+    waypoints << summary.waypointString();
+  }
+  waypoints.sort();
+  return waypoints;
+}
+
+BOOST_FIXTURE_TEST_CASE(GeocacheDatabase_radius, TemporaryDatabase) {
+  BOOST_REQUIRE(db.open(file.fileName()));
+  QVector<Geocache> geocaches;
+  // on both sides of the 180th meridian, and one far away
+  geocaches << testGeocache("GC10001") << testGeocache("GC10002") <<
+    testGeocache("GC10003");
+  geocaches[0].coord = Coordinate(10, 179.9);
+  geocaches[1].coord = Coordinate(10, -179.9);
+  geocaches[2].coord = Coordinate(10, 170);
+  // near the north pole, across it and far from it
+  geocaches << testGeocache("GC20001") << testGeocache("GC20002") <<
+    testGeocache("GC20003");
+  geocaches[3].coord = Coordinate(89.8, 180);
+  geocaches[4].coord = Coordinate(89.8, 90);
+  geocaches[5].coord = Coordinate(88, 0);
+  // at the widest longitude of a large circle at high latitude, and just
+  // outside of it
+  geocaches << testGeocache("GC30001") << testGeocache("GC30002");
+  geocaches[6].coord = Coordinate(61.6, 20.2);
+  geocaches[7].coord = Coordinate(61.6, 20.4);
+  BOOST_REQUIRE_NO_THROW(db.save(geocaches));
+
+  QStringList expected;
+  expected << "GC10001" << "GC10002";
+  BOOST_CHECK(waypointsOf(db.geocachesInRadius(Coordinate(10, 179.95), 50)) ==
+    expected);
+  BOOST_CHECK(waypointsOf(db.geocachesInRadius(Coordinate(10, -179.95), 50))
+    == expected);
+
+  expected.clear();
+  expected << "GC20001" << "GC20002";
+  BOOST_CHECK(waypointsOf(db.geocachesInRadius(Coordinate(89.9, 0), 50)) ==
+    expected);
+
+  QVector<GeocacheSummary> found = db.geocachesInRadius(Coordinate(60, 0),
+    10 * KM_PER_DEGREE);
+  BOOST_CHECK(waypointsOf(found) == QStringList("GC30001"));
+}
@@ -0,0 +1,79 @@
+#include <import/ImportBatch.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace geojackal;
+
+/** @return a geocache as the parser returns it */
+static Geocache parsedGeocache(const QString& waypoint) {
+  Geocache geocache;
+  geocache.waypoint = waypoint;
+  geocache.name = "Wayward Drive!";
+  geocache.coord = Coordinate(52.2625, 10.5225);
+  geocache.type = TYPE_TRADI;
+  geocache.owner = QString("rohieb");
+  return geocache;
+}
+
+BOOST_AUTO_TEST_CASE(ImportBatch_needsFetch) {
+  QDateTime now = QDateTime::currentDateTime();
+  FetchRecord fresh;
+  fresh.waypoint = "GC1Q743";
+  fresh.fetched = now.addSecs(-3600);
+  fresh.listHash = "row";
+  FetchRecord old = fresh;
+  old.waypoint = "GC1169";
+  old.fetched = now.addDays(-2);
+  QHash<QString, FetchRecord> known;
+  known.insert(fresh.waypoint, fresh);
+  known.insert(old.waypoint, old);
+
+  ImportBatch batch;
+  batch.setKnown(known, 24);
+  BOOST_CHECK(batch.needsFetch("GCK7HH", "row")); // never fetched
+  BOOST_CHECK(!batch.needsFetch("GC1Q743", "changed")); // fetched recently
+  BOOST_CHECK(!batch.needsFetch("GC1169", "row")); // list row did not change
+  BOOST_CHECK(batch.needsFetch("GC1169", "changed"));
+  BOOST_CHECK(batch.needsFetch("GC1169", QByteArray())); // no list row
+}
+
+BOOST_AUTO_TEST_CASE(ImportBatch_records) {
+  ImportBatch batch;
+  BOOST_CHECK(batch.add(parsedGeocache("GC1Q743"), true, "row"));
+  // a page that could not be parsed completely is added, but not recorded,
+  // so it is fetched again next time
+  BOOST_CHECK(!batch.add(parsedGeocache("GC1169"), false, "row"));
+  BOOST_CHECK_EQUAL(batch.size(), 2);
+  BOOST_REQUIRE_EQUAL(batch.fetchRecords().size(), 1);
+  const FetchRecord& record = batch.fetchRecords().first();
+  BOOST_CHECK(record.waypoint == "GC1Q743");
+  BOOST_CHECK(record.listHash == "row");
+  BOOST_CHECK(!record.hash.isEmpty());
+  BOOST_CHECK(record.fetched.isValid());
+
+  // the names of the batch are interned
+  BOOST_CHECK(batch.geocaches()[0].owner.constData() ==
+    batch.geocaches()[1].owner.constData());
+}
+
+BOOST_AUTO_TEST_CASE(ImportBatch_unchanged) {
+  ImportBatch first;
+  first.add(parsedGeocache("GC1Q743"), true, "row");
+  QHash<QString, FetchRecord> known;
+  known.insert("GC1Q743", first.fetchRecords().first());
+
+  // the same content is recorded again, but not added
+  ImportBatch second;
+  second.setKnown(known, 0);
+  BOOST_CHECK(second.add(parsedGeocache("GC1Q743"), true, "row"));
+  BOOST_CHECK_EQUAL(second.size(), 0);
+  BOOST_CHECK_EQUAL(second.unchanged(), 1);
+  BOOST_CHECK_EQUAL(second.fetchRecords().size(), 1);
+
+  Geocache changed = parsedGeocache("GC1Q743");
+  changed.hint = "Under the bench";
+  BOOST_CHECK(second.add(changed, true, "row"));
+  BOOST_CHECK_EQUAL(second.size(), 1);
+  BOOST_CHECK_EQUAL(second.unchanged(), 1);
+  BOOST_CHECK_EQUAL(second.fetchRecords().size(), 2);
+  BOOST_CHECK(second.fetchRecords()[1].hash != known["GC1Q743"].hash);
+}
@@ -0,0 +1,172 @@
+#include <import/PageCache.h>
+#include <logic/Failure.h>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QFile>
+#include <cstring>
+#include <boost/test/unit_test.hpp>
+
+using namespace geojackal;
+
+/** Finished reply with a fixed status, ETag and contents, without network */
+class FakeReply : public QNetworkReply {
+public:
+  FakeReply(int status, const QByteArray& contents,
+    const QByteArray& etag = QByteArray()) : contents_(contents) {
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, status);
+    if(!etag.isEmpty()) {
+      setRawHeader("ETag", etag);
+    }
+    open(QIODevice::ReadOnly);
+    setFinished(true);
+  }
+
+  virtual void abort() {
+  }
+  virtual qint64 bytesAvailable() const {
+    return contents_.size() + QIODevice::bytesAvailable();
+  }
+
+protected:
+  virtual qint64 readData(char * data, qint64 maxSize) {
+    qint64 size = qMin(maxSize, qint64(contents_.size()));
+    memcpy(data, contents_.constData(), size);
+    contents_.remove(0, size);
+    return size;
+  }
+
+private:
+  QByteArray contents_;
+};
+
+/** Remove a directory with everything in it */
+static void removeDir(const QDir& dir) {
+  foreach(const QFileInfo& info, dir.entryInfoList(QDir::Dirs | QDir::Files |
+    QDir::NoDotAndDotDot)) {
+    if(info.isDir()) {
+      removeDir(QDir(info.absoluteFilePath()));
+    } else {
+      QFile::remove(info.absoluteFilePath());
+    }
+  }
+  dir.rmdir(dir.absolutePath());
+}
+
+/** Page cache in a temporary directory, which is removed afterwards */
+struct TemporaryCache {
+  QDir dir;
+  PageCache cache;
+
+  TemporaryCache() : dir(QDir::temp().absoluteFilePath(
+    QString("geojackal-pagecache-%1-%2").
+    arg(QCoreApplication::applicationPid()).arg(counter++))) {
+  }
+  ~TemporaryCache() {
+    try {
+      cache.close();
+    } catch(Failure&) {
+    }
+    removeDir(dir);
+  }
+
+  /** Store a page as if it was loaded from the server */
+  QByteArray store(const QString& key, int status,
+    const QByteArray& contents, const QByteArray& etag = QByteArray()) {
+    FakeReply reply(status, contents, etag);
+    return cache.store(key, &reply);
+  }
+
+  /** @return the number of content files in the cache */
+  int contentFiles() const {
+    int count = 0;
+    foreach(const QFileInfo& info, dir.entryInfoList(QDir::Dirs |
+      QDir::NoDotAndDotDot)) {
+      count += QDir(info.absoluteFilePath()).entryList(QDir::Files).size();
+    }
+    return count;
+  }
+
+  /** @return the name of the content file of some contents */
+  QString contentFile(const QByteArray& contents) const {
+    QString hex = QCryptographicHash::hash(contents,
+      QCryptographicHash::Sha1).toHex();
+    return dir.absoluteFilePath(hex.left(2) + "/" + hex);
+  }
+
+  static int counter;
+};
+
+int TemporaryCache::counter = 0;
+
+BOOST_FIXTURE_TEST_CASE(PageCache_store, TemporaryCache) {
+  BOOST_REQUIRE(cache.open(dir));
+  BOOST_CHECK(store("guid-1", 200, "<p>GC1Q743</p>", "\"v1\"") ==
+    "<p>GC1Q743</p>");
+  BOOST_REQUIRE(cache.contains("guid-1"));
+  BOOST_CHECK(cache.data("guid-1") == "<p>GC1Q743</p>");
+  BOOST_CHECK(cache.page("guid-1").etag == "\"v1\"");
+
+  QNetworkRequest request;
+  cache.addValidators("guid-1", request);
+  BOOST_CHECK(request.rawHeader("If-None-Match") == "\"v1\"");
+
+  // not modified: the body is empty, and the cached page is returned
+  QDateTime fetched = cache.page("guid-1").fetched;
+  BOOST_CHECK(store("guid-1", 304, QByteArray()) == "<p>GC1Q743</p>");
+  BOOST_CHECK(cache.page("guid-1").fetched >= fetched);
+  BOOST_CHECK(cache.page("guid-1").etag == "\"v1\"");
+  BOOST_CHECK_EQUAL(cache.size(), 1);
+
+  // errors are passed on, but not cached
+  BOOST_CHECK(store("guid-2", 500, "Server Error") == "Server Error");
+  BOOST_CHECK(!cache.contains("guid-2"));
+  BOOST_CHECK_EQUAL(contentFiles(), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(PageCache_sharedFiles, TemporaryCache) {
+  BOOST_REQUIRE(cache.open(dir));
+  // equal pages share one file
+  store("guid-1", 200, "same");
+  store("guid-2", 200, "same");
+  BOOST_CHECK_EQUAL(contentFiles(), 1);
+
+  // the file stays while another page refers to it
+  store("guid-1", 200, "changed");
+  BOOST_CHECK_EQUAL(contentFiles(), 2);
+  BOOST_CHECK(cache.data("guid-2") == "same");
+
+  // and is removed with the last reference
+  store("guid-2", 200, "changed");
+  BOOST_CHECK_EQUAL(contentFiles(), 1);
+  BOOST_CHECK(!QFile::exists(contentFile("same")));
+
+  // storing the same contents again keeps the file
+  store("guid-1", 200, "changed");
+  BOOST_CHECK_EQUAL(contentFiles(), 1);
+  BOOST_CHECK(cache.data("guid-1") == "changed");
+  BOOST_CHECK(cache.data("guid-2") == "changed");
+}
+
+BOOST_FIXTURE_TEST_CASE(PageCache_reopen, TemporaryCache) {
+  BOOST_REQUIRE(cache.open(dir));
+  store("guid-1", 200, "first", "\"v1\"");
+  store("guid-2", 200, "second");
+  BOOST_REQUIRE_NO_THROW(cache.save());
+
+  PageCache other;
+  BOOST_REQUIRE(other.open(dir));
+  BOOST_CHECK_EQUAL(other.size(), 2);
+  BOOST_CHECK(other.data("guid-1") == "first");
+  BOOST_CHECK(other.page("guid-1").etag == "\"v1\"");
+  BOOST_CHECK(other.page("guid-1").fetched == cache.page("guid-1").fetched);
+  BOOST_CHECK(other.data("guid-2") == "second");
+  other.close();
+
+  // pages whose file is gone are dropped from the index
+  cache.close();
+  BOOST_REQUIRE(QFile::remove(contentFile("second")));
+  BOOST_REQUIRE(cache.open(dir));
+  BOOST_CHECK_EQUAL(cache.size(), 1);
+  BOOST_CHECK(cache.contains("guid-1"));
+  BOOST_CHECK(!cache.contains("guid-2"));
+}
@@ -0,0 +1,94 @@
+#include <logic/SummarySnapshot.h>
+#include <QTemporaryFile>
+#include <QStringList>
+#include <QDir>
+#include <cstring>
+#include <boost/test/unit_test.hpp>
+
+using namespace geojackal;
+
+/** Snapshot of three geocaches in a temporary file */
+struct TemporarySnapshot {
+  QTemporaryFile file;
+  QVector<GeocacheSummary> summaries;
+  QStringList names, owners;
+
+  TemporarySnapshot() : file(QDir::tempPath() + "/geojackal-XXXXXX") {
+    file.open(); // creates the file, so the name is reserved
+    file.close();
+    const char * waypoints[] = { "GC1169", "GC1Q743", "GCK7HH" };
+    for(int i = 0; i < 3; ++i) {
+      GeocacheSummary summary;
+      memset(&summary, 0, sizeof(summary));
+      summary.setWaypoint(waypoints[i]);
+      summary.lat = 52.0 + i;
+      summary.lon = 10.0 + i;
+      summary.type = TYPE_TRADI + i;
+      summary.difficulty = 2 + i;
+      summaries << summary;
+    }
+    names << QString::fromUtf8("Bärenhöhle") << "Wayward Drive!" << "";
+    // owners are interned, the first and the last share one string
+    owners << "rohieb" << "someone else" << "rohieb";
+    SummarySnapshot::write(file.fileName(), 42, summaries, names, owners);
+  }
+
+  /** Overwrite a string offset in the snapshot file */
+  void corrupt(qint64 pos, quint32 offset) {
+    QFile f(file.fileName());
+    f.open(QIODevice::ReadWrite);
+    f.seek(pos);
+    f.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+  }
+};
+
+/** Size of the header of a snapshot file */
+static const qint64 HEADER_SIZE = 32;
+
+BOOST_FIXTURE_TEST_CASE(SummarySnapshot_roundTrip, TemporarySnapshot) {
+  SummarySnapshot snapshot;
+  BOOST_REQUIRE(snapshot.open(file.fileName()));
+  BOOST_CHECK_EQUAL(snapshot.generation(), 42u);
+  BOOST_REQUIRE_EQUAL(snapshot.size(), 3);
+  for(int i = 0; i < 3; ++i) {
+    BOOST_CHECK(snapshot.at(i).waypointString() ==
+      summaries[i].waypointString());
+    BOOST_CHECK_EQUAL(snapshot.at(i).lat, summaries[i].lat);
+    BOOST_CHECK_EQUAL(snapshot.at(i).lon, summaries[i].lon);
+    BOOST_CHECK_EQUAL(snapshot.at(i).type, summaries[i].type);
+    BOOST_CHECK_EQUAL(snapshot.at(i).difficulty, summaries[i].difficulty);
+    BOOST_CHECK(snapshot.name(i) == names[i]);
+    BOOST_CHECK(snapshot.owner(i) == owners[i]);
+  }
+  BOOST_CHECK_EQUAL(snapshot.indexOf("GC1Q743"), 1);
+  BOOST_CHECK_EQUAL(snapshot.indexOf("GC0000"), -1);
+
+  QVector<GeocacheSummary> found = snapshot.geocachesInRect(
+    Coordinate(52.5, 10.5), Coordinate(54.5, 12.5), Coordinate(54.0, 12.0));
+  BOOST_REQUIRE_EQUAL(found.size(), 2);
+  BOOST_CHECK(found[0].waypointString() == "GCK7HH"); // nearest first
+  BOOST_CHECK(found[1].waypointString() == "GC1Q743");
+}
+
+BOOST_FIXTURE_TEST_CASE(SummarySnapshot_invalidOffset, TemporarySnapshot) {
+  // the owner offset of the last geocache
+  qint64 pos = HEADER_SIZE + 3 * sizeof(GeocacheSummary) +
+    5 * sizeof(quint32);
+  corrupt(pos, 0xffffffffu);
+  SummarySnapshot snapshot;
+  BOOST_CHECK(!snapshot.open(file.fileName()));
+  BOOST_CHECK(!snapshot.isOpen());
+}
+
+BOOST_FIXTURE_TEST_CASE(SummarySnapshot_truncated, TemporarySnapshot) {
+  QFile f(file.fileName());
+  BOOST_REQUIRE(f.resize(f.size() - 1));
+  SummarySnapshot snapshot;
+  BOOST_CHECK(!snapshot.open(file.fileName()));
+
+  // the size matches again, but the last string has no terminator
+  f.open(QIODevice::Append);
+  f.write("x", 1);
+  f.close();
+  BOOST_CHECK(!snapshot.open(file.fileName()));
+}
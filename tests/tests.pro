@@ -1,8 +1,19 @@
 TEMPLATE = app
 TARGET = test
-QT += core
-SOURCES = *.cpp
+QT += core sql network
+SOURCES = *.cpp \
+  ../src/logic/Coordinate.cpp \
+  ../src/logic/Failure.cpp \
+  ../src/logic/Geocache.cpp \
+  ../src/logic/GeocacheDatabase.cpp \
+  ../src/logic/GeocacheQuery.cpp \
+  ../src/logic/AttributeIndex.cpp \
+  ../src/logic/NameDictionary.cpp \
+  ../src/logic/SummarySnapshot.cpp \
+  ../src/logic/StringPool.cpp \
+  ../src/import/ImportBatch.cpp \
+  ../src/import/PageCache.cpp
 unix:LIBS += -lboost_unit_test_framework-mt
 DEFINES += BOOST_TEST_DYN_LINK
-INCLUDEPATH += ../src/
+INCLUDEPATH += ../src/ ../src/logic/
 
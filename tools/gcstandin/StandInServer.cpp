@@ -0,0 +1,291 @@
+/**
+ * @file StandInServer.cpp
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StandInServer.h"
+#include <QFile>
+#include <QUrl>
+#include <QTimer>
+#include <QRegExp>
+#include <QStringList>
+#include <QCryptographicHash>
+#include <QtDebug>
+
+using namespace geojackal;
+
+/** Interval in ms in which chunks are written to limit the bandwidth */
+static const int CHUNK_INTERVAL = 100;
+
+/**
+ * Constructor
+ * @param dir Directory of the recordings
+ * @param latency Delay of every response in ms
+ * @param bandwidth Bandwidth per connection in KiB/s, or 0 for unlimited
+ * @param parent Parent object
+ */
+StandInServer::StandInServer(const QDir& dir, int latency, int bandwidth,
+  QObject * parent) : QTcpServer(parent), dir_(dir), latency_(latency),
+  bandwidth_(bandwidth) {
+  connect(this, SIGNAL(newConnection()), SLOT(acceptConnections()));
+}
+
+StandInServer::~StandInServer() {
+}
+
+/**
+ * Read the recordings into memory
+ * @return @c false if there are no list pages
+ */
+bool StandInServer::load() {
+  loginPage_ = readFile(dir_.absoluteFilePath("login.html"));
+  if(loginPage_.isEmpty()) {
+    loginPage_ = "<html><body>Logged in</body></html>";
+  }
+
+  QRegExp viewStateRx("<input type=\"hidden\" name=\"__VIEWSTATE\" [^>]*"
+    "value=\"([^\"]*)\"");
+  viewStateRx.setMinimal(true);
+  for(int i = 1; ; ++i) {
+    QByteArray page = readFile(dir_.absoluteFilePath(QString("nearest/%1.html").
+      arg(i)));
+    if(page.isEmpty()) {
+      break;
+    }
+    listPages_.append(page);
+    if(viewStateRx.indexIn(QString(page)) >= 0) {
+      viewStates_.insert(viewStateRx.cap(1).toAscii(), i);
+    }
+  }
+
+  QRegExp waypointRx("<span .*id=\"ctl00_uxWaypointName\".*>([^<]+)</span");
+  waypointRx.setMinimal(true);
+  QDir detailDir(dir_.absoluteFilePath("details"));
+  foreach(QString fileName, detailDir.entryList(QStringList("*.html"),
+    QDir::Files)) {
+    QByteArray guid = fileName.left(fileName.size() - 5).toAscii();
+    QByteArray page = readFile(detailDir.absoluteFilePath(fileName));
+    details_.insert(guid, page);
+    if(waypointRx.indexIn(QString(page)) >= 0) {
+      waypoints_.insert(waypointRx.cap(1).trimmed().toUpper().toAscii(),
+        guid);
+    }
+  }
+
+  qDebug() << "loaded" << listPages_.size() << "list pages and" <<
+    details_.size() << "detail pages from" << dir_.path();
+  return !listPages_.isEmpty();
+}
+
+/**
+ * Build the response to a request
+ * @param method HTTP method
+ * @param target Path and query of the request
+ * @param headers Headers of the request, by lower case name
+ * @param body Body of the request
+ * @return The complete HTTP response
+ */
+QByteArray StandInServer::respond(const QByteArray& method,
+  const QByteArray& target, const QHash<QByteArray, QByteArray>& headers,
+  const QByteArray& body) {
+  QUrl url = QUrl::fromEncoded("http://localhost" + target);
+  QString path = url.path().toLower();
+  QByteArray ret;
+
+  if(path == "/login/default.aspx") {
+    QList<QByteArray> cookies;
+    cookies << "Set-Cookie: ASP.NET_SessionId=standin; path=/";
+    cookies << "Set-Cookie: userid=standin; path=/";
+    ret = response(200, loginPage_, cookies);
+
+  } else if(path == "/seek/nearest.aspx") {
+    // the "Next" postback names the current page by its view state
+    int page = 1;
+    if(method == "POST" && body.contains("__EVENTTARGET")) {
+      foreach(QByteArray field, body.split('&')) {
+        if(field.startsWith("__VIEWSTATE=")) {
+          QByteArray value = field.mid(12).replace('+', ' ');
+          page = viewStates_.value(QUrl::fromPercentEncoding(value).
+            toAscii(), listPages_.size()) + 1;
+        }
+      }
+    }
+    if(page <= listPages_.size()) {
+      ret = response(200, listPages_.at(page - 1));
+    } else {
+      ret = response(404, "No such list page");
+    }
+
+  } else if(path == "/seek/cache_details.aspx") {
+    QByteArray guid = url.queryItemValue("guid").toAscii();
+    if(guid.isEmpty()) {
+      guid = waypoints_.value(url.queryItemValue("wp").toUpper().toAscii());
+    }
+    if(details_.contains(guid)) {
+      const QByteArray& page = details_[guid];
+      QByteArray etag = "\"" + QCryptographicHash::hash(page,
+        QCryptographicHash::Sha1).toHex() + "\"";
+      QList<QByteArray> extra;
+      extra << "ETag: " + etag;
+      if(headers.value("if-none-match") == etag) {
+        ret = response(304, QByteArray(), extra);
+      } else {
+        ret = response(200, page, extra);
+      }
+    } else {
+      ret = response(404, "No such geocache");
+    }
+
+  } else {
+    ret = response(404, "Not recorded");
+  }
+
+  qDebug() << method << target.left(80) << ret.left(ret.indexOf('\r')) <<
+    ret.size() << "bytes";
+  return ret;
+}
+
+/** Wrap every new connection in a StandInConnection */
+void StandInServer::acceptConnections() {
+  while(hasPendingConnections()) {
+    new StandInConnection(nextPendingConnection(), this);
+  }
+}
+
+/**
+ * @internal
+ * Build an HTTP response. The connection is closed after every response.
+ * @param status HTTP status code
+ * @param body Body of the response
+ * @param headers Additional header lines
+ */
+QByteArray StandInServer::response(int status, const QByteArray& body,
+  const QList<QByteArray>& headers) {
+  QByteArray reason;
+  switch(status) {
+    case 200: reason = "OK"; break;
+    case 304: reason = "Not Modified"; break;
+    default: reason = "Not Found"; break;
+  }
+  QByteArray ret = "HTTP/1.1 " + QByteArray::number(status) + " " + reason +
+    "\r\n";
+  ret += "Content-Type: text/html; charset=utf-8\r\n";
+  ret += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+  ret += "Connection: close\r\n";
+  foreach(QByteArray header, headers) {
+    ret += header + "\r\n";
+  }
+  ret += "\r\n";
+  ret += body;
+  return ret;
+}
+
+/**
+ * @internal
+ * @return the contents of a file, or an empty array if it cannot be read
+ */
+QByteArray StandInServer::readFile(const QString& fileName) {
+  QFile file(fileName);
+  if(!file.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+  return file.readAll();
+}
+
+/**
+ * Constructor. The connection deletes itself when the socket is closed.
+ * @param socket The socket of the connection, which is taken over
+ * @param server The server that builds the response
+ */
+StandInConnection::StandInConnection(QTcpSocket * socket,
+  StandInServer * server) : QObject(server), socket_(socket),
+  server_(server), written_(0) {
+  socket_->setParent(this);
+  connect(socket_, SIGNAL(readyRead()), SLOT(readRequest()));
+  connect(socket_, SIGNAL(disconnected()), SLOT(deleteLater()));
+}
+
+/**
+ * @internal
+ * Read the request until it is complete, then start the response after the
+ * latency of the server.
+ */
+void StandInConnection::readRequest() {
+  request_ += socket_->readAll();
+  int headerEnd = request_.indexOf("\r\n\r\n");
+  if(headerEnd < 0 || !response_.isEmpty()) {
+    return;
+  }
+
+  QList<QByteArray> lines = request_.left(headerEnd).split('\n');
+  QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+  if(requestLine.size() < 2) {
+    socket_->disconnectFromHost();
+    return;
+  }
+  QHash<QByteArray, QByteArray> headers;
+  foreach(QByteArray line, lines) {
+    int colon = line.indexOf(':');
+    if(colon > 0) {
+      headers.insert(line.left(colon).trimmed().toLower(),
+        line.mid(colon + 1).trimmed());
+    }
+  }
+  int length = headers.value("content-length").toInt();
+  if(request_.size() < headerEnd + 4 + length) {
+    return; // body is incomplete
+  }
+
+  response_ = server_->respond(requestLine.at(0), requestLine.at(1), headers,
+    request_.mid(headerEnd + 4, length));
+  QTimer::singleShot(server_->latency(), this, SLOT(startResponse()));
+}
+
+/**
+ * @internal
+ * Start writing the response, in chunks if the bandwidth is limited.
+ */
+void StandInConnection::startResponse() {
+  if(server_->bandwidth() <= 0) {
+    socket_->write(response_);
+    written_ = response_.size();
+    socket_->disconnectFromHost();
+    return;
+  }
+  QTimer * timer = new QTimer(this);
+  connect(timer, SIGNAL(timeout()), SLOT(writeChunk()));
+  timer->start(CHUNK_INTERVAL);
+  writeChunk();
+}
+
+/**
+ * @internal
+ * Write the next chunk of the response, as much as the bandwidth allows in
+ * one interval. Closes the connection after the last chunk.
+ */
+void StandInConnection::writeChunk() {
+  if(written_ >= response_.size()) {
+    return;
+  }
+  int chunk = qMax(1, server_->bandwidth() * 1024 * CHUNK_INTERVAL / 1000);
+  socket_->write(response_.mid(written_, chunk));
+  written_ += chunk;
+  if(written_ >= response_.size()) {
+    socket_->disconnectFromHost();
+  }
+}
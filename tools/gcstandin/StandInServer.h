@@ -0,0 +1,124 @@
+/**
+ * @file StandInServer.h
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STANDINSERVER_H_
+#define STANDINSERVER_H_
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QDir>
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+
+namespace geojackal {
+
+/**
+ * Local HTTP server that stands in for geocaching.com and serves recorded
+ * pages, so imports can be tested and benchmarked without network. Set the
+ * base URL of GeoJackal (gc/baseUrl in prefs.ini) to the URL of the server.
+ *
+ * The recordings are read from a directory at start:
+ * - @c login.html: answer to the login, optional. Every login succeeds.
+ * - @c nearest/1.html, @c 2.html, ...: the list pages of nearest.aspx, in
+ *   order. The "Next" postback is answered with the page after the one
+ *   whose @c __VIEWSTATE was posted.
+ * - @c details/<guid>.html: the detail pages of cache_details.aspx, found
+ *   by the GUID or by the waypoint on the page.
+ *
+ * Every response is delayed by a latency, and sent with a limited bandwidth
+ * per connection. The detail pages carry an ETag, so conditional requests
+ * are answered with 304 Not Modified.
+ */
+class StandInServer : public QTcpServer {
+  Q_OBJECT
+public:
+  StandInServer(const QDir& dir, int latency, int bandwidth,
+    QObject * parent = 0);
+  virtual ~StandInServer();
+
+  bool load();
+  QByteArray respond(const QByteArray& method, const QByteArray& target,
+    const QHash<QByteArray, QByteArray>& headers, const QByteArray& body);
+
+  /** @return the delay of every response in ms */
+  inline int latency() const {
+    return latency_;
+  }
+  /** @return the bandwidth per connection in KiB/s, or 0 for unlimited */
+  inline int bandwidth() const {
+    return bandwidth_;
+  }
+
+protected slots:
+  void acceptConnections();
+
+private:
+  StandInServer(const StandInServer&);
+  StandInServer& operator=(const StandInServer&);
+
+  static QByteArray response(int status, const QByteArray& body,
+    const QList<QByteArray>& headers = QList<QByteArray>());
+  static QByteArray readFile(const QString& fileName);
+
+  QDir dir_;
+  int latency_;
+  int bandwidth_;
+  QByteArray loginPage_;
+  QList<QByteArray> listPages_;
+  /** Number of each list page, by its __VIEWSTATE */
+  QHash<QByteArray, int> viewStates_;
+  /** Detail pages, by GUID */
+  QHash<QByteArray, QByteArray> details_;
+  /** GUIDs of the detail pages, by waypoint */
+  QHash<QByteArray, QByteArray> waypoints_;
+};
+
+/**
+ * One connection to the StandInServer. Reads a request, and writes the
+ * response after the latency, with the bandwidth of the server. The
+ * connection is closed after the response.
+ */
+class StandInConnection : public QObject {
+  Q_OBJECT
+public:
+  StandInConnection(QTcpSocket * socket, StandInServer * server);
+
+protected slots:
+  void readRequest();
+  void startResponse();
+  void writeChunk();
+
+private:
+  StandInConnection(const StandInConnection&);
+  StandInConnection& operator=(const StandInConnection&);
+
+  QTcpSocket * socket_;
+  StandInServer * server_;
+  /** Received bytes of the request */
+  QByteArray request_;
+  /** The response, and the number of its bytes written */
+  QByteArray response_;
+  int written_;
+};
+
+}
+
+#endif /* STANDINSERVER_H_ */
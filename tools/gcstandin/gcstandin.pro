@@ -0,0 +1,7 @@
+TEMPLATE = app
+TARGET = gcstandin
+QT = core network
+CONFIG += console
+SOURCES = main.cpp \
+  StandInServer.cpp
+HEADERS = StandInServer.h
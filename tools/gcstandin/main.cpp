@@ -0,0 +1,83 @@
+/**
+ * @file main.cpp
+ * @date 17 Oct 2026
+ * @author agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ * 
+ * This program is free software; you can redistribute it and/or modify it 
+ * under the terms of the GNU General Public License, version 3, as published 
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT 
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for 
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with 
+ * this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StandInServer.h"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QtDebug>
+#include <cstdio>
+
+using namespace geojackal;
+
+/** Print the command line usage */
+static void usage() {
+  fprintf(stderr, "Usage: gcstandin [--port PORT] [--latency MS] "
+    "[--bandwidth KIB_PER_S] DIRECTORY\n"
+    "Serves the recorded geocaching.com pages in DIRECTORY on localhost.\n"
+    "Set gc/baseUrl in the GeoJackal prefs.ini to http://localhost:PORT.\n");
+}
+
+/**
+ * Local stand-in for geocaching.com, see StandInServer
+ */
+int main(int argc, char * argv[]) {
+  QCoreApplication app(argc, argv);
+
+  int port = 8080, latency = 0, bandwidth = 0;
+  QString dir;
+  QStringList args = app.arguments();
+  for(int i = 1; i < args.size(); ++i) {
+    bool ok = true;
+    if(args.at(i) == "--port" && i + 1 < args.size()) {
+      port = args.at(++i).toInt(&ok);
+    } else if(args.at(i) == "--latency" && i + 1 < args.size()) {
+      latency = args.at(++i).toInt(&ok);
+    } else if(args.at(i) == "--bandwidth" && i + 1 < args.size()) {
+      bandwidth = args.at(++i).toInt(&ok);
+    } else if(!args.at(i).startsWith("--") && dir.isEmpty()) {
+      dir = args.at(i);
+    } else {
+      ok = false;
+    }
+    if(!ok) {
+      usage();
+      return 1;
+    }
+  }
+  if(dir.isEmpty()) {
+    usage();
+    return 1;
+  }
+
+  StandInServer server(dir, latency, bandwidth);
+  if(!server.load()) {
+    fprintf(stderr, "No list pages found in %s/nearest\n", qPrintable(dir));
+    return 1;
+  }
+  if(!server.listen(QHostAddress::LocalHost, port)) {
+    fprintf(stderr, "Could not listen on port %d: %s\n", port,
+      qPrintable(server.errorString()));
+    return 1;
+  }
+  qDebug() << "serving at" << QString("http://localhost:%1").arg(port) <<
+    "with" << latency << "ms latency and" << bandwidth << "KiB/s per "
+    "connection (0 = unlimited)";
+  return app.exec();
+}